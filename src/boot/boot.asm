@@ -4,10 +4,13 @@ bits 32
 ; Начало секции кода
 section .text
         ; Заголовок Multiboot для загрузки GRUB
+        ; Флаги: бит 0 - выравнивать модули по странице,
+        ;        бит 1 - передать объём памяти и карту памяти (mmap)
+        MB_FLAGS equ 0x03
         align 4                     ; Выравнивание по 4 байта
         dd 0x1BADB002              ; Магическое число Multiboot
-        dd 0x00                    ; Флаги (0 - нет дополнительных полей)
-        dd - (0x1BADB002 + 0x00)   ; Контрольная сумма (магическое + флаги + сумма = 0)
+        dd MB_FLAGS                ; Флаги
+        dd - (0x1BADB002 + MB_FLAGS) ; Контрольная сумма (магическое + флаги + сумма = 0)
 
 ; Объявляем точку входа start глобальной
 global start
@@ -20,6 +23,9 @@ start:
   cli
   ; Устанавливаем указатель стека на выделенную область
   mov esp, stack_space
+  ; Передаём в kmain(magic, mbi): EBX - адрес multiboot_info, EAX - магическое число
+  push ebx
+  push eax
   ; Вызываем основную функцию ядра на C
   call kmain
   ; Останавливаем процессор (если kmain вернет управление)
@@ -25,8 +25,8 @@ void console_prompt(void) {
     print_string("$: ");
 }
 
-char* console_readline(uint32_t max_length) {
-    return read_line(max_length);
+char* console_readline(arena_t *arena, uint32_t max_length) {
+    return read_line(arena, max_length);
 }
 
 
@@ -10,6 +10,7 @@
 #define KERNEL_CONSOLE_H
 
 #include <stdint.h>
+#include "memory/memory.h"
 
 /**
  * @brief Вывод строки без перевода строки.
@@ -31,12 +32,13 @@ void console_prompt(void);
 /**
  * @brief Чтение строки из консоли до нажатия Enter.
  *
+ * @param arena Арена, из которой выделяется строка.
  * @param max_length Максимальная длина строки (включая завершающий 0).
- * @return Указатель на выделенную в куче строку или NULL при ошибке.
+ * @return Указатель на строку в арене или NULL при ошибке.
  *
- * @note Освобождение делает вызывающая сторона через kfree().
+ * @note Строка живёт до сброса арены вызывающей стороной.
  */
-char* console_readline(uint32_t max_length);
+char* console_readline(arena_t *arena, uint32_t max_length);
 
 #endif /* KERNEL_CONSOLE_H */
 
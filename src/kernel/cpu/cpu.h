@@ -0,0 +1,161 @@
+/**
+ * @file cpu.h
+ * @brief Доступ к специальным инструкциям процессора
+ */
+
+#ifndef KERNEL_CPU_H
+#define KERNEL_CPU_H
+
+#include <stdint.h>
+
+/* Биты CPUID.01H:EDX */
+#define CPUID_EDX_FPU  (1u << 0)
+#define CPUID_EDX_PSE  (1u << 3)
+#define CPUID_EDX_TSC  (1u << 4)
+#define CPUID_EDX_MSR  (1u << 5)
+#define CPUID_EDX_APIC (1u << 9)
+#define CPUID_EDX_PGE  (1u << 13)
+#define CPUID_EDX_FXSR (1u << 24)
+#define CPUID_EDX_SSE  (1u << 25)
+#define CPUID_EDX_SSE2 (1u << 26)
+
+/* Биты CPUID.07H:EBX */
+#define CPUID_EBX7_ERMS (1u << 9)   /* Быстрые REP MOVSB/STOSB */
+
+/* Биты CPUID.80000007H:EDX */
+#define CPUID_EDX_INVARIANT_TSC (1u << 8) /* TSC идёт с постоянной частотой во всех состояниях */
+
+/* Биты CR0 */
+#define CR0_MP (1u << 1)            /* WAIT/FWAIT учитывают TS */
+#define CR0_EM (1u << 2)            /* Эмуляция x87: любая FPU-инструкция даёт #NM */
+#define CR0_TS (1u << 3)            /* Задача переключена: первая FPU/SSE-инструкция даёт #NM */
+#define CR0_NE (1u << 5)            /* Ошибки x87 через #MF, а не через IRQ13 */
+#define CR0_WP (1u << 16)           /* Защита от записи действует и для ядра */
+#define CR0_PG (1u << 31)           /* Страничная адресация включена */
+
+/* Биты CR4 */
+#define CR4_PSE (1u << 4)           /* Страницы 4MB в каталоге страниц */
+#define CR4_PGE (1u << 7)           /* Глобальные страницы переживают смену CR3 */
+#define CR4_OSFXSR (1u << 9)        /* ОС сохраняет состояние SSE (FXSAVE), SSE разрешены */
+#define CR4_OSXMMEXCPT (1u << 10)   /* Ошибки SSE через #XM */
+
+/**
+ * @brief Выполнение инструкции CPUID
+ * @param leaf Номер функции (EAX)
+ * @param eax, ebx, ecx, edx Результаты
+ */
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(0));
+}
+
+/**
+ * @brief Чтение счётчика тактов процессора (RDTSC)
+ * @return Количество тактов с момента сброса процессора
+ */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief Чтение модельно-специфичного регистра (RDMSR)
+ * @param msr Номер регистра
+ */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief Чтение регистра CR0
+ */
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+/**
+ * @brief Запись регистра CR0
+ */
+static inline void write_cr0(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+/**
+ * @brief Чтение регистра CR4
+ */
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+/**
+ * @brief Запись регистра CR4
+ */
+static inline void write_cr4(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+/**
+ * @brief Адрес последней ошибки страницы (CR2)
+ */
+static inline uint32_t read_cr2(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+/**
+ * @brief Чтение регистра CR3 (физический адрес каталога страниц)
+ */
+static inline uint32_t read_cr3(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+/**
+ * @brief Загрузка каталога страниц (сбрасывает все не глобальные записи TLB)
+ */
+static inline void write_cr3(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+/**
+ * @brief Сброс записи TLB для одной страницы
+ */
+static inline void invlpg(uint32_t addr) {
+    __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+/**
+ * @brief Сброс флага CR0.TS (разрешить FPU/SSE без #NM)
+ */
+static inline void clts(void) {
+    __asm__ volatile("clts" : : : "memory");
+}
+
+/**
+ * @brief Сохранение флагов и запрет прерываний
+ * @return Прежнее значение EFLAGS
+ */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+/**
+ * @brief Восстановление флагов, сохранённых irq_save
+ */
+static inline void irq_restore(uint32_t flags) {
+    __asm__ volatile("pushl %0\n\tpopfl" : : "r"(flags) : "memory", "cc");
+}
+
+#endif /* KERNEL_CPU_H */
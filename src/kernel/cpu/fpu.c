@@ -0,0 +1,291 @@
+/**
+ * @file fpu.c
+ * @brief Включение x87/SSE и ленивое сохранение их состояния
+ *
+ * Регистры FPU/SSE физически содержат состояние не более чем одного
+ * контекста - владельца (fpu_owner). Текущий контекст (fpu_current_ctx)
+ * может от него отличаться: тогда взведён CR0.TS и первая же FPU/SSE-
+ * инструкция вызывает #NM. Обработчик сохраняет регистры владельца,
+ * загружает состояние текущего контекста и делает его владельцем.
+ * Контексты, не трогающие FPU/SSE, не платят за переключение ничего.
+ */
+
+#include "fpu.h"
+#include "cpu.h"
+#include "../memory/memory.h"
+#include "../video/video.h"
+
+/* Контекст загрузочного кода ядра (оболочка, обработчики команд) */
+static fpu_context_t fpu_boot_context;
+/* Чистое состояние после FNINIT - начальное для новых контекстов */
+static fpu_context_t fpu_initial_state;
+
+/* Контекст, который сейчас выполняется */
+static fpu_context_t *fpu_current_ctx = NULL;
+/* Контекст, чьё состояние сейчас загружено в регистры (NULL - ничьё) */
+static fpu_context_t *fpu_owner = NULL;
+
+/* Кэш областей FXSAVE для fpu_context_create */
+static kmem_cache_t *fpu_cache = NULL;
+
+/* Вложенность kernel_fpu_begin и флаги прерываний внешней секции */
+static uint32_t kernel_fpu_depth = 0;
+static uint32_t kernel_fpu_flags = 0;
+
+static int fpu_ready = 0;
+static int fpu_sse = 0;
+static fpu_stats_t fpu_stats;
+
+static inline void fpu_fxsave(fpu_context_t *ctx) {
+    __asm__ volatile("fxsave %0" : "=m"(*ctx));
+}
+
+static inline void fpu_fxrstor(const fpu_context_t *ctx) {
+    __asm__ volatile("fxrstor %0" : : "m"(*ctx));
+}
+
+/**
+ * @brief Включение x87 и SSE
+ *
+ * Сбрасывает CR0.EM/TS, взводит CR0.MP/NE и, если процессор умеет
+ * FXSAVE и SSE, CR4.OSFXSR/OSXMMEXCPT. Вызывается до
+ * memory_primitives_init, чтобы та могла выбрать SSE2-варианты.
+ * Без FXSAVE состоянием FPU ядро не управляет.
+ */
+void fpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    print_string("FPU Initialization... ");
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_FPU) || !(edx & CPUID_EDX_FXSR)) {
+        print_string_color("SKIPPED\n", COLOR_RED, COLOR_BLACK);
+        print_string("  - No x87 FPU with FXSAVE\n");
+        return;
+    }
+
+    uint32_t cr0 = read_cr0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0);
+
+    uint32_t cr4 = read_cr4() | CR4_OSFXSR;
+    if (edx & CPUID_EDX_SSE) {
+        cr4 |= CR4_OSXMMEXCPT;
+        fpu_sse = 1;
+    }
+    write_cr4(cr4);
+
+    __asm__ volatile("fninit");
+    if (fpu_sse) {
+        uint32_t mxcsr = FPU_MXCSR_DEFAULT;
+        __asm__ volatile("ldmxcsr %0" : : "m"(mxcsr));
+    }
+    fpu_fxsave(&fpu_initial_state);
+
+    /* Регистры сейчас принадлежат загрузочному контексту */
+    memory_copy(&fpu_boot_context, &fpu_initial_state, sizeof(fpu_context_t));
+    fpu_current_ctx = &fpu_boot_context;
+    fpu_owner = &fpu_boot_context;
+    fpu_ready = 1;
+
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string(fpu_sse ? "  - x87 + SSE, lazy FXSAVE\n" : "  - x87 only, lazy FXSAVE\n");
+}
+
+/**
+ * @brief Разрешены ли SSE-инструкции
+ * @return 1 если CR4.OSFXSR взведён и процессор поддерживает SSE
+ */
+int fpu_has_sse(void) {
+    return fpu_sse;
+}
+
+/**
+ * @brief Создание контекста FPU с чистым состоянием
+ *
+ * Область копируется из состояния после FNINIT и загружается в
+ * регистры только при первом #NM в этом контексте.
+ * @return Контекст или NULL при нехватке памяти либо без FPU
+ */
+fpu_context_t* fpu_context_create(void) {
+    if (!fpu_ready) {
+        return NULL;
+    }
+    if (!fpu_cache) {
+        fpu_cache = kmem_cache_create("fpu_context", sizeof(fpu_context_t), FPU_STATE_ALIGN);
+        if (!fpu_cache) {
+            return NULL;
+        }
+    }
+
+    fpu_context_t *ctx = (fpu_context_t*)kmem_cache_alloc(fpu_cache);
+    if (ctx) {
+        memory_copy(ctx, &fpu_initial_state, sizeof(fpu_context_t));
+    }
+    return ctx;
+}
+
+/**
+ * @brief Освобождение контекста FPU
+ *
+ * Если регистры принадлежали этому контексту, они просто
+ * забываются - сохранять их уже некуда.
+ * @param ctx Контекст (не текущий)
+ */
+void fpu_context_destroy(fpu_context_t *ctx) {
+    if (!ctx || ctx == &fpu_boot_context) {
+        return;
+    }
+
+    uint32_t flags = irq_save();
+    if (fpu_owner == ctx) {
+        fpu_owner = NULL;
+    }
+    if (fpu_current_ctx == ctx) {
+        fpu_current_ctx = &fpu_boot_context;
+    }
+    irq_restore(flags);
+
+    kmem_cache_free(fpu_cache, ctx);
+}
+
+/**
+ * @brief Смена текущего контекста FPU (вызывается при переключении контекстов)
+ *
+ * Регистры не трогаются: если следующий контекст не владеет ими,
+ * взводится CR0.TS и работа откладывается до #NM.
+ * @param next Новый текущий контекст (NULL - загрузочный)
+ */
+void fpu_switch(fpu_context_t *next) {
+    if (!fpu_ready) {
+        return;
+    }
+    if (!next) {
+        next = &fpu_boot_context;
+    }
+
+    uint32_t flags = irq_save();
+    fpu_stats.switches++;
+    fpu_current_ctx = next;
+    if (fpu_owner == next && kernel_fpu_depth == 0) {
+        clts();
+    } else {
+        write_cr0(read_cr0() | CR0_TS);
+    }
+    irq_restore(flags);
+}
+
+/**
+ * @brief Текущий контекст FPU
+ */
+fpu_context_t* fpu_current(void) {
+    return fpu_current_ctx;
+}
+
+/**
+ * @brief Обработчик #NM (Device Not Available)
+ *
+ * Сохраняет регистры прежнего владельца, загружает состояние текущего
+ * контекста и сбрасывает CR0.TS. Выполняется с запрещёнными прерываниями.
+ */
+void fpu_device_not_available(void) {
+    fpu_stats.traps++;
+    clts();
+
+    if (!fpu_ready || fpu_owner == fpu_current_ctx) {
+        return;
+    }
+
+    if (fpu_owner) {
+        fpu_fxsave(fpu_owner);
+        fpu_stats.saves++;
+    }
+    fpu_fxrstor(fpu_current_ctx);
+    fpu_stats.restores++;
+    fpu_owner = fpu_current_ctx;
+}
+
+/**
+ * @brief Начало участка ядра, использующего FPU/SSE-регистры
+ *
+ * Сохраняет состояние владельца регистров (оно восстановится через #NM
+ * после kernel_fpu_end) и запрещает прерывания до конца участка:
+ * обработчики прерываний тоже могут вызвать kernel_fpu_begin. Вызовы
+ * допускают вложенность; участок должен быть коротким.
+ */
+void kernel_fpu_begin(void) {
+    uint32_t flags = irq_save();
+
+    if (kernel_fpu_depth++ > 0) {
+        return;
+    }
+    kernel_fpu_flags = flags;
+    fpu_stats.kernel_uses++;
+
+    if (!fpu_ready) {
+        return;
+    }
+
+    clts();
+    if (fpu_owner) {
+        fpu_fxsave(fpu_owner);
+        fpu_stats.saves++;
+        fpu_owner = NULL;
+    }
+}
+
+/**
+ * @brief Конец участка ядра, использующего FPU/SSE-регистры
+ *
+ * Регистры теперь содержат мусор ядра, поэтому взводится CR0.TS:
+ * текущий контекст получит своё состояние обратно через #NM.
+ */
+void kernel_fpu_end(void) {
+    if (kernel_fpu_depth == 0 || --kernel_fpu_depth > 0) {
+        return;
+    }
+
+    if (fpu_ready) {
+        write_cr0(read_cr0() | CR0_TS);
+    }
+    irq_restore(kernel_fpu_flags);
+}
+
+/**
+ * @brief Счётчики ленивого переключения
+ */
+const fpu_stats_t* fpu_get_stats(void) {
+    return &fpu_stats;
+}
+
+/**
+ * @brief Вывод состояния FPU и счётчиков переключения
+ */
+void fpu_dump_info(void) {
+    print_string("FPU Info:\n");
+    if (!fpu_ready) {
+        print_string("  - Disabled (no FXSAVE)\n");
+        return;
+    }
+
+    print_string("  - SSE: ");
+    print_string(fpu_sse ? "enabled\n" : "not supported\n");
+    print_string("  - CR0.TS: ");
+    print_dec((read_cr0() & CR0_TS) ? 1 : 0);
+    print_string(", owner ");
+    print_hex((uint32_t)fpu_owner);
+    print_string(", current ");
+    print_hex((uint32_t)fpu_current_ctx);
+    print_string("\n  - Switches: ");
+    print_dec(fpu_stats.switches);
+    print_string(", #NM traps: ");
+    print_dec(fpu_stats.traps);
+    print_string("\n  - FXSAVE: ");
+    print_dec(fpu_stats.saves);
+    print_string(", FXRSTOR: ");
+    print_dec(fpu_stats.restores);
+    print_string(", kernel sections: ");
+    print_dec(fpu_stats.kernel_uses);
+    print_string("\n");
+}
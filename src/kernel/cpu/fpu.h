@@ -0,0 +1,62 @@
+/**
+ * @file fpu.h
+ * @brief x87/SSE: включение при загрузке и ленивое переключение состояния
+ *
+ * Состояние FPU/SSE принадлежит контексту (fpu_context_t). При смене
+ * контекста fpu_switch только взводит CR0.TS; регистры сохраняются и
+ * загружаются в обработчике #NM, когда новый контекст действительно
+ * выполнит FPU/SSE-инструкцию. Код ядра, которому нужны векторные
+ * регистры, оборачивает их использование в kernel_fpu_begin/end.
+ */
+
+#ifndef KERNEL_FPU_H
+#define KERNEL_FPU_H
+
+#include <stdint.h>
+
+/* Размер области FXSAVE/FXRSTOR */
+#define FPU_STATE_SIZE 512
+/* Требуемое выравнивание области FXSAVE */
+#define FPU_STATE_ALIGN 16
+
+/* Значение MXCSR после сброса: все исключения SSE замаскированы */
+#define FPU_MXCSR_DEFAULT 0x1F80
+
+/**
+ * @brief Состояние FPU/SSE одного контекста (область FXSAVE)
+ */
+typedef struct {
+    uint8_t area[FPU_STATE_SIZE];
+} __attribute__((aligned(FPU_STATE_ALIGN))) fpu_context_t;
+
+/**
+ * @brief Счётчики ленивого переключения
+ */
+typedef struct {
+    uint32_t switches;     /* Вызовов fpu_switch */
+    uint32_t traps;        /* Исключений #NM */
+    uint32_t saves;        /* FXSAVE в область контекста */
+    uint32_t restores;     /* FXRSTOR из области контекста */
+    uint32_t kernel_uses;  /* Внешних секций kernel_fpu_begin/end */
+} fpu_stats_t;
+
+void fpu_init(void);
+int fpu_has_sse(void);
+
+fpu_context_t* fpu_context_create(void);
+void fpu_context_destroy(fpu_context_t *ctx);
+void fpu_switch(fpu_context_t *next);
+fpu_context_t* fpu_current(void);
+
+void fpu_device_not_available(void);
+
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+
+const fpu_stats_t* fpu_get_stats(void);
+void fpu_dump_info(void);
+
+/* Самопроверка переключения контекстов (fpu_test.c) */
+void fpu_selftest(void);
+
+#endif /* KERNEL_FPU_H */
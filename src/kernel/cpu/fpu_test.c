@@ -0,0 +1,182 @@
+/**
+ * @file fpu_test.c
+ * @brief Самопроверка ленивого переключения состояния FPU/SSE
+ *
+ * Два контекста загружают разные значения в стек x87 и регистры
+ * XMM0-XMM7, затем попеременно становятся текущими через fpu_switch.
+ * Каждое переключение обслуживается #NM (FXSAVE прежнего владельца,
+ * FXRSTOR нового), и после него контекст должен увидеть свои значения.
+ */
+
+#include "fpu.h"
+#include "cpu.h"
+#include "../video/video.h"
+
+#define FPU_TEST_ROUNDS 4  /* Пар переключений A -> B */
+#define FPU_TEST_XMM 8     /* Регистров XMM в 32-битном режиме */
+
+/* Значения одного контекста: два элемента стека x87 и XMM0-XMM7 */
+typedef struct {
+    int32_t x87[2];
+    uint32_t xmm[FPU_TEST_XMM][4];
+} fpu_test_values_t;
+
+static void fpu_test_fill(fpu_test_values_t *values, uint32_t seed) {
+    values->x87[0] = (int32_t)(seed * 1000 + 1);
+    values->x87[1] = -(int32_t)(seed * 1000 + 2);
+    for (uint32_t i = 0; i < FPU_TEST_XMM; i++) {
+        for (uint32_t j = 0; j < 4; j++) {
+            values->xmm[i][j] = (seed << 24) | (i << 8) | j;
+        }
+    }
+}
+
+__attribute__((target("sse")))
+static void fpu_test_load_xmm(const fpu_test_values_t *values) {
+    __asm__ volatile("movups %0, %%xmm0" : : "m"(values->xmm[0]) : "xmm0");
+    __asm__ volatile("movups %0, %%xmm1" : : "m"(values->xmm[1]) : "xmm1");
+    __asm__ volatile("movups %0, %%xmm2" : : "m"(values->xmm[2]) : "xmm2");
+    __asm__ volatile("movups %0, %%xmm3" : : "m"(values->xmm[3]) : "xmm3");
+    __asm__ volatile("movups %0, %%xmm4" : : "m"(values->xmm[4]) : "xmm4");
+    __asm__ volatile("movups %0, %%xmm5" : : "m"(values->xmm[5]) : "xmm5");
+    __asm__ volatile("movups %0, %%xmm6" : : "m"(values->xmm[6]) : "xmm6");
+    __asm__ volatile("movups %0, %%xmm7" : : "m"(values->xmm[7]) : "xmm7");
+}
+
+__attribute__((target("sse")))
+static void fpu_test_store_xmm(fpu_test_values_t *values) {
+    __asm__ volatile("movups %%xmm0, %0" : "=m"(values->xmm[0]));
+    __asm__ volatile("movups %%xmm1, %0" : "=m"(values->xmm[1]));
+    __asm__ volatile("movups %%xmm2, %0" : "=m"(values->xmm[2]));
+    __asm__ volatile("movups %%xmm3, %0" : "=m"(values->xmm[3]));
+    __asm__ volatile("movups %%xmm4, %0" : "=m"(values->xmm[4]));
+    __asm__ volatile("movups %%xmm5, %0" : "=m"(values->xmm[5]));
+    __asm__ volatile("movups %%xmm6, %0" : "=m"(values->xmm[6]));
+    __asm__ volatile("movups %%xmm7, %0" : "=m"(values->xmm[7]));
+}
+
+/**
+ * @brief Загрузка значений в регистры текущего контекста
+ *
+ * После загрузки ST0 = x87[1], ST1 = x87[0].
+ */
+static void fpu_test_load(const fpu_test_values_t *values, int sse) {
+    __asm__ volatile("fninit\n\t"
+                     "fildl %0\n\t"
+                     "fildl %1"
+                     : : "m"(values->x87[0]), "m"(values->x87[1]));
+    if (sse) {
+        fpu_test_load_xmm(values);
+    }
+}
+
+/**
+ * @brief Чтение регистров текущего контекста без изменения стека x87
+ */
+static void fpu_test_store(fpu_test_values_t *values, int sse) {
+    __asm__ volatile("fistl %0\n\t"
+                     "fxch\n\t"
+                     "fistl %1\n\t"
+                     "fxch"
+                     : "=m"(values->x87[1]), "=m"(values->x87[0]));
+    if (sse) {
+        fpu_test_store_xmm(values);
+    }
+}
+
+/**
+ * @brief Сравнение прочитанных значений с загруженными
+ * @return Число несовпавших слов
+ */
+static uint32_t fpu_test_compare(const fpu_test_values_t *expected,
+                                 const fpu_test_values_t *actual, int sse) {
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < 2; i++) {
+        errors += expected->x87[i] != actual->x87[i];
+    }
+    for (uint32_t i = 0; sse && i < FPU_TEST_XMM; i++) {
+        for (uint32_t j = 0; j < 4; j++) {
+            errors += expected->xmm[i][j] != actual->xmm[i][j];
+        }
+    }
+    return errors;
+}
+
+/**
+ * @brief Проверка сохранения регистров при переключении контекстов FPU
+ *
+ * Регистры загрузочного контекста (оболочки) после проверки
+ * восстанавливаются так же лениво, через #NM.
+ */
+void fpu_selftest(void) {
+    print_string("\n=== FPU Context Switch Test ===\n");
+
+    fpu_context_t *a = fpu_context_create();
+    fpu_context_t *b = fpu_context_create();
+    if (!a || !b) {
+        print_string_color("SKIPPED", COLOR_YELLOW, COLOR_BLACK);
+        print_string(" (no FXSAVE or out of memory)\n");
+        fpu_context_destroy(a);
+        fpu_context_destroy(b);
+        return;
+    }
+
+    int sse = fpu_has_sse();
+    fpu_test_values_t expected_a, expected_b, actual;
+    fpu_test_fill(&expected_a, 0xA);
+    fpu_test_fill(&expected_b, 0xB);
+    fpu_stats_t before = *fpu_get_stats();
+
+    fpu_switch(a);
+    fpu_test_load(&expected_a, sse);
+    fpu_switch(b);
+    fpu_test_load(&expected_b, sse);
+
+    uint32_t errors = 0;
+    for (uint32_t round = 0; round < FPU_TEST_ROUNDS; round++) {
+        fpu_switch(a);
+        fpu_test_store(&actual, sse);
+        errors += fpu_test_compare(&expected_a, &actual, sse);
+
+        fpu_switch(b);
+        fpu_test_store(&actual, sse);
+        errors += fpu_test_compare(&expected_b, &actual, sse);
+    }
+
+    fpu_switch(NULL);
+    fpu_context_destroy(a);
+    fpu_context_destroy(b);
+
+    const fpu_stats_t *after = fpu_get_stats();
+    uint32_t traps = after->traps - before.traps;
+    uint32_t saves = after->saves - before.saves;
+    uint32_t restores = after->restores - before.restores;
+
+    print_string("  - Registers: x87 ST0-ST1");
+    print_string(sse ? ", XMM0-XMM7\n" : " (no SSE)\n");
+    print_string("  - Switches: ");
+    print_dec(after->switches - before.switches);
+    print_string(", #NM traps: ");
+    print_dec(traps);
+    print_string(", FXSAVE: ");
+    print_dec(saves);
+    print_string(", FXRSTOR: ");
+    print_dec(restores);
+    print_string("\n");
+
+    /* Каждое из 2 * FPU_TEST_ROUNDS + 2 переключений меняет владельца */
+    if (restores < 2 * FPU_TEST_ROUNDS + 2) {
+        errors++;
+        print_string("  - Lazy restore was not exercised\n");
+    }
+
+    print_string("Result: ");
+    if (errors == 0) {
+        print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color("FAILED", COLOR_RED, COLOR_BLACK);
+        print_string(" (");
+        print_dec(errors);
+        print_string(" mismatches)\n");
+    }
+}
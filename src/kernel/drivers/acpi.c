@@ -0,0 +1,117 @@
+/**
+ * @file acpi.c
+ * @brief Поиск таблиц ACPI
+ *
+ * XSDT предпочитается RSDT, если прошивка её даёт и она лежит ниже 4GB.
+ */
+
+#include <stddef.h>
+#include "acpi.h"
+
+/* Корневая таблица: RSDT (32-битные ссылки) или XSDT (64-битные) */
+static const acpi_sdt_header_t *acpi_root = NULL;
+static uint32_t acpi_entry_size = 0;
+
+/* Сегмент EBDA в области данных BIOS */
+const volatile uint16_t *acpi_ebda_segment = (const volatile uint16_t*)ACPI_EBDA_POINTER;
+
+/**
+ * @brief Сумма байт по модулю 256 (у правильной структуры - 0)
+ */
+static uint8_t acpi_checksum(const void *data, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+static int acpi_signature_eq(const char *a, const char *b, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Поиск RSDP на 16-байтных границах диапазона [start, end)
+ */
+static const acpi_rsdp_t* acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + 20 <= end; addr += 16) {
+        const acpi_rsdp_t *rsdp = (const acpi_rsdp_t*)addr;
+        if (acpi_signature_eq(rsdp->signature, "RSD PTR ", 8) && acpi_checksum(rsdp, 20) == 0) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Поиск RSDP и корневой таблицы
+ * @return 1, если таблицы ACPI найдены
+ */
+int acpi_init(void) {
+    uint32_t ebda = (uint32_t)*acpi_ebda_segment << 4;
+    const acpi_rsdp_t *rsdp = NULL;
+    if (ebda >= 0x80000 && ebda < ACPI_BIOS_START) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + ACPI_EBDA_SEARCH);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(ACPI_BIOS_START, ACPI_BIOS_END);
+    }
+    if (!rsdp) {
+        return 0;
+    }
+
+    const acpi_sdt_header_t *root = NULL;
+    if (rsdp->revision >= 2 && rsdp->xsdt_address && rsdp->xsdt_address < 0x100000000ULL &&
+        acpi_checksum(rsdp, rsdp->length) == 0) {
+        root = (const acpi_sdt_header_t*)(uint32_t)rsdp->xsdt_address;
+        acpi_entry_size = sizeof(uint64_t);
+        if (!acpi_signature_eq(root->signature, "XSDT", 4) || acpi_checksum(root, root->length) != 0) {
+            root = NULL;
+        }
+    }
+    if (!root) {
+        root = (const acpi_sdt_header_t*)rsdp->rsdt_address;
+        acpi_entry_size = sizeof(uint32_t);
+        if (!root || !acpi_signature_eq(root->signature, "RSDT", 4) ||
+            acpi_checksum(root, root->length) != 0) {
+            return 0;
+        }
+    }
+
+    acpi_root = root;
+    return 1;
+}
+
+/**
+ * @brief Поиск таблицы по сигнатуре
+ * @param signature Четыре символа, например "SRAT"
+ * @return Таблица с правильной контрольной суммой или NULL
+ */
+const acpi_sdt_header_t* acpi_find_table(const char *signature) {
+    if (!acpi_root) {
+        return NULL;
+    }
+
+    const uint8_t *entries = (const uint8_t*)acpi_root + sizeof(acpi_sdt_header_t);
+    uint32_t count = (acpi_root->length - sizeof(acpi_sdt_header_t)) / acpi_entry_size;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *entry = entries + i * acpi_entry_size;
+        uint64_t addr = acpi_entry_size == sizeof(uint64_t) ? *(const uint64_t*)entry
+                                                           : *(const uint32_t*)entry;
+        if (!addr || addr >= 0x100000000ULL) {
+            continue;
+        }
+        const acpi_sdt_header_t *table = (const acpi_sdt_header_t*)(uint32_t)addr;
+        if (acpi_signature_eq(table->signature, signature, 4) &&
+            acpi_checksum(table, table->length) == 0) {
+            return table;
+        }
+    }
+    return NULL;
+}
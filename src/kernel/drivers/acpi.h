@@ -0,0 +1,61 @@
+/**
+ * @file acpi.h
+ * @brief Поиск таблиц ACPI (RSDP, RSDT/XSDT)
+ *
+ * Только чтение таблиц прошивки: RSDP ищется в EBDA и в области BIOS
+ * 0xE0000-0xFFFFF, таблицы находятся по сигнатуре через RSDT или XSDT.
+ * Таблицы читаются по физическим адресам, поэтому искать их нужно до
+ * включения страничной адресации (см. numa_init).
+ */
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+/* Области поиска RSDP */
+#define ACPI_EBDA_POINTER 0x40E      /* Сегмент EBDA в области данных BIOS */
+#define ACPI_EBDA_SEARCH 1024        /* Просматриваемая часть EBDA */
+#define ACPI_BIOS_START 0xE0000
+#define ACPI_BIOS_END 0x100000
+
+/* Заголовок любой системной таблицы (SDT) */
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+/* Root System Description Pointer (ACPI 2.0+) */
+typedef struct {
+    char signature[8];               /* "RSD PTR " */
+    uint8_t checksum;                /* Сумма первых 20 байт */
+    char oem_id[6];
+    uint8_t revision;                /* 0 - ACPI 1.0 (только RSDT) */
+    uint32_t rsdt_address;
+    uint32_t length;                 /* Поля ниже - только при revision >= 2 */
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+/**
+ * @brief Поиск RSDP и корневой таблицы
+ * @return 1, если таблицы ACPI найдены
+ */
+int acpi_init(void);
+
+/**
+ * @brief Поиск таблицы по сигнатуре
+ * @param signature Четыре символа, например "SRAT"
+ * @return Таблица с правильной контрольной суммой или NULL
+ */
+const acpi_sdt_header_t* acpi_find_table(const char *signature);
+
+#endif /* ACPI_H */
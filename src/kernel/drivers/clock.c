@@ -0,0 +1,286 @@
+/**
+ * @file clock.c
+ * @brief Источник времени: TSC, откалиброванный по каналу 2 PIT
+ *
+ * Канал 2 PIT отсчитывает CLOCK_CAL_COUNTS периодов кварца 1.19 МГц
+ * (около 50 мс) в режиме 0, а за это время считаются такты TSC и
+ * отсчёты таймера LAPIC. Из медианы нескольких замеров выводятся
+ * частоты и множитель mult/shift: нс = (такты * mult) >> shift.
+ *
+ * clock_ns только читает TSC и неизменяемые после загрузки поля, поэтому
+ * безопасен в обработчиках прерываний и не требует блокировок. Деление
+ * 64-битных чисел (калибровка, clock_ms) делается инструкцией divl:
+ * libgcc ядру недоступна.
+ */
+
+#include "clock.h"
+#include "../video/video.h"
+#include "../idt/idt.h"
+#include "../cpu/cpu.h"
+#include "../memory/memory.h"
+
+clocksource_t clocksource = { .name = "pit" };
+
+/* Регистры локального APIC (NULL - недоступен) */
+static volatile uint32_t *lapic_regs;
+
+/**
+ * @brief Деление 64-битного числа на 32-битное (две инструкции divl)
+ */
+static uint64_t clock_div64(uint64_t dividend, uint32_t divisor) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t quotient_high = high / divisor;
+    uint32_t quotient_low, remainder;
+
+    /* Остаток старшей части меньше делителя - частное divl в 32 битах */
+    __asm__("divl %4"
+            : "=a"(quotient_low), "=d"(remainder)
+            : "a"((uint32_t)dividend), "d"(high % divisor), "rm"(divisor));
+    return ((uint64_t)quotient_high << 32) | quotient_low;
+}
+
+/**
+ * @brief (value * mult) >> shift с 96-битным промежуточным произведением
+ * @param shift Сдвиг (0..63)
+ */
+static uint64_t clock_mul_shift(uint64_t value, uint32_t mult, uint32_t shift) {
+    uint64_t low = (uint64_t)(uint32_t)value * mult;
+    uint64_t high = (value >> 32) * mult;
+    uint64_t middle = high + (low >> 32); /* Произведение >> 32 */
+
+    if (shift >= 32) {
+        return middle >> (shift - 32);
+    }
+    return (middle << (32 - shift)) | ((uint32_t)low >> shift);
+}
+
+static uint32_t lapic_read(uint32_t reg) {
+    return lapic_regs[reg / sizeof(uint32_t)];
+}
+
+static void lapic_write(uint32_t reg, uint32_t value) {
+    lapic_regs[reg / sizeof(uint32_t)] = value;
+}
+
+/**
+ * @brief Подготовка таймера LAPIC к калибровке
+ *
+ * Регистры LAPIC отображаются 1:1 без кэширования; таймер считает
+ * с делителем 16, его прерывание замаскировано.
+ */
+static void clock_lapic_init(uint32_t features) {
+    if (!(features & CPUID_EDX_MSR) || !(features & CPUID_EDX_APIC)) {
+        return;
+    }
+
+    uint32_t base = (uint32_t)rdmsr(MSR_APIC_BASE);
+    if (!(base & APIC_BASE_ENABLE)) {
+        return;
+    }
+    base &= APIC_BASE_MASK;
+    if (vmm_identity_map(base, PAGE_SIZE, VMM_WRITE | VMM_NOCACHE) != 0) {
+        return;
+    }
+
+    lapic_regs = (volatile uint32_t*)base;
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    lapic_write(LAPIC_TIMER_LVT, LAPIC_LVT_MASKED);
+}
+
+/**
+ * @brief Один замер интервала канала 2 PIT
+ *
+ * Прерывания не запрещаются: обработчик лишь немного задерживает
+ * обнаружение конца интервала, а медиана замеров сглаживает выбросы.
+ * @param lapic_counts Отсчёты таймера LAPIC за интервал
+ * @return Такты TSC за интервал
+ */
+static uint32_t clock_calibrate_once(uint32_t *lapic_counts) {
+    uint8_t gate = read_port(PIT_GATE_PORT);
+    write_port(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_ENABLE);
+
+    /* Режим 0: OUT2 поднимается, когда счёт дойдёт до нуля */
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL2 | PIT_CMD_ACCESS_LOHI | PIT_CMD_MODE0);
+    write_port(PIT_CHANNEL2_PORT, CLOCK_CAL_COUNTS & 0xFF);
+    write_port(PIT_CHANNEL2_PORT, (CLOCK_CAL_COUNTS >> 8) & 0xFF);
+
+    if (lapic_regs) {
+        lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    }
+    uint64_t start = rdtsc();
+    while (!(read_port(PIT_GATE_PORT) & PIT_GATE_OUT2)) {
+        __asm__ volatile("pause");
+    }
+    uint64_t end = rdtsc();
+
+    *lapic_counts = 0;
+    if (lapic_regs) {
+        *lapic_counts = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+        lapic_write(LAPIC_TIMER_INIT, 0);
+    }
+
+    write_port(PIT_GATE_PORT, gate);
+    return (uint32_t)(end - start);
+}
+
+/**
+ * @brief Медиана замеров (массив сортируется)
+ */
+static uint32_t clock_median(uint32_t *values, uint32_t count) {
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t value = values[i];
+        uint32_t j = i;
+        while (j > 0 && values[j - 1] > value) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = value;
+    }
+    return values[count / 2];
+}
+
+/**
+ * @brief Калибровка TSC и таймера LAPIC по каналу 2 PIT
+ *
+ * Без TSC источником остаются тики PIT. Отсчёт clock_ns продолжает
+ * время, прошедшее до калибровки по тикам.
+ */
+void clock_init(void) {
+    print_string("Clocksource calibration... ");
+
+    uint32_t eax, ebx, ecx, features;
+    cpuid(1, &eax, &ebx, &ecx, &features);
+    if (!(features & CPUID_EDX_TSC)) {
+        print_string_color("no TSC\n", COLOR_YELLOW, COLOR_BLACK);
+        return;
+    }
+
+    uint32_t edx;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000007) {
+        cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        clocksource.invariant = (edx & CPUID_EDX_INVARIANT_TSC) != 0;
+    }
+    clock_lapic_init(features);
+
+    uint32_t cycles[CLOCK_CAL_ROUNDS];
+    uint32_t lapic[CLOCK_CAL_ROUNDS];
+    for (uint32_t i = 0; i < CLOCK_CAL_ROUNDS; i++) {
+        cycles[i] = clock_calibrate_once(&lapic[i]);
+    }
+    uint32_t delta = clock_median(cycles, CLOCK_CAL_ROUNDS);
+    uint32_t lapic_delta = clock_median(lapic, CLOCK_CAL_ROUNDS);
+    if (!delta) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+
+    /* Наибольший сдвиг, при котором mult помещается в 32 бита */
+    uint32_t shift = 32;
+    while (shift && (((uint64_t)CLOCK_CAL_NS << shift) >> 32) >= delta) {
+        shift--;
+    }
+
+    uint32_t tick_ns = 1000000000 / pit_get_frequency();
+    uint32_t flags = irq_save();
+    clocksource.tsc_khz = (uint32_t)clock_div64((uint64_t)delta * 1000000, CLOCK_CAL_NS);
+    clocksource.lapic_khz = (uint32_t)clock_div64((uint64_t)lapic_delta * 1000000, CLOCK_CAL_NS);
+    clocksource.base_ns = (uint64_t)pit_get_ticks() * tick_ns;
+    clocksource.base_cycles = rdtsc();
+    clocksource.shift = shift;
+    clocksource.mult = (uint32_t)clock_div64((uint64_t)CLOCK_CAL_NS << shift, delta);
+    clocksource.name = "tsc";
+    irq_restore(flags);
+
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - TSC: ");
+    print_dec(clocksource.tsc_khz / 1000);
+    print_string(" MHz");
+    if (clocksource.invariant) {
+        print_string(" (invariant)");
+    }
+    print_string("\n");
+    if (clocksource.lapic_khz) {
+        print_string("  - LAPIC timer: ");
+        print_dec(clocksource.lapic_khz);
+        print_string(" kHz (divide by 16)\n");
+    }
+}
+
+/**
+ * @brief Перевод тактов TSC в наносекунды
+ * @return 0, если TSC не откалиброван
+ */
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    return clock_mul_shift(cycles, clocksource.mult, clocksource.shift);
+}
+
+/**
+ * @brief Монотонное время с загрузки в наносекундах
+ *
+ * Без TSC разрешение - один тик PIT.
+ */
+uint64_t clock_ns(void) {
+    if (!clocksource.mult) {
+        return (uint64_t)pit_get_ticks() * (1000000000 / pit_get_frequency());
+    }
+    return clocksource.base_ns + clock_cycles_to_ns(rdtsc() - clocksource.base_cycles);
+}
+
+/**
+ * @brief Монотонное время с загрузки в миллисекундах
+ */
+uint64_t clock_ms(void) {
+    return clock_div64(clock_ns(), 1000000);
+}
+
+/**
+ * @brief Частота TSC в кГц (0 - не откалиброван)
+ */
+uint32_t clock_tsc_khz(void) {
+    return clocksource.tsc_khz;
+}
+
+/**
+ * @brief Активное ожидание на указанное число микросекунд
+ *
+ * Без TSC ожидание идёт по тикам PIT и требует разрешённых прерываний.
+ * @param us Количество микросекунд
+ */
+void udelay(uint32_t us) {
+    uint64_t deadline = clock_ns() + (uint64_t)us * 1000;
+    while (clock_ns() < deadline) {
+        __asm__ volatile("pause");
+    }
+}
+
+/**
+ * @brief Вывод информации об источнике времени
+ */
+void clock_dump_info(void) {
+    print_string("Clocksource Info:\n");
+    print_string("  - Source: ");
+    print_string(clocksource.name);
+    print_string("\n");
+    if (clocksource.mult) {
+        print_string("  - TSC: ");
+        print_dec(clocksource.tsc_khz);
+        print_string(" kHz");
+        if (clocksource.invariant) {
+            print_string(" (invariant)");
+        }
+        print_string(", mult ");
+        print_dec(clocksource.mult);
+        print_string(" >> ");
+        print_dec(clocksource.shift);
+        print_string("\n");
+    }
+    if (clocksource.lapic_khz) {
+        print_string("  - LAPIC timer: ");
+        print_dec(clocksource.lapic_khz);
+        print_string(" kHz (divide by 16)\n");
+    }
+    print_string("  - Uptime: ");
+    print_dec((uint32_t)clock_ms());
+    print_string(" ms\n");
+}
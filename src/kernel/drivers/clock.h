@@ -0,0 +1,95 @@
+/**
+ * @file clock.h
+ * @brief Источник времени: TSC, откалиброванный по каналу 2 PIT
+ *
+ * При загрузке частоты TSC и таймера LAPIC измеряются по интервалу
+ * канала 2 PIT. clock_ns переводит такты TSC в наносекунды умножением
+ * и сдвигом: без блокировок, прерываний и 64-битного деления.
+ * Без TSC время идёт по тикам PIT.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include "pit.h"
+
+/* Канал 2 PIT и его вентиль (порт системного управления) */
+#define PIT_CHANNEL2_PORT 0x42
+#define PIT_CMD_CHANNEL2 0x80
+#define PIT_GATE_PORT 0x61
+#define PIT_GATE_ENABLE 0x01   /* Вентиль канала 2 открыт */
+#define PIT_GATE_SPEAKER 0x02  /* Выход канала 2 на динамик */
+#define PIT_GATE_OUT2 0x20     /* Состояние выхода канала 2 */
+
+/* Интервал калибровки: 59659 отсчётов PIT - около 50 мс */
+#define CLOCK_CAL_COUNTS 59659
+#define CLOCK_CAL_NS ((uint32_t)((CLOCK_CAL_COUNTS * 1000000000ULL) / PIT_FREQUENCY))
+#define CLOCK_CAL_ROUNDS 3     /* Замеров; берётся медиана */
+
+/* Локальный APIC */
+#define MSR_APIC_BASE 0x1B
+#define APIC_BASE_ENABLE (1u << 11)
+#define APIC_BASE_MASK 0xFFFFF000
+#define LAPIC_TIMER_LVT 0x320
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+#define LAPIC_LVT_MASKED 0x10000
+#define LAPIC_DIVIDE_16 0x3
+
+/* Состояние источника времени */
+typedef struct {
+    const char *name;      /* "tsc" или "pit" */
+    uint32_t mult;         /* нс = (такты * mult) >> shift */
+    uint32_t shift;
+    uint32_t tsc_khz;      /* Частота TSC */
+    uint32_t lapic_khz;    /* Частота таймера LAPIC (делитель 16), 0 - нет */
+    uint32_t invariant;    /* TSC не останавливается в режимах простоя */
+    uint64_t base_cycles;  /* TSC в момент калибровки */
+    uint64_t base_ns;      /* Время с загрузки в этот момент */
+} clocksource_t;
+
+extern clocksource_t clocksource;
+
+/**
+ * @brief Калибровка TSC и таймера LAPIC по каналу 2 PIT
+ *
+ * Вызывается после pit_init и vmm_init (регистры LAPIC - MMIO).
+ */
+void clock_init(void);
+
+/**
+ * @brief Монотонное время с загрузки в наносекундах
+ */
+uint64_t clock_ns(void);
+
+/**
+ * @brief Монотонное время с загрузки в миллисекундах
+ */
+uint64_t clock_ms(void);
+
+/**
+ * @brief Перевод тактов TSC в наносекунды
+ */
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+/**
+ * @brief Частота TSC в кГц (0 - не откалиброван)
+ */
+uint32_t clock_tsc_khz(void);
+
+/**
+ * @brief Активное ожидание на указанное число микросекунд
+ */
+void udelay(uint32_t us);
+
+/**
+ * @brief Вывод информации об источнике времени
+ */
+void clock_dump_info(void);
+
+/* Бенчмарк источника времени */
+void clock_benchmark(void);
+
+#endif /* CLOCK_H */
@@ -11,6 +11,7 @@
 
 #include "keyboard.h"
 #include "../video/video.h"
+#include "pit.h"
 #include "../idt/idt.h"
 #include "../memory/memory.h"
 
@@ -166,13 +167,14 @@ char keyboard_read(void) {
 
 /**
  * Чтение строки с клавиатуры до нажатия Enter
+ * @param arena Арена, из которой выделяется буфер строки
  * @param max_length Максимальная длина строки (включая нулевой символ)
- * @return Указатель на выделенную память с введенной строкой или NULL при ошибке
- * @note Вызывающий код должен освободить память с помощью kfree()
+ * @return Указатель на строку в арене или NULL при ошибке
+ * @note Память освобождается вместе с ареной (arena_reset/arena_restore)
  */
-char* read_line(unsigned int max_length) {
-    /* Выделяем динамический буфер */
-    char* buffer = (char*)kmalloc(max_length);
+char* read_line(arena_t *arena, unsigned int max_length) {
+    /* Выделяем буфер в арене */
+    char* buffer = (char*)arena_alloc(arena, max_length);
     if (!buffer) {
         return NULL; /* Не удалось выделить память */
     }
@@ -193,7 +195,7 @@ char* read_line(unsigned int max_length) {
                 }
                 print_string("\n");
                 disable_cursor();
-                return buffer;  /* Возвращаем указатель на динамический буфер */
+                return buffer;  /* Возвращаем указатель на буфер в арене */
             } 
             else if (input == '\b') {
                 if (pos > 0) {
@@ -218,9 +220,11 @@ char* read_line(unsigned int max_length) {
                 update_cursor(cursor_pos / 2);
             }
         } else {
-            /* Если нет ввода, используем hlt для экономии энергии */
+            /* Если нет ввода, обнуляем освобождённые страницы, затем спим */
             /* Процессор будет пробужден прерыванием от клавиатуры */
-            __asm__ volatile("hlt");
+            if (!pmm_idle_work()) {
+                pit_idle(0);
+            }
         }
     }
 }
\ No newline at end of file
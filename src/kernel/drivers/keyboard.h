@@ -7,6 +7,7 @@
  */
 
 #include "../video/video.h"
+#include "../memory/memory.h"
 
 #ifndef KERNEL_KEYBOARD_H
 #define KERNEL_KEYBOARD_H
@@ -49,9 +50,10 @@ char keyboard_read(void);
 
 /**
  * Чтение строки с клавиатуры до нажатия Enter
- * @param buffer Буфер для сохранения строки
+ * @param arena Арена, из которой выделяется буфер строки
  * @param max_length Максимальная длина строки (включая нулевой символ)
+ * @return Строка в арене или NULL при ошибке
  */
-char* read_line(unsigned int max_length);
+char* read_line(arena_t *arena, unsigned int max_length);
 
 #endif /* KERNEL_KEYBOARD_H */
\ No newline at end of file
@@ -7,31 +7,107 @@
  * - Подсчет системных тиков
  * - Функции задержки и измерения времени
  * - Основу для многозадачности
+ *
+ * Периодические тики идут в режиме 2 (счёт убывает линейно и читается).
+ * В простое pit_idle переводит канал 0 в однократный режим 0 до
+ * ближайшего срока, а прошедшие тики учитывает при пробуждении, так что
+ * простаивающее ядро не будится 100 раз в секунду.
  */
 
 #include "pit.h"
+#include "clock.h"
 #include "../video/video.h"
 #include "../idt/idt.h"
+#include "../memory/memory.h"
 
 /* Глобальная переменная для подсчета тиков */
 uint32_t system_ticks = 0;
 
 /* Текущая частота системного таймера */
 static uint32_t current_frequency = SYSTEM_TIMER_FREQUENCY;
+static uint16_t current_divisor = PIT_DIVISOR;
+
+/* Однократный режим простоя */
+static volatile int pit_oneshot;        /* Канал 0 в режиме 0, периодических тиков нет */
+static volatile int pit_stale_irq;      /* Ждущее IRQ0 уже учтено */
+static uint16_t pit_oneshot_count;      /* Запрограммированный счёт */
+static uint16_t pit_oneshot_first;      /* Счёт до первой границы тика */
+
+/* Статистика простоя */
+static uint32_t pit_idle_sleeps;        /* Входов в однократный режим */
+static uint32_t pit_idle_early;         /* Из них прервано другим прерыванием */
+static uint32_t pit_idle_ticks;         /* Тиков, прошедших без прерываний */
 
 /**
- * @brief Настройка делителя PIT
+ * @brief Запись начального счёта канала 0
+ */
+static void pit_write_count(uint16_t count) {
+    /* Отправляем младший байт */
+    write_port(PIT_CHANNEL0_PORT, count & 0xFF);
+    
+    /* Отправляем старший байт */
+    write_port(PIT_CHANNEL0_PORT, (count >> 8) & 0xFF);
+}
+
+/**
+ * @brief Настройка делителя PIT (периодический режим)
  * @param divisor Делитель частоты
  */
 static void pit_set_divisor(uint16_t divisor) {
     /* Отправляем команду на PIT */
-    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_ACCESS_LOHI | PIT_CMD_MODE3);
-    
-    /* Отправляем делитель (младший байт) */
-    write_port(PIT_CHANNEL0_PORT, divisor & 0xFF);
-    
-    /* Отправляем делитель (старший байт) */
-    write_port(PIT_CHANNEL0_PORT, (divisor >> 8) & 0xFF);
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_ACCESS_LOHI | PIT_CMD_MODE2);
+    pit_write_count(divisor);
+}
+
+/**
+ * @brief Текущий счёт канала 0
+ */
+static uint16_t pit_read_count(void) {
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_LATCH);
+    uint8_t low = read_port(PIT_CHANNEL0_PORT);
+    uint8_t high = read_port(PIT_CHANNEL0_PORT);
+    return low | (high << 8);
+}
+
+/**
+ * @brief Ждёт ли IRQ0 обработки в PIC
+ */
+static int pit_irq_pending(void) {
+    write_port(0x20, 0x0A); /* OCW3: чтение IRR */
+    return read_port(0x20) & 1;
+}
+
+/**
+ * @brief Выход из однократного режима
+ *
+ * Прошедшее время читается из счётчика (в режиме 0 он убывает и после
+ * срабатывания), поэтому срок и раннее пробуждение учитываются одинаково.
+ * Периодический режим возобновляется с остатком до следующей границы
+ * тика, и фаза тиков не сдвигается. Вызывается с запрещёнными прерываниями.
+ */
+static void pit_oneshot_stop(void) {
+    uint32_t elapsed = (uint16_t)(pit_oneshot_count - pit_read_count());
+    uint32_t ticks = 0;
+    uint32_t next = pit_oneshot_first;
+
+    if (elapsed >= pit_oneshot_first) {
+        ticks = 1 + (elapsed - pit_oneshot_first) / current_divisor;
+        next = pit_oneshot_first + ticks * current_divisor;
+    }
+
+    /* Первый период - остаток до тика, затем обычный делитель */
+    uint32_t rest = next - elapsed;
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_ACCESS_LOHI | PIT_CMD_MODE2);
+    pit_write_count(rest < 2 ? 2 : rest);
+    pit_write_count(current_divisor);
+
+    system_ticks += ticks;
+    pit_idle_ticks += ticks;
+    pit_oneshot = 0;
+
+    /* Смена режима поднимает OUT (или срок наступил во время чтения):
+     * такое IRQ0 уже учтено */
+    pit_stale_irq = pit_irq_pending();
 }
 
 /**
@@ -44,6 +120,7 @@ void pit_init(void) {
     
     /* Сбрасываем счетчик тиков */
     system_ticks = 0;
+    current_divisor = PIT_DIVISOR;
     
     /* Настраиваем PIT на желаемую частоту */
     pit_set_divisor(PIT_DIVISOR);
@@ -65,11 +142,19 @@ void pit_init(void) {
  * @brief Обработчик прерывания системного таймера
  * 
  * Вызывается при каждом тике таймера. Увеличивает счетчик тиков
- * и может использоваться для планирования задач.
+ * и может использоваться для планирования задач. В однократном
+ * режиме учитывает все тики, прошедшие во сне.
  */
 void pit_handler(void) {
-    /* Увеличиваем счетчик тиков */
-    system_ticks++;
+    if (pit_stale_irq) {
+        pit_stale_irq = 0;
+    } else if (pit_oneshot) {
+        /* Срок однократного режима: учитываем все тики сна */
+        pit_oneshot_stop();
+    } else {
+        /* Увеличиваем счетчик тиков */
+        system_ticks++;
+    }
     
     /* Отправляем EOI (End of Interrupt) в PIC */
     write_port(0x20, 0x20);
@@ -77,12 +162,58 @@ void pit_handler(void) {
 
 /**
  * @brief Получение количества системных тиков
+ *
+ * Во сне pit_idle счётчик отстаёт; вызванная из обработчика
+ * прерывания, функция сначала учитывает прошедшие тики.
  * @return Количество тиков с момента загрузки
  */
 uint32_t pit_get_ticks(void) {
+    if (pit_oneshot) {
+        pit_oneshot_stop(); /* Процессор спит - мы в обработчике прерывания */
+    }
     return system_ticks;
 }
 
+/**
+ * @brief Ожидание прерывания без периодических тиков
+ *
+ * Канал 0 переводится в однократный режим до границы тика через ticks
+ * тиков (не дальше PIT_ONESHOT_MAX), и процессор останавливается hlt.
+ * Тики сна учитываются при пробуждении - по сроку или по любому другому
+ * прерыванию. Если до срока меньше двух тиков, хватает обычного hlt.
+ * Бессрочного сна нет: даже pit_idle(0) просыпается через ~50 мс.
+ * @param ticks Наибольшая длительность сна в тиках (0 - сколько позволяет
+ *              PIT_ONESHOT_MAX)
+ */
+void pit_idle(uint32_t ticks) {
+    __asm__ volatile("cli");
+    uint32_t first = pit_read_count();
+    uint32_t max_ticks = first < PIT_ONESHOT_MAX ? 1 + (PIT_ONESHOT_MAX - first) / current_divisor : 1;
+    if (!ticks || ticks > max_ticks) {
+        ticks = max_ticks;
+    }
+    if (ticks < 2 || first < PIT_ONESHOT_MARGIN || pit_irq_pending()) {
+        __asm__ volatile("sti; hlt");
+        return;
+    }
+
+    pit_oneshot_first = first;
+    pit_oneshot_count = first + (ticks - 1) * current_divisor;
+    pit_oneshot = 1;
+    pit_idle_sleeps++;
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_ACCESS_LOHI | PIT_CMD_MODE0);
+    pit_write_count(pit_oneshot_count);
+
+    /* sti откладывает прерывания до конца hlt - пробуждение не теряется */
+    __asm__ volatile("sti; hlt; cli");
+    if (pit_oneshot) {
+        /* Разбудило другое прерывание - срок ещё не наступил */
+        pit_oneshot_stop();
+        pit_idle_early++;
+    }
+    __asm__ volatile("sti");
+}
+
 /**
  * @brief Задержка на указанное количество миллисекунд
  * @param ms Количество миллисекунд для задержки
@@ -92,8 +223,10 @@ void pit_sleep_ms(uint32_t ms) {
     
     /* Ждем, пока не достигнем целевого количества тиков */
     while (system_ticks < target_ticks) {
-        /* Используем инструкцию hlt для экономии энергии */
-        __asm__ volatile("hlt");
+        /* Время ожидания используем для фоновой работы PMM, затем спим до срока */
+        if (!pmm_idle_work()) {
+            pit_idle(target_ticks - system_ticks);
+        }
     }
 }
 
@@ -106,17 +239,48 @@ void pit_sleep_ticks(uint32_t ticks) {
     
     /* Ждем, пока не достигнем целевого количества тиков */
     while (system_ticks < target_ticks) {
-        /* Используем инструкцию hlt для экономии энергии */
-        __asm__ volatile("hlt");
+        /* Время ожидания используем для фоновой работы PMM, затем спим до срока */
+        if (!pmm_idle_work()) {
+            pit_idle(target_ticks - system_ticks);
+        }
+    }
+}
+
+/**
+ * @brief Задержка на указанное количество микросекунд
+ *
+ * Целые тики проходят во сне pit_idle, остаток - в активном ожидании
+ * по clock_ns.
+ * @param us Количество микросекунд для задержки
+ */
+void pit_sleep_us(uint32_t us) {
+    uint64_t deadline = clock_ns() + (uint64_t)us * 1000;
+    uint32_t tick_ns = 1000000000 / current_frequency;
+
+    for (;;) {
+        uint64_t now = clock_ns();
+        if (now >= deadline || deadline - now < tick_ns) {
+            break;
+        }
+        uint64_t left = deadline - now;
+        uint32_t ticks = (left > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)left) / tick_ns;
+        if (!pmm_idle_work()) {
+            pit_idle(ticks);
+        }
+    }
+    while (clock_ns() < deadline) {
+        __asm__ volatile("pause");
     }
 }
 
 /**
  * @brief Получение времени в миллисекундах с момента загрузки
+ *
+ * Обёртка над clock_ns: 32-битное значение переполняется через 49 дней.
  * @return Время в миллисекундах
  */
 uint32_t pit_get_time_ms(void) {
-    return (system_ticks * 1000) / current_frequency;
+    return (uint32_t)clock_ms();
 }
 
 /**
@@ -136,6 +300,7 @@ void pit_set_frequency(uint32_t frequency) {
     
     /* Обновляем текущую частоту */
     current_frequency = frequency;
+    current_divisor = divisor;
 }
 
 /**
@@ -160,4 +325,11 @@ void pit_dump_info(void) {
     print_string("  - Time since boot: ");
     print_dec(pit_get_time_ms());
     print_string(" ms\n");
+    print_string("  - Tickless idle: ");
+    print_dec(pit_idle_sleeps);
+    print_string(" sleeps (");
+    print_dec(pit_idle_early);
+    print_string(" woken early), ");
+    print_dec(pit_idle_ticks);
+    print_string(" ticks slept\n");
 } 
\ No newline at end of file
@@ -19,7 +19,10 @@
 /* Команды PIT */
 #define PIT_CMD_CHANNEL0 0x00
 #define PIT_CMD_ACCESS_LOHI 0x30
+#define PIT_CMD_MODE0 0x00 /* Прерывание по окончании счёта (однократно) */
+#define PIT_CMD_MODE2 0x04 /* Генератор частоты: счёт убывает по 1 */
 #define PIT_CMD_MODE3 0x06
+#define PIT_CMD_LATCH 0x00 /* Защёлкнуть текущий счёт канала */
 
 /* Частота PIT (в Гц) */
 #define PIT_FREQUENCY 1193180
@@ -30,6 +33,16 @@
 /* Максимальное значение счетчика для заданной частоты */
 #define PIT_DIVISOR (PIT_FREQUENCY / SYSTEM_TIMER_FREQUENCY)
 
+/* Наибольший однократный счёт: после срабатывания счётчик продолжает
+ * убывать, и запас до 0xFFFF позволяет прочитать, сколько прошло.
+ * Поэтому один сон длится не дольше 0xF000 / PIT_FREQUENCY, около 51 мс
+ * (5 тиков при 100 Гц) - предел 16-битного счётчика PIT */
+#define PIT_ONESHOT_MAX 0xF000
+
+/* Меньше этого счёта до тика однократный режим не включается: тик
+ * может наступить, пока канал перепрограммируется */
+#define PIT_ONESHOT_MARGIN 256
+
 /* Глобальная переменная для подсчета тиков */
 extern uint32_t system_ticks;
 
@@ -43,8 +56,8 @@ void pit_init(void);
 /**
  * @brief Обработчик прерывания системного таймера
  * 
- * Вызывается при каждом тике таймера. Увеличивает счетчик тиков
- * и может использоваться для планирования задач.
+ * Вызывается при каждом тике таймера (или по сроку pit_idle).
+ * Увеличивает счетчик тиков и может использоваться для планирования задач.
  */
 void pit_handler(void);
 
@@ -54,12 +67,25 @@ void pit_handler(void);
  */
 uint32_t pit_get_ticks(void);
 
+/**
+ * @brief Ожидание прерывания без периодических тиков (tickless idle)
+ * @param ticks Наибольшая длительность сна в тиках (0 - сколько позволяет
+ *              PIT_ONESHOT_MAX, около 50 мс)
+ */
+void pit_idle(uint32_t ticks);
+
 /**
  * @brief Задержка на указанное количество миллисекунд
  * @param ms Количество миллисекунд для задержки
  */
 void pit_sleep_ms(uint32_t ms);
 
+/**
+ * @brief Задержка на указанное количество микросекунд
+ * @param us Количество микросекунд для задержки
+ */
+void pit_sleep_us(uint32_t us);
+
 /**
  * @brief Задержка на указанное количество тиков
  * @param ticks Количество тиков для задержки
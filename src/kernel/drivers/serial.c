@@ -0,0 +1,85 @@
+/**
+ * @file serial.c
+ * @brief Реализация драйвера последовательного порта COM1
+ *
+ * Порт работает в режиме опроса: перед каждым байтом ждём,
+ * пока освободится регистр передатчика.
+ */
+
+#include "serial.h"
+#include "../idt/idt.h"
+
+/* Порт прошёл петлевой тест при инициализации */
+static int serial_ready = 0;
+
+/**
+ * @brief Инициализация COM1: 115200 бод, 8N1, FIFO
+ */
+void serial_init(void) {
+    write_port(SERIAL_COM1 + SERIAL_INT_ENABLE, 0x00);       /* Без прерываний */
+    write_port(SERIAL_COM1 + SERIAL_LINE_CTRL, SERIAL_LCR_DLAB);
+    write_port(SERIAL_COM1 + SERIAL_DATA, SERIAL_DIVISOR & 0xFF);
+    write_port(SERIAL_COM1 + SERIAL_INT_ENABLE, (SERIAL_DIVISOR >> 8) & 0xFF);
+    write_port(SERIAL_COM1 + SERIAL_LINE_CTRL, SERIAL_LCR_8N1);
+    write_port(SERIAL_COM1 + SERIAL_FIFO_CTRL, 0xC7);        /* FIFO, очистка, порог 14 байт */
+
+    /* Петлевой тест: отправленный байт должен вернуться */
+    write_port(SERIAL_COM1 + SERIAL_MODEM_CTRL, 0x1E);
+    write_port(SERIAL_COM1 + SERIAL_DATA, 0xAE);
+    if (read_port(SERIAL_COM1 + SERIAL_DATA) != 0xAE) {
+        serial_ready = 0;
+        return;
+    }
+
+    /* Обычный режим: DTR, RTS, OUT2 */
+    write_port(SERIAL_COM1 + SERIAL_MODEM_CTRL, 0x0F);
+    serial_ready = 1;
+}
+
+/**
+ * @brief Проверка, что порт найден и инициализирован
+ */
+int serial_is_ready(void) {
+    return serial_ready;
+}
+
+/**
+ * @brief Вывод символа в порт ('\n' дополняется '\r')
+ */
+void serial_write_char(char c) {
+    if (!serial_ready) {
+        return;
+    }
+
+    if (c == '\n') {
+        serial_write_char('\r');
+    }
+    while (!(read_port(SERIAL_COM1 + SERIAL_LINE_STATUS) & SERIAL_LSR_THR_EMPTY)) {
+        /* Ждём освобождения передатчика */
+    }
+    write_port(SERIAL_COM1 + SERIAL_DATA, (uint8_t)c);
+}
+
+/**
+ * @brief Вывод строки в порт
+ */
+void serial_write_string(const char *str) {
+    while (*str) {
+        serial_write_char(*str++);
+    }
+}
+
+/**
+ * @brief Вывод беззнакового числа в десятичном виде
+ */
+void serial_write_dec(uint32_t value) {
+    char buffer[11];
+    int pos = 10;
+
+    buffer[pos] = '\0';
+    do {
+        buffer[--pos] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    serial_write_string(&buffer[pos]);
+}
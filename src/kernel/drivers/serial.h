@@ -0,0 +1,63 @@
+/**
+ * @file serial.h
+ * @brief Драйвер последовательного порта COM1 (UART 16550)
+ *
+ * Только вывод, без прерываний: используется для машиночитаемых
+ * отчётов (membench) и отладочного лога, который QEMU пишет в файл
+ * или терминал.
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+/* Базовый порт COM1 */
+#define SERIAL_COM1 0x3F8
+
+/* Регистры UART относительно базового порта */
+#define SERIAL_DATA          0    /* Данные (DLAB=0) / младший байт делителя (DLAB=1) */
+#define SERIAL_INT_ENABLE    1    /* Разрешение прерываний / старший байт делителя */
+#define SERIAL_FIFO_CTRL     2
+#define SERIAL_LINE_CTRL     3
+#define SERIAL_MODEM_CTRL    4
+#define SERIAL_LINE_STATUS   5
+
+/* Биты регистров */
+#define SERIAL_LCR_DLAB      0x80 /* Доступ к делителю скорости */
+#define SERIAL_LCR_8N1       0x03 /* 8 бит, без чётности, 1 стоп-бит */
+#define SERIAL_LSR_THR_EMPTY 0x20 /* Передатчик готов принять байт */
+
+/* Делитель для 115200 бод (базовая частота 115200 Гц) */
+#define SERIAL_DIVISOR 1
+
+/**
+ * @brief Инициализация COM1: 115200 бод, 8N1, FIFO
+ *
+ * Если порт не отвечает (петлевой тест не прошёл), вывод в него
+ * молча отбрасывается.
+ */
+void serial_init(void);
+
+/**
+ * @brief Проверка, что порт найден и инициализирован
+ * @return 1, если вывод в порт работает
+ */
+int serial_is_ready(void);
+
+/**
+ * @brief Вывод символа в порт ('\n' дополняется '\r')
+ */
+void serial_write_char(char c);
+
+/**
+ * @brief Вывод строки в порт
+ */
+void serial_write_string(const char *str);
+
+/**
+ * @brief Вывод беззнакового числа в десятичном виде
+ */
+void serial_write_dec(uint32_t value);
+
+#endif /* SERIAL_H */
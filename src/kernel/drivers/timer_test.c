@@ -6,7 +6,10 @@
  */
 
 #include "pit.h"
+#include "clock.h"
+#include "serial.h"
 #include "../video/video.h"
+#include "../cpu/cpu.h"
 
 /**
  * @brief Тест базовых функций таймера
@@ -144,4 +147,92 @@ void run_timer_tests(void) {
     test_timer_performance();
     
     print_string("\n✅ Timer Tests Completed!\n");
-} 
\ No newline at end of file
+}
+
+#define CLOCKBENCH_READS 100000      /* Вызовов clock_ns на замер */
+
+static const uint32_t clockbench_udelays[] = { 1, 10, 100, 1000 };
+static const uint32_t clockbench_sleeps[] = { 500, 2500, 25000, 100000 };
+
+/**
+ * @brief Вывод одной строки результата на экран и в COM1
+ *
+ * Строка в COM1: "clockbench op=<op> us=<us> ns=<ns>".
+ */
+static void clockbench_report(const char *op, uint32_t us, uint32_t ns) {
+    print_string("  - ");
+    print_string(op);
+    print_string(" ");
+    print_dec(us);
+    print_string(" us: ");
+    print_dec(ns);
+    print_string(" ns\n");
+
+    serial_write_string("clockbench op=");
+    serial_write_string(op);
+    serial_write_string(" us=");
+    serial_write_dec(us);
+    serial_write_string(" ns=");
+    serial_write_dec(ns);
+    serial_write_string("\n");
+}
+
+/**
+ * @brief Бенчмарк источника времени
+ *
+ * Цена вызова clock_ns, наименьший видимый шаг и монотонность, затем
+ * точность udelay и pit_sleep_us (длительность по clock_ns).
+ */
+void clock_benchmark(void) {
+    print_string("\nClocksource benchmark (");
+    print_string(clocksource.name);
+    print_string(", TSC ");
+    print_dec(clock_tsc_khz() / 1000);
+    print_string(" MHz):\n");
+    serial_write_string("clockbench begin source=");
+    serial_write_string(clocksource.name);
+    serial_write_string(" tsc_khz=");
+    serial_write_dec(clock_tsc_khz());
+    serial_write_string("\n");
+
+    uint32_t backwards = 0;
+    uint32_t step = 0xFFFFFFFF;
+    uint64_t prev = clock_ns();
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < CLOCKBENCH_READS; i++) {
+        uint64_t now = clock_ns();
+        if (now < prev) {
+            backwards++;
+        } else if (now > prev && now - prev < step) {
+            step = (uint32_t)(now - prev);
+        }
+        prev = now;
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - start) / CLOCKBENCH_READS;
+
+    print_string("  - clock_ns: ");
+    print_dec(cycles);
+    print_string(" cycles per call, step ");
+    print_dec(step);
+    print_string(" ns, backwards ");
+    print_dec(backwards);
+    print_string("\n");
+    serial_write_string("clockbench op=read cycles=");
+    serial_write_dec(cycles);
+    serial_write_string(" step_ns=");
+    serial_write_dec(step);
+    serial_write_string(" backwards=");
+    serial_write_dec(backwards);
+    serial_write_string("\n");
+
+    for (uint32_t i = 0; i < sizeof(clockbench_udelays) / sizeof(clockbench_udelays[0]); i++) {
+        uint64_t begin = clock_ns();
+        udelay(clockbench_udelays[i]);
+        clockbench_report("udelay", clockbench_udelays[i], (uint32_t)(clock_ns() - begin));
+    }
+    for (uint32_t i = 0; i < sizeof(clockbench_sleeps) / sizeof(clockbench_sleeps[0]); i++) {
+        uint64_t begin = clock_ns();
+        pit_sleep_us(clockbench_sleeps[i]);
+        clockbench_report("sleep", clockbench_sleeps[i], (uint32_t)(clock_ns() - begin));
+    }
+}
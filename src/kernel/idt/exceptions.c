@@ -5,6 +5,9 @@
 
 #include "exceptions.h"
 #include "../video/video.h"
+#include "../cpu/fpu.h"
+#include "../cpu/cpu.h"
+#include "../memory/memory.h"
 
 // Сообщения для каждого типа исключений
 const char *exception_messages[] = {
@@ -45,11 +48,21 @@ const char *exception_messages[] = {
 /**
  * @brief Основной обработчик исключений, вызываемый из ассемблерных заглушек.
  * 
- * Выводит на экран информацию об исключении и останавливает систему.
+ * #NM обслуживается ленивым переключением FPU, #PF в областях VM_DEMAND -
+ * выделением страницы; оба возвращают управление. Остальные исключения
+ * выводят информацию на экран и останавливают систему.
  * @param regs Сохраненные регистры.
  */
 void exception_handler(registers_t *regs)
 {
+    if (regs->int_no == EXCEPTION_NO_COPROCESSOR) {
+        fpu_device_not_available();
+        return;
+    }
+    if (regs->int_no == EXCEPTION_PAGE_FAULT && vmm_handle_fault(read_cr2(), regs->err_code) == 0) {
+        return;
+    }
+
     // Установка красного цвета для сообщения об ошибке
     set_color(COLOR_RED, COLOR_BLACK);
     
@@ -64,6 +77,16 @@ void exception_handler(registers_t *regs)
     print_string(" (");
     print_dec(regs->int_no);
     print_string(")\n");
+
+    if (regs->int_no == EXCEPTION_PAGE_FAULT) {
+        print_string("Address (CR2): ");
+        print_hex(read_cr2());
+        print_string(", EIP: ");
+        print_hex(regs->eip);
+        print_string((regs->err_code & PF_ERR_PRESENT) ? ", protection" : ", not present");
+        print_string((regs->err_code & PF_ERR_WRITE) ? ", write" : ", read");
+        print_string((regs->err_code & PF_ERR_USER) ? ", user\n" : ", kernel\n");
+    }
     print_string("System Halted!\n");
 
     // Остановка системы
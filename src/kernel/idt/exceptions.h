@@ -8,6 +8,16 @@
 
 #include <stdint.h>
 
+/* Номер исключения #NM (Device Not Available) */
+#define EXCEPTION_NO_COPROCESSOR 7
+/* Номер исключения #PF (Page Fault) */
+#define EXCEPTION_PAGE_FAULT 14
+
+/* Биты кода ошибки #PF */
+#define PF_ERR_PRESENT 0x1   /* Нарушение прав (иначе страница отсутствует) */
+#define PF_ERR_WRITE 0x2     /* Запись (иначе чтение) */
+#define PF_ERR_USER 0x4      /* Обращение из режима пользователя */
+
 /**
  * @struct registers_t
  * @brief Структура для сохранения состояния регистров при прерывании.
@@ -7,8 +7,14 @@
 #include "idt/idt.h"
 #include "drivers/keyboard.h"
 #include "drivers/pit.h"
+#include "drivers/clock.h"
+#include "drivers/serial.h"
+#include "drivers/acpi.h"
 #include "memory/memory.h"
+#include "cpu/fpu.h"
+#include "lib/string.h"
 #include "syscall/syscall.h"
+#include "multiboot.h"
 #include "console.h"
 #include "shell.h"
 #include <stdarg.h>
@@ -20,22 +26,79 @@
  extern uint32_t _kernel_start;
  extern uint32_t _kernel_end;
  
+ /**
+  * @brief Проверка наличия параметра в командной строке ядра
+  * @param mbi Информационная структура Multiboot (может быть NULL)
+  * @param option Имя параметра (слово, отделённое пробелами)
+  * @return true, если параметр передан загрузчиком
+  */
+ static bool cmdline_has_option(const multiboot_info_t *mbi, const char *option)
+ {
+    if (!mbi || !(mbi->flags & MULTIBOOT_INFO_CMDLINE) || !mbi->cmdline) {
+        return false;
+    }
+
+    const char *word = (const char*)mbi->cmdline;
+    size_t length = strlen(option);
+    while (*word) {
+        if (strncmp(word, option, length) == 0 && (word[length] == ' ' || word[length] == '\0')) {
+            return true;
+        }
+
+        /* Переходим к следующему слову */
+        word = strchr(word, ' ');
+        if (!word) {
+            break;
+        }
+        while (*word == ' ') {
+            word++;
+        }
+    }
+    return false;
+ }
+ 
  /**
   * @brief Точка входа в ядро операционной системы
+  * @param magic Магическое число загрузчика (MULTIBOOT_BOOTLOADER_MAGIC)
+  * @param mbi Информационная структура Multiboot
   */
- void kmain(void) 
+ void kmain(uint32_t magic, multiboot_info_t *mbi) 
  {
+    fpu_init();         // Включение x87/SSE, ленивое сохранение через #NM
+    memory_primitives_init(); // Выбор варианта memory_set/memory_copy по CPUID
     idt_init();         // Настройка таблицы прерываний
     keyboard_init();    // Инициализация драйвера клавиатуры
     pit_init();         // Инициализация системного таймера
+    serial_init();      // COM1 для машиночитаемых отчётов
     
-    /* Инициализация менеджера памяти */
-    pmm_init((uint32_t)&_kernel_end);
+    /* Без Multiboot-загрузчика структуре информации доверять нельзя */
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        mbi = NULL;
+    }
+
+    /* Таблицы ACPI (SRAT/SLIT для NUMA) читаются до включения paging */
+    acpi_init();
+
+    /* Инициализация менеджера памяти по карте памяти загрузчика */
+    pmm_init((uint32_t)&_kernel_end, mbi);
+
+    /* Каталог страниц ядра: память 1:1 страницами 4MB, включение paging */
+    vmm_init();
+
+    /* Источник времени: TSC и таймер LAPIC калибруются по каналу 2 PIT */
+    clock_init();
      
-    /* Инициализация кучи ядра (начинаем после ядра) */
-    uint32_t heap_start = align_up((uint32_t)&_kernel_end + 1024 * 1024, PAGE_SIZE); /* 1MB после ядра */
-    uint32_t heap_size = 1024 * 1024; /* 1MB для кучи */
-    heap_init(heap_start, heap_size);
+    /* Инициализация кучи ядра: начальный пул 1MB, дальше растёт за счёт PMM */
+    heap_init(1024 * 1024);
+    slab_init();
+
+    /* Сжатый своп: холодные анонимные страницы уходят в zram */
+    zram_init();
+
+    /* heap_scrub: обнулять память при kfree (усиленный режим) */
+    if (cmdline_has_option(mbi, "heap_scrub")) {
+        heap_set_scrub(1);
+    }
     
     /* Инициализация подсистемы системных вызовов */
     syscall_init();
@@ -52,12 +115,22 @@
     // Информация о копирайте
     print_string(kernel_msg);
  
-    /* Запуск тестов менеджера памяти */
-    //run_memory_tests();
+    /* Стресс-тесты и бенчмарки памяти: команда membench */
  
     /* Запуск тестов системного таймера */
     //run_timer_tests();
  
+    /**
+     * @brief Арена команд терминала
+     *
+     * Ввод и временные данные команды выделяются сдвигом указателя
+     * и освобождаются разом после её выполнения.
+     */
+    arena_t *shell_arena = arena_create(0);
+    if (!shell_arena) {
+        kernel_panic("Failed to create shell arena");
+    }
+
     /**
      * @brief Основной цикл ядра с временным псевдо-терминалом
      * 
@@ -77,22 +150,24 @@
          * - Буферизация будет осуществляться в пространстве пользователя
          * - Доступ к терминалу будет через стандартные дескрипторы (stdin/stdout)
          */
-        char* user_input = console_readline(128);
+        char* user_input = console_readline(shell_arena, 128);
  
         if (user_input) {
             /* Обработка команды в shell */
             shell_execute(user_input);
  
-           /* Освобождаем память, выделенную для ввода */
-            kfree(user_input);
-        } else {
-            /* Если не удалось выделить память, ждем немного */
+            /* Освобождаем всё, что команда выделила в арене */
+            arena_reset(shell_arena);
+        } else if (!shrink_memory(PMM_RECLAIM_BATCH)) {
+            /* Освобождать нечего - ждём, пока память вернут */
             pit_sleep_ms(100);
         }
          
-       /* Используем hlt для экономии энергии, когда ядру нечего делать */
+        /* Спим без тиков таймера, когда ядру нечего делать */
         /* В будущем здесь будет планировщик задач */
-        __asm__ volatile("hlt");
+        if (!pmm_idle_work()) {
+            pit_idle(0);
+        }
     }
      
     /* Ядро никогда не должно достигать этой точки */
@@ -0,0 +1,201 @@
+/**
+ * @file lz4.c
+ * @brief Сжатие в блочном формате LZ4
+ *
+ * Последовательность: токен (длина литералов << 4 | длина совпадения - 4),
+ * продолжения длин байтами по 255, литералы, смещение совпадения (2 байта).
+ * Последняя последовательность содержит только литералы; совпадение не
+ * начинается ближе LZ4_MFLIMIT байт к концу и не заходит в последние
+ * LZ4_LAST_LITERALS байт.
+ */
+
+#include "lz4.h"
+#include "../memory/memory.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_MFLIMIT 12
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_LOG 12
+
+/* Невыровненное 32-битное чтение */
+typedef struct {
+    uint32_t value;
+} __attribute__((packed)) lz4_unaligned_t;
+
+/* Позиции последних вхождений четвёрок байт */
+static uint16_t lz4_table[1u << LZ4_HASH_LOG];
+
+static uint32_t lz4_read32(const uint8_t *ptr) {
+    return ((const lz4_unaligned_t*)ptr)->value;
+}
+
+static uint32_t lz4_hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+/**
+ * @brief Запись длины сверх 15 байтами продолжения
+ * @return Новая позиция вывода
+ */
+static uint8_t* lz4_write_length(uint8_t *op, uint32_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+/**
+ * @brief Запись последовательности: литералы и совпадение
+ * @param match Длина совпадения (0 - последняя последовательность)
+ * @return Новая позиция вывода или NULL, если не хватает места
+ */
+static uint8_t* lz4_emit(uint8_t *op, uint8_t *end, const uint8_t *literals, uint32_t count,
+                         uint32_t offset, uint32_t match) {
+    uint32_t worst = 1 + count / 255 + 1 + count + (match ? 2 + match / 255 + 1 : 0);
+    if ((uint32_t)(end - op) < worst) {
+        return NULL;
+    }
+
+    uint8_t *token = op++;
+    *token = (count >= 15 ? 15 : count) << 4;
+    if (count >= 15) {
+        op = lz4_write_length(op, count - 15);
+    }
+    memory_copy(op, literals, count);
+    op += count;
+
+    if (match) {
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        match -= LZ4_MIN_MATCH;
+        *token |= match >= 15 ? 15 : match;
+        if (match >= 15) {
+            op = lz4_write_length(op, match - 15);
+        }
+    }
+    return op;
+}
+
+/**
+ * @brief Сжатие блока
+ * @param src Входные данные
+ * @param size Размер (не больше LZ4_MAX_INPUT)
+ * @param dst Выходной буфер
+ * @param capacity Размер выходного буфера
+ * @return Размер сжатых данных или 0, если они не поместились
+ */
+size_t lz4_compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) {
+    if (size > LZ4_MAX_INPUT) {
+        return 0;
+    }
+
+    uint8_t *op = dst;
+    uint8_t *end = dst + capacity;
+    uint32_t anchor = 0;
+
+    if (size > LZ4_MFLIMIT) {
+        uint32_t limit = size - LZ4_MFLIMIT;
+        uint32_t match_limit = size - LZ4_LAST_LITERALS;
+        memory_set(lz4_table, 0, sizeof(lz4_table));
+
+        uint32_t ip = 1;
+        while (ip < limit) {
+            uint32_t sequence = lz4_read32(src + ip);
+            uint32_t hash = lz4_hash(sequence);
+            uint32_t ref = lz4_table[hash];
+            lz4_table[hash] = (uint16_t)ip;
+
+            if (ip - ref > LZ4_MAX_OFFSET || lz4_read32(src + ref) != sequence) {
+                ip++;
+                continue;
+            }
+
+            uint32_t length = LZ4_MIN_MATCH;
+            while (ip + length < match_limit && src[ref + length] == src[ip + length]) {
+                length++;
+            }
+
+            op = lz4_emit(op, end, src + anchor, ip - anchor, ip - ref, length);
+            if (!op) {
+                return 0;
+            }
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    op = lz4_emit(op, end, src + anchor, size - anchor, 0, 0);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+/**
+ * @brief Распаковка блока с проверкой границ
+ * @param src Сжатые данные
+ * @param size Их размер
+ * @param dst Выходной буфер
+ * @param capacity Размер выходного буфера
+ * @return Размер распакованных данных или -1 для повреждённого входа
+ */
+int lz4_decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < size) {
+        uint8_t token = src[ip++];
+
+        size_t count = token >> 4;
+        if (count == 15) {
+            uint8_t byte;
+            do {
+                if (ip >= size) {
+                    return -1;
+                }
+                byte = src[ip++];
+                count += byte;
+            } while (byte == 255);
+        }
+        if (count > size - ip || count > capacity - op) {
+            return -1;
+        }
+        memory_copy(dst + op, src + ip, count);
+        ip += count;
+        op += count;
+
+        if (ip == size) {
+            break; /* Последняя последовательность - только литералы */
+        }
+        if (size - ip < 2) {
+            return -1;
+        }
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return -1;
+        }
+
+        size_t length = token & 15;
+        if (length == 15) {
+            uint8_t byte;
+            do {
+                if (ip >= size) {
+                    return -1;
+                }
+                byte = src[ip++];
+                length += byte;
+            } while (byte == 255);
+        }
+        length += LZ4_MIN_MATCH;
+        if (length > capacity - op) {
+            return -1;
+        }
+
+        /* Совпадение может перекрывать собственный вывод - побайтово */
+        for (size_t i = 0; i < length; i++, op++) {
+            dst[op] = dst[op - offset];
+        }
+    }
+    return (int)op;
+}
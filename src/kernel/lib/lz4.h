@@ -0,0 +1,25 @@
+/**
+ * @file lz4.h
+ * @brief Сжатие в блочном формате LZ4
+ *
+ * Жадный однопроходный компрессор с хеш-таблицей последних позиций
+ * и распаковщик с проверкой границ. Рассчитан на блоки до 64KB
+ * (страницы zram), формат совместим с LZ4 block format.
+ */
+
+#ifndef KERNEL_LZ4_H
+#define KERNEL_LZ4_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Наибольший входной блок */
+#define LZ4_MAX_INPUT 65535
+
+/* Размер выхода в худшем случае (несжимаемые данные) */
+#define LZ4_BOUND(size) ((size) + (size) / 255 + 16)
+
+size_t lz4_compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+int lz4_decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+
+#endif /* KERNEL_LZ4_H */
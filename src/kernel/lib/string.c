@@ -0,0 +1,268 @@
+/**
+ * @file string.c
+ * @brief Строковые функции ядра
+ *
+ * Выровненное чтение слова или 16-байтового блока никогда не пересекает
+ * границу страницы, поэтому функции могут читать байты за концом строки
+ * внутри того же выровненного блока, не рискуя ошибкой страницы.
+ * Нулевой или искомый байт в слове находится через MEMORY_HAS_ZERO.
+ */
+
+#include "string.h"
+#include "../memory/memory.h"
+#include "../cpu/fpu.h"
+
+/**
+ * @brief Поиск байта в 16-байтовых блоках (SSE2)
+ *
+ * Блок сравнивается целиком (pcmpeqb), маска совпадений снимается
+ * pmovmskb. Вызывать внутри kernel_fpu_begin/end.
+ * @param p Начало, выровненное на 16 байт
+ * @param value Искомый байт
+ * @param blocks Число блоков (больше 0)
+ * @return Первое совпадение или NULL
+ */
+__attribute__((target("sse2")))
+static const uint8_t* string_find_sse2(const uint8_t *p, uint8_t value, size_t blocks) {
+    uint32_t mask;
+
+    __asm__ volatile("movd %3, %%xmm0\n\t"
+                     "pshufd $0, %%xmm0, %%xmm0\n\t"
+                     "1:\n\t"
+                     "movdqa (%0), %%xmm1\n\t"
+                     "pcmpeqb %%xmm0, %%xmm1\n\t"
+                     "pmovmskb %%xmm1, %2\n\t"
+                     "test %2, %2\n\t"
+                     "jnz 2f\n\t"
+                     "add $16, %0\n\t"
+                     "dec %1\n\t"
+                     "jnz 1b\n\t"
+                     "2:"
+                     : "+r"(p), "+r"(blocks), "=&r"(mask)
+                     : "r"(MEMORY_SPLAT(value))
+                     : "xmm0", "xmm1", "memory", "cc");
+
+    return mask ? p + __builtin_ctz(mask) : NULL;
+}
+
+/**
+ * @brief Длинный просмотр через SSE2, если он разрешён
+ * @param p Начало, выровненное на 4 байта
+ * @param value Искомый байт
+ * @param count Сколько байт просматривать ((size_t)-1 - без ограничения)
+ * @param hit Результат: совпадение или NULL
+ * @return 1 если просмотр выполнен, 0 если SSE2 недоступен
+ */
+static int string_find_long(const uint8_t *p, uint8_t value, size_t count, const uint8_t **hit) {
+    if (!(memory_get_features() & MEMORY_FEATURE_SSE2)) {
+        return 0;
+    }
+
+    /* Доходим словами до границы 16 байт */
+    while (((uint32_t)p & 15) && count >= 4) {
+        if (MEMORY_HAS_ZERO(*(const memory_word_t*)p ^ MEMORY_SPLAT(value))) {
+            *hit = memory_find(p, value, 4);
+            return 1;
+        }
+        p += 4;
+        count -= 4;
+    }
+    if (count < 16) {
+        *hit = memory_find(p, value, count);
+        return 1;
+    }
+
+    size_t blocks = (count >> 4) + ((count & 15) != 0);
+    kernel_fpu_begin();
+    const uint8_t *found = string_find_sse2(p, value, blocks);
+    kernel_fpu_end();
+
+    /* Последний блок мог выйти за count */
+    *hit = (found && (size_t)(found - p) < count) ? found : NULL;
+    return 1;
+}
+
+/**
+ * @brief Длина строки
+ * @param str Строка, завершённая нулём
+ * @return Число байт до нуля
+ */
+size_t strlen(const char *str) {
+    const uint8_t *p = (const uint8_t*)str;
+
+    while ((uint32_t)p & 3) {
+        if (!*p) {
+            return (const char*)p - str;
+        }
+        p++;
+    }
+
+    for (size_t scanned = 0; ; scanned += 4, p += 4) {
+        if (MEMORY_HAS_ZERO(*(const memory_word_t*)p)) {
+            while (*p) {
+                p++;
+            }
+            return (const char*)p - str;
+        }
+
+        /* Строка длинная: дальше блоками по 16 байт */
+        const uint8_t *hit;
+        if (scanned == STRING_SSE_MIN && string_find_long(p, 0, (size_t)-1, &hit)) {
+            return (const char*)hit - str;
+        }
+    }
+}
+
+/**
+ * @brief Длина строки, но не больше max
+ * @param str Строка
+ * @param max Наибольшее число просматриваемых байт
+ * @return min(strlen(str), max)
+ */
+size_t strnlen(const char *str, size_t max) {
+    const char *end = memchr(str, 0, max);
+    return end ? (size_t)(end - str) : max;
+}
+
+/**
+ * @brief Сравнение строк
+ *
+ * Если строки одинаково выровнены, сравниваются словами до первого
+ * различия или нулевого байта; остаток - побайтно.
+ * @return 0 если строки равны, иначе разность первых различных байт
+ */
+int strcmp(const char *a, const char *b) {
+    const uint8_t *p1 = (const uint8_t*)a;
+    const uint8_t *p2 = (const uint8_t*)b;
+
+    if ((((uint32_t)p1 ^ (uint32_t)p2) & 3) == 0) {
+        while ((uint32_t)p1 & 3) {
+            if (*p1 != *p2 || !*p1) {
+                return (int)*p1 - (int)*p2;
+            }
+            p1++;
+            p2++;
+        }
+        for (;;) {
+            uint32_t w1 = *(const memory_word_t*)p1;
+            if (w1 != *(const memory_word_t*)p2 || MEMORY_HAS_ZERO(w1)) {
+                break;
+            }
+            p1 += 4;
+            p2 += 4;
+        }
+    }
+
+    while (*p1 && *p1 == *p2) {
+        p1++;
+        p2++;
+    }
+    return (int)*p1 - (int)*p2;
+}
+
+/**
+ * @brief Сравнение не более count байт строк
+ * @return 0 если первые count байт (или строки целиком) равны
+ */
+int strncmp(const char *a, const char *b, size_t count) {
+    const uint8_t *p1 = (const uint8_t*)a;
+    const uint8_t *p2 = (const uint8_t*)b;
+
+    if ((((uint32_t)p1 ^ (uint32_t)p2) & 3) == 0) {
+        while (count && ((uint32_t)p1 & 3)) {
+            if (*p1 != *p2 || !*p1) {
+                return (int)*p1 - (int)*p2;
+            }
+            p1++;
+            p2++;
+            count--;
+        }
+        while (count >= 4) {
+            uint32_t w1 = *(const memory_word_t*)p1;
+            if (w1 != *(const memory_word_t*)p2 || MEMORY_HAS_ZERO(w1)) {
+                break;
+            }
+            p1 += 4;
+            p2 += 4;
+            count -= 4;
+        }
+    }
+
+    for (; count; count--, p1++, p2++) {
+        if (*p1 != *p2 || !*p1) {
+            return (int)*p1 - (int)*p2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Поиск символа в строке
+ * @param str Строка
+ * @param c Искомый символ (0 - найти конец строки)
+ * @return Указатель на первое вхождение или NULL
+ */
+char* strchr(const char *str, int c) {
+    const uint8_t *p = (const uint8_t*)str;
+    uint8_t value = (uint8_t)c;
+    uint32_t pattern = MEMORY_SPLAT(value);
+
+    while ((uint32_t)p & 3) {
+        if (*p == value) {
+            return (char*)p;
+        }
+        if (!*p) {
+            return NULL;
+        }
+        p++;
+    }
+
+    for (;; p += 4) {
+        uint32_t word = *(const memory_word_t*)p;
+        if (MEMORY_HAS_ZERO(word) || MEMORY_HAS_ZERO(word ^ pattern)) {
+            break;
+        }
+    }
+
+    for (;; p++) {
+        if (*p == value) {
+            return (char*)p;
+        }
+        if (!*p) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * @brief Поиск байта в области памяти
+ *
+ * Короткие области - memory_find (словами), длинные - SSE2.
+ * @param ptr Начало области
+ * @param c Искомый байт
+ * @param count Размер области
+ * @return Указатель на первое вхождение или NULL
+ */
+void* memchr(const void *ptr, int c, size_t count) {
+    const uint8_t *p = (const uint8_t*)ptr;
+    uint8_t value = (uint8_t)c;
+
+    if (count < STRING_SSE_MIN) {
+        return memory_find(p, value, count);
+    }
+
+    /* Голова до границы слова - побайтно */
+    while ((uint32_t)p & 3) {
+        if (*p == value) {
+            return (void*)p;
+        }
+        p++;
+        count--;
+    }
+
+    const uint8_t *hit;
+    if (string_find_long(p, value, count, &hit)) {
+        return (void*)hit;
+    }
+    return memory_find(p, value, count);
+}
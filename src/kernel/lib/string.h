@@ -0,0 +1,28 @@
+/**
+ * @file string.h
+ * @brief Строковые функции ядра (без стандартной библиотеки)
+ *
+ * Общая реализация для оболочки, консоли, видеовывода и системных
+ * вызовов. Строки просматриваются словами по 4 байта; длинные участки
+ * strlen/strnlen/memchr - SSE2, если он разрешён (fpu_init).
+ */
+
+#ifndef KERNEL_STRING_H
+#define KERNEL_STRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Байт, который strlen/memchr проходят словами, прежде чем перейти на SSE2 */
+#define STRING_SSE_MIN 256
+
+size_t strlen(const char *str);
+size_t strnlen(const char *str, size_t max);
+int strcmp(const char *a, const char *b);
+int strncmp(const char *a, const char *b, size_t count);
+char* strchr(const char *str, int c);
+void* memchr(const void *ptr, int c, size_t count);
+
+void string_benchmark(void);
+
+#endif /* KERNEL_STRING_H */
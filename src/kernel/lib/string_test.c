@@ -0,0 +1,204 @@
+/**
+ * @file string_test.c
+ * @brief Бенчмарк строковых функций против прежних побайтовых циклов
+ */
+
+#include "string.h"
+#include "../memory/memory.h"
+#include "../video/video.h"
+#include "../cpu/cpu.h"
+#include "../drivers/serial.h"
+
+#define STRBENCH_MAX 4096            /* Наибольшая длина строки */
+#define STRBENCH_BYTES (256 * 1024)  /* Байт на один замер */
+#define STRGUARD_MAX (STRING_SSE_MIN * 4) /* Наибольшая длина строки у защитной страницы */
+
+static const uint32_t strbench_lengths[] = { 8, 32, 128, 1024, STRBENCH_MAX };
+
+static char strbench_a[STRBENCH_MAX + 16] __attribute__((aligned(16)));
+static char strbench_b[STRBENCH_MAX + 16] __attribute__((aligned(16)));
+static volatile uint32_t strbench_sink;
+
+/* Прежние циклы оболочки и sys_write - эталон для сравнения */
+static uint32_t bench_byte_strlen(const char *s) {
+    uint32_t n = 0;
+    while (s[n] != '\0') n++;
+    return n;
+}
+
+static int bench_byte_streq(const char *a, const char *b) {
+    uint32_t i = 0;
+    while (a[i] != '\0' && b[i] != '\0') {
+        if (a[i] != b[i]) return 0;
+        i++;
+    }
+    return a[i] == '\0' && b[i] == '\0';
+}
+
+static const char* bench_byte_strchr(const char *s, char c) {
+    for (; *s; s++) {
+        if (*s == c) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static const void* bench_byte_memchr(const uint8_t *p, uint8_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (p[i] == value) {
+            return p + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Тактов на один вызов операции над строкой длины len
+ * @param op 0 - strlen, 1 - strcmp, 2 - strchr, 3 - memchr
+ * @param reference Использовать побайтовую версию
+ */
+static uint32_t strbench_run(uint32_t op, int reference, uint32_t len) {
+    uint32_t reps = STRBENCH_BYTES / len;
+    uint32_t sink = 0;
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) {
+        switch (op) {
+        case 0:
+            sink += reference ? bench_byte_strlen(strbench_a) : strlen(strbench_a);
+            break;
+        case 1:
+            sink += reference ? (uint32_t)bench_byte_streq(strbench_a, strbench_b)
+                              : (uint32_t)(strcmp(strbench_a, strbench_b) == 0);
+            break;
+        case 2:
+            sink += reference ? (uint32_t)bench_byte_strchr(strbench_a, '#')
+                              : (uint32_t)strchr(strbench_a, '#');
+            break;
+        default:
+            sink += reference ? (uint32_t)bench_byte_memchr((const uint8_t*)strbench_a, '#', len)
+                              : (uint32_t)memchr(strbench_a, '#', len);
+            break;
+        }
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+    strbench_sink = sink;
+
+    return cycles / reps;
+}
+
+/**
+ * @brief Проверка, что строковые функции не читают за концом строки
+ *
+ * Строки всех длин до STRGUARD_MAX (а значит, и со всеми смещениями
+ * начала) заканчиваются последним байтом страницы, за которой следует
+ * неотображённая. Чтение за нулевым байтом вызовет #PF, а не пройдёт
+ * незамеченным.
+ * @return Число неверных результатов или -1, если нет памяти
+ */
+static int32_t string_guard_check(void) {
+    char *area = vm_reserve(2 * PAGE_SIZE, VM_WRITE);
+    uint32_t phys = pmm_alloc_page();
+    if (!area || !phys || map_page((uint32_t)area, phys, VMM_WRITE) != 0) {
+        if (phys) {
+            pmm_free_page(phys);
+        }
+        vm_release(area);
+        return -1;
+    }
+
+    int32_t errors = 0;
+    char *end = area + PAGE_SIZE - 1;
+    *end = '\0';
+    for (uint32_t len = 0; len <= STRGUARD_MAX; len++) {
+        char *str = end - len;
+        if (len) {
+            str[0] = (char)('a' + len % 26);
+        }
+        for (uint32_t i = 0; i <= len; i++) {
+            strbench_b[i] = str[i];
+        }
+
+        errors += strlen(str) != len;
+        errors += strnlen(str, PAGE_SIZE) != len;
+        errors += strcmp(str, strbench_b) != 0;
+        errors += strncmp(str, strbench_b, PAGE_SIZE) != 0;
+        errors += strchr(str, '#') != NULL;
+        errors += strchr(str, '\0') != end;
+        errors += memchr(str, '#', len + 1) != NULL;
+    }
+
+    vm_release(area);
+    pmm_free_page(phys);
+    return errors;
+}
+
+/**
+ * @brief Сравнение строковых функций с побайтовыми циклами (команда strbench)
+ *
+ * Для каждой длины выводит такты на вызов новой версии и в скобках -
+ * побайтовой. Строки равны, искомого символа в них нет, поэтому каждая
+ * операция проходит строку целиком. Перед замерами проверяется, что
+ * функции не читают за концом строки (string_guard_check).
+ */
+void string_benchmark(void) {
+    static const char *names[] = { "strlen", "strcmp", "strchr", "memchr" };
+
+    print_string("\nString benchmark (cycles per call, byte loop in parentheses):\n");
+    print_string("  - SSE2: ");
+    print_string(memory_get_features() & MEMORY_FEATURE_SSE2 ? "yes\n" : "no\n");
+    serial_write_string("strbench begin\n");
+
+    int32_t guard = string_guard_check();
+    print_string("  - Guard page: ");
+    if (guard < 0) {
+        print_string("skipped (out of memory)\n");
+    } else if (guard == 0) {
+        print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color("FAILED", COLOR_RED, COLOR_BLACK);
+        print_string(" (");
+        print_dec(guard);
+        print_string(" wrong results)\n");
+    }
+    serial_write_string("strbench guard_errors=");
+    serial_write_dec(guard < 0 ? 0 : (uint32_t)guard);
+    serial_write_string("\n");
+
+    for (uint32_t k = 0; k < sizeof(strbench_lengths) / sizeof(strbench_lengths[0]); k++) {
+        uint32_t len = strbench_lengths[k];
+
+        for (uint32_t i = 0; i < len; i++) {
+            strbench_a[i] = strbench_b[i] = (char)('a' + i % 26);
+        }
+        strbench_a[len] = strbench_b[len] = '\0';
+
+        print_string("  ");
+        print_dec(len);
+        print_string("B:");
+        for (uint32_t op = 0; op < 4; op++) {
+            uint32_t fast = strbench_run(op, 0, len);
+            uint32_t slow = strbench_run(op, 1, len);
+
+            print_string(" ");
+            print_string(names[op]);
+            print_string(" ");
+            print_dec(fast);
+            print_string(" (");
+            print_dec(slow);
+            print_string(")");
+
+            serial_write_string("strbench op=");
+            serial_write_string(names[op]);
+            serial_write_string(" len=");
+            serial_write_dec(len);
+            serial_write_string(" cycles=");
+            serial_write_dec(fast);
+            serial_write_string(" byte_cycles=");
+            serial_write_dec(slow);
+            serial_write_string("\n");
+        }
+        print_string("\n");
+    }
+}
@@ -0,0 +1,181 @@
+/**
+ * @file arena.c
+ * @brief Арена (bump-аллокатор) для короткоживущих выделений
+ *
+ * Арена выделяет память простым сдвигом указателя внутри чанка - блока
+ * страниц PMM - и не умеет освобождать отдельные объекты: всё выделенное
+ * освобождается разом через arena_reset, arena_restore или arena_destroy.
+ * Когда чанк кончается, у PMM берётся новый; первый чанк живёт всё время
+ * жизни арены и хранит её дескриптор.
+ */
+
+#include "memory.h"
+
+/* Начало полезной части первого чанка: заголовок чанка и дескриптор арены */
+#define ARENA_FIRST_OFFSET (sizeof(arena_chunk_t) + ((sizeof(arena_t) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1)))
+
+/**
+ * @brief Первый чанк арены (в нём лежит дескриптор)
+ */
+static arena_chunk_t* arena_first_chunk(const arena_t *arena) {
+    return (arena_chunk_t*)arena - 1;
+}
+
+/**
+ * @brief Взятие у PMM чанка порядка order
+ * @return Чанк или NULL при нехватке памяти
+ */
+static arena_chunk_t* arena_chunk_alloc(uint32_t order) {
+    uint32_t addr = pmm_alloc_pages(order);
+    if (!addr) {
+        return NULL;
+    }
+
+    arena_chunk_t *chunk = (arena_chunk_t*)addr;
+    chunk->prev = NULL;
+    chunk->order = order;
+    chunk->end = addr + (PAGE_SIZE << order);
+    chunk->reserved = 0;
+    return chunk;
+}
+
+/**
+ * @brief Переход на новый чанк, вмещающий size байт
+ *
+ * Остаток текущего чанка не используется до сброса арены.
+ * @return 1 при успехе, 0 при нехватке памяти
+ */
+static int arena_grow(arena_t *arena, uint32_t size) {
+    uint32_t order = arena->base_order;
+    while ((PAGE_SIZE << order) - sizeof(arena_chunk_t) < size) {
+        if (++order > PMM_MAX_ORDER) {
+            return 0;
+        }
+    }
+
+    arena_chunk_t *chunk = arena_chunk_alloc(order);
+    if (!chunk) {
+        return 0;
+    }
+
+    chunk->prev = arena->chunk;
+    arena->chunk = chunk;
+    arena->cur = (uint32_t)(chunk + 1);
+    arena->end = chunk->end;
+    return 1;
+}
+
+/**
+ * @brief Создание арены
+ * @param order Порядок чанков арены (2^order страниц)
+ * @return Арена или NULL при ошибке
+ */
+arena_t* arena_create(uint32_t order) {
+    if (order > PMM_MAX_ORDER) {
+        return NULL;
+    }
+
+    arena_chunk_t *chunk = arena_chunk_alloc(order);
+    if (!chunk) {
+        return NULL;
+    }
+
+    arena_t *arena = (arena_t*)(chunk + 1);
+    arena->chunk = chunk;
+    arena->cur = (uint32_t)chunk + ARENA_FIRST_OFFSET;
+    arena->end = chunk->end;
+    arena->base_order = order;
+    arena->used = 0;
+    arena->peak = 0;
+    return arena;
+}
+
+/**
+ * @brief Выделение памяти из арены
+ *
+ * Сдвиг указателя на size байт, выровненных на ARENA_ALIGN; новый чанк
+ * берётся у PMM, только если текущий кончился.
+ * @param arena Арена
+ * @param size Размер в байтах
+ * @return Указатель или NULL; по отдельности не освобождается
+ */
+void* arena_alloc(arena_t *arena, size_t size) {
+    if (size == 0 || size > (PAGE_SIZE << PMM_MAX_ORDER)) {
+        return NULL;
+    }
+
+    size = align_up(size, ARENA_ALIGN);
+    if (size > arena->end - arena->cur && !arena_grow(arena, size)) {
+        return NULL;
+    }
+
+    void *ptr = (void*)arena->cur;
+    arena->cur += size;
+    arena->used += size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return ptr;
+}
+
+/**
+ * @brief Контрольная точка арены
+ *
+ * Всё, что выделено после неё, освобождается arena_restore.
+ * Точки можно вкладывать, восстанавливая их в обратном порядке.
+ */
+arena_mark_t arena_save(const arena_t *arena) {
+    arena_mark_t mark;
+    mark.chunk = arena->chunk;
+    mark.cur = arena->cur;
+    mark.used = arena->used;
+    return mark;
+}
+
+/**
+ * @brief Откат арены к контрольной точке
+ *
+ * Чанки, взятые после точки, возвращаются PMM.
+ */
+void arena_restore(arena_t *arena, arena_mark_t mark) {
+    while (arena->chunk != mark.chunk) {
+        arena_chunk_t *chunk = arena->chunk;
+        if (!chunk->prev) {
+            return; /* Точка не принадлежит этой арене */
+        }
+        arena->chunk = chunk->prev;
+        pmm_free_pages((uint32_t)chunk, chunk->order);
+    }
+
+    arena->cur = mark.cur;
+    arena->end = mark.chunk->end;
+    arena->used = mark.used;
+}
+
+/**
+ * @brief Освобождение всего, что выделено из арены
+ *
+ * Остаётся только первый чанк с дескриптором.
+ */
+void arena_reset(arena_t *arena) {
+    arena_chunk_t *first = arena_first_chunk(arena);
+    arena_mark_t mark;
+
+    mark.chunk = first;
+    mark.cur = (uint32_t)first + ARENA_FIRST_OFFSET;
+    mark.used = 0;
+    arena_restore(arena, mark);
+}
+
+/**
+ * @brief Уничтожение арены и возврат всех чанков PMM
+ */
+void arena_destroy(arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+
+    arena_reset(arena);
+    arena_chunk_t *first = arena_first_chunk(arena);
+    pmm_free_pages((uint32_t)first, first->order);
+}
@@ -1,9 +1,31 @@
 /**
  * @file heap.c
  * @brief Kernel Heap Allocator - динамическое выделение памяти для ядра
- * 
+ *
  * Реализация кучи ядра с поддержкой функций kmalloc(), kfree() и krealloc()
- * Использует связанный список блоков для управления памятью
+ * Мелкие запросы обслуживаются slab-аллокатором, крупные - TLSF
+ * (two-level segregated fit): свободные блоки лежат в сегрегированных
+ * списках, непустые списки отмечены в двухуровневой битовой карте, а
+ * граничные теги позволяют объединять соседей за O(1). Поэтому время
+ * выделения и освобождения ограничено и не зависит от числа живых блоков.
+ *
+ * Куча ядра состоит из пулов - блоков PMM. Когда подходящего свободного
+ * блока нет, куча берёт у PMM новый пул, а полностью освободившийся пул
+ * возвращается PMM (кроме начального).
+ *
+ * kfree не обнуляет память: нулевую память дают kzalloc/kcalloc, а
+ * обнуление при освобождении включается опцией heap_scrub (сборка с
+ * -DHEAP_SCRUB или параметр ядра heap_scrub). Свободные блоки, про которые
+ * известно, что они обнулены, несут флаг HEAP_BLOCK_ZERO и не обнуляются
+ * повторно.
+ *
+ * Запросы от HEAP_DIRECT_THRESHOLD байт и kmalloc_pages обслуживаются
+ * напрямую PMM; такие выделения учитываются в хеш-таблице по адресу.
+ *
+ * Каждое выделение kmalloc помечено местом вызова (heap_prof): метка
+ * занятого блока TLSF лежит в поле prev_size следующего блока, которое
+ * нужно только пока блок свободен; у объекта слаба - в байте метки слаба,
+ * у страничного выделения - в его записи.
  */
 
 #include "memory.h"
@@ -13,138 +35,1113 @@
 heap_t kernel_heap;
 
 /* Минимальный размер блока (включая заголовок) */
-#define MIN_BLOCK_SIZE (sizeof(heap_block_t) + 8)
+#define MIN_BLOCK_SIZE (HEAP_BLOCK_HEADER + HEAP_MIN_PAYLOAD)
+
+/* Служебные данные пула: заголовок, первый и замыкающий заголовки блоков */
+#define POOL_OVERHEAD (sizeof(heap_pool_t) + 2 * HEAP_BLOCK_HEADER)
+
+/* Гранулы физической памяти, занятые пулами кучи ядра */
+static uint32_t heap_granules[(MAX_PAGES >> HEAP_POOL_MIN_ORDER) / 32];
+
+/* Страничные выделения: хеш-таблица записей по адресу */
+static heap_page_alloc_t *page_allocs[HEAP_PAGE_BUCKETS];
+static kmem_cache_t *page_alloc_cache;
+static uint32_t page_alloc_count;
+static uint32_t page_alloc_pages;
 
 /**
- * @brief Инициализация кучи ядра
- * @param start_addr Начальный адрес кучи
- * @param size Размер кучи в байтах
+ * @brief Класс размера выделения
+ * @param size Запрошенный размер
+ * @return HEAP_SMALL, HEAP_MEDIUM или HEAP_LARGE
  */
-void heap_init(uint32_t start_addr, uint32_t size) {
-    print_string("Heap Initialization... ");
-    
-    /* Выравниваем адрес и размер */
-    start_addr = align_up(start_addr, 8);
-    size = align_down(size, 8);
-    
-    /* Инициализация структуры кучи */
-    kernel_heap.start_addr = start_addr;
-    kernel_heap.end_addr = start_addr + size;
-    kernel_heap.total_size = size;
-    kernel_heap.used_size = 0;
-    
-    /* Создаем первый свободный блок */
-    heap_block_t *first_block = (heap_block_t*)start_addr;
-    first_block->size = size - sizeof(heap_block_t);
-    first_block->used = 0;
-    first_block->next = NULL;
-    first_block->prev = NULL;
-    
-    kernel_heap.first_block = first_block;
-    
-    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
-    print_string("  - Start: 0x");
-    print_hex(start_addr);
-    print_string("\n  - Size: ");
-    print_hex(size);
-    print_string(" bytes\n");
+static heap_type_t heap_size_class(size_t size) {
+    if (size <= 64) {
+        return HEAP_SMALL;
+    }
+    if (size <= SLAB_MAX_SIZE) {
+        return HEAP_MEDIUM;
+    }
+    return HEAP_LARGE;
+}
+
+/**
+ * @brief Проверка, что указатель лежит в одном из пулов кучи
+ *
+ * Пулы растущей кучи - выровненные блоки PMM, поэтому принадлежность
+ * проверяется по одному биту карты гранул.
+ */
+static int heap_owns(const heap_t *heap, const void *ptr) {
+    uint32_t addr = (uint32_t)ptr;
+
+    if (addr < heap->start_addr + HEAP_BLOCK_HEADER || addr >= heap->end_addr) {
+        return 0;
+    }
+    if (!heap->growable) {
+        return 1;
+    }
+
+    uint32_t granule = addr >> HEAP_GRANULE_SHIFT;
+    return (heap_granules[granule / 32] >> (granule % 32)) & 1;
+}
+
+/**
+ * @brief Отметка гранул пула в карте владения
+ */
+static void heap_granules_set(uint32_t start, uint32_t size, int owned) {
+    uint32_t first = start >> HEAP_GRANULE_SHIFT;
+    uint32_t count = size >> HEAP_GRANULE_SHIFT;
+
+    for (uint32_t granule = first; granule < first + count; granule++) {
+        if (owned) {
+            heap_granules[granule / 32] |= 1u << (granule % 32);
+        } else {
+            heap_granules[granule / 32] &= ~(1u << (granule % 32));
+        }
+    }
+}
+
+/* Доступ к полям блока */
+
+static uint32_t block_size(const heap_block_t *block) {
+    return block->size & ~HEAP_BLOCK_FLAGS;
+}
+
+static int block_is_free(const heap_block_t *block) {
+    return block->size & HEAP_BLOCK_FREE;
+}
+
+static heap_block_t* block_from_ptr(const void *ptr) {
+    return (heap_block_t*)((uint8_t*)ptr - HEAP_BLOCK_HEADER);
+}
+
+static void* block_to_ptr(heap_block_t *block) {
+    return (uint8_t*)block + HEAP_BLOCK_HEADER;
+}
+
+/**
+ * @brief Следующий блок в памяти
+ */
+static heap_block_t* block_next(const heap_block_t *block) {
+    return (heap_block_t*)((uint8_t*)block + HEAP_BLOCK_HEADER + block_size(block));
+}
+
+/**
+ * @brief Предыдущий блок в памяти (только если он свободен)
+ */
+static heap_block_t* block_prev(const heap_block_t *block) {
+    return (heap_block_t*)((uint8_t*)block - block->prev_size - HEAP_BLOCK_HEADER);
+}
+
+/**
+ * @brief Установка размера с сохранением флагов
+ */
+static void block_set_size(heap_block_t *block, uint32_t size) {
+    block->size = size | (block->size & HEAP_BLOCK_FLAGS);
+}
+
+/**
+ * @brief Пометка блока свободным и запись граничного тега в следующий блок
+ */
+static void block_mark_free(heap_block_t *block) {
+    heap_block_t *next = block_next(block);
+    block->size |= HEAP_BLOCK_FREE;
+    next->prev_size = block_size(block);
+    next->size |= HEAP_BLOCK_PREV_FREE;
+}
+
+/**
+ * @brief Пометка блока занятым
+ */
+static void block_mark_used(heap_block_t *block) {
+    block->size &= ~(HEAP_BLOCK_FREE | HEAP_BLOCK_ZERO);
+    block_next(block)->size &= ~HEAP_BLOCK_PREV_FREE;
+}
+
+/**
+ * @brief Индекс старшего установленного бита
+ */
+static uint32_t heap_fls(uint32_t value) {
+    return 31 - __builtin_clz(value);
+}
+
+/**
+ * @brief Классы TLSF, в которых хранится блок заданного размера
+ * @param size Размер полезной части (кратен HEAP_ALIGN)
+ * @param fl Класс первого уровня
+ * @param sl Подкласс второго уровня
+ */
+static void mapping_insert(uint32_t size, uint32_t *fl, uint32_t *sl) {
+    if (size < HEAP_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size >> HEAP_ALIGN_LOG2;
+    } else {
+        uint32_t bit = heap_fls(size);
+        *sl = (size >> (bit - HEAP_SL_LOG2)) ^ HEAP_SL_COUNT;
+        *fl = bit - HEAP_FL_SHIFT + 1;
+    }
+}
+
+/**
+ * @brief Классы TLSF для поиска блока не меньше size
+ *
+ * Размер округляется вверх до границы подкласса, поэтому любой блок
+ * найденного списка подходит без перебора.
+ */
+static void mapping_search(uint32_t size, uint32_t *fl, uint32_t *sl) {
+    if (size >= HEAP_SMALL_BLOCK) {
+        size += (1u << (heap_fls(size) - HEAP_SL_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+/**
+ * @brief Включение свободного блока в сегрегированный список
+ */
+static void heap_insert_free(heap_t *heap, heap_block_t *block) {
+    uint32_t fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    heap_block_t *head = heap->free_lists[fl][sl];
+    block->next_free = head;
+    block->prev_free = NULL;
+    if (head) {
+        head->prev_free = block;
+    }
+    heap->free_lists[fl][sl] = block;
+    heap->fl_bitmap |= 1u << fl;
+    heap->sl_bitmap[fl] |= 1u << sl;
+    heap->free_bytes += block_size(block);
+    heap->free_blocks++;
+}
+
+/**
+ * @brief Исключение свободного блока из сегрегированного списка
+ */
+static void heap_remove_free(heap_t *heap, heap_block_t *block) {
+    uint32_t fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        heap->free_lists[fl][sl] = block->next_free;
+    }
+    if (block->next_free) {
+        block->next_free->prev_free = block->prev_free;
+    }
+    heap->free_bytes -= block_size(block);
+    heap->free_blocks--;
+
+    if (!heap->free_lists[fl][sl]) {
+        heap->sl_bitmap[fl] &= ~(1u << sl);
+        if (!heap->sl_bitmap[fl]) {
+            heap->fl_bitmap &= ~(1u << fl);
+        }
+    }
 }
 
 /**
  * @brief Поиск подходящего блока для выделения
+ *
+ * Два поиска младшего бита вместо обхода списка блоков.
  * @param size Требуемый размер
  * @return Указатель на подходящий блок или NULL
  */
-static heap_block_t* find_free_block(size_t size) {
-    heap_block_t *current = kernel_heap.first_block;
-    
-    while (current != NULL) {
-        if (!current->used && current->size >= size) {
-            return current;
+static heap_block_t* find_free_block(heap_t *heap, uint32_t size) {
+    uint32_t fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= HEAP_FL_COUNT) {
+        return NULL;
+    }
+
+    uint32_t sl_map = heap->sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint32_t fl_map = heap->fl_bitmap & (~0u << fl) & ~(1u << fl);
+        if (!fl_map) {
+            return NULL;
         }
-        current = current->next;
+        fl = __builtin_ctz(fl_map);
+        sl_map = heap->sl_bitmap[fl];
     }
-    
-    return NULL;
+    sl = __builtin_ctz(sl_map);
+
+    return heap->free_lists[fl][sl];
+}
+
+/**
+ * @brief Обнуление заголовка и связей поглощённого блока
+ *
+ * После этого объединённый блок снова обнулён целиком (кроме своих связей).
+ */
+static void block_clear_absorbed(heap_block_t *block) {
+    memory_set(block, 0, HEAP_BLOCK_HEADER + HEAP_MIN_PAYLOAD);
 }
 
 /**
- * @brief Разделение блока на два части
- * @param block Блок для разделения
- * @param size Размер первой части
+ * @brief Отделение хвоста блока в новый свободный блок
+ * @param block Занятый блок
+ * @param size Размер, который остаётся у блока
+ * @param zero HEAP_BLOCK_ZERO, если хвост был частью обнулённого блока
  */
-static void split_block(heap_block_t *block, size_t size) {
-    if (block->size < size + MIN_BLOCK_SIZE) {
+static void split_block(heap_t *heap, heap_block_t *block, uint32_t size, uint32_t zero) {
+    if (block_size(block) < size + MIN_BLOCK_SIZE) {
         return; /* Блок слишком мал для разделения */
     }
-    
-    /* Создаем новый блок */
-    heap_block_t *new_block = (heap_block_t*)((uint8_t*)block + sizeof(heap_block_t) + size);
-    new_block->size = block->size - size - sizeof(heap_block_t);
-    new_block->used = 0;
-    new_block->next = block->next;
-    new_block->prev = block;
-    
-    /* Обновляем связи */
-    if (block->next) {
-        block->next->prev = new_block;
+
+    heap_block_t *rest = (heap_block_t*)((uint8_t*)block_to_ptr(block) + size);
+    rest->prev_size = 0;
+    rest->size = (block_size(block) - size - HEAP_BLOCK_HEADER) | zero;
+    block_set_size(block, size);
+
+    /* Хвост может сразу слиться со следующим свободным блоком */
+    heap_block_t *next = block_next(rest);
+    if (block_is_free(next)) {
+        heap_remove_free(heap, next);
+        zero &= next->size;
+        rest->size = (block_size(rest) + HEAP_BLOCK_HEADER + block_size(next)) | zero;
+        if (zero) {
+            block_clear_absorbed(next);
+        }
     }
-    block->next = new_block;
-    block->size = size;
+    block_mark_free(rest);
+    heap_insert_free(heap, rest);
 }
 
 /**
  * @brief Объединение блока с соседними свободными блоками
- * @param block Блок для объединения
+ *
+ * Предыдущий блок находится по граничному тегу, следующий - по размеру,
+ * поэтому объединение не требует обхода.
+ * @param block Освобождаемый блок (ещё не в списке)
+ * @return Итоговый свободный блок
  */
-static void merge_blocks(heap_block_t *block) {
+static heap_block_t* merge_blocks(heap_t *heap, heap_block_t *block) {
     /* Объединяем с следующим блоком */
-    if (block->next && !block->next->used) {
-        block->size += sizeof(heap_block_t) + block->next->size;
-        block->next = block->next->next;
-        if (block->next) {
-            block->next->prev = block;
+    heap_block_t *next = block_next(block);
+    if (block_is_free(next)) {
+        heap_remove_free(heap, next);
+        uint32_t zero = block->size & next->size & HEAP_BLOCK_ZERO;
+        block->size &= ~HEAP_BLOCK_ZERO;
+        block_set_size(block, block_size(block) + HEAP_BLOCK_HEADER + block_size(next));
+        block->size |= zero;
+        if (zero) {
+            block_clear_absorbed(next);
         }
     }
-    
+
     /* Объединяем с предыдущим блоком */
-    if (block->prev && !block->prev->used) {
-        block->prev->size += sizeof(heap_block_t) + block->size;
-        block->prev->next = block->next;
-        if (block->next) {
-            block->next->prev = block->prev;
+    if (block->size & HEAP_BLOCK_PREV_FREE) {
+        heap_block_t *prev = block_prev(block);
+        heap_remove_free(heap, prev);
+        uint32_t zero = prev->size & block->size & HEAP_BLOCK_ZERO;
+        prev->size &= ~HEAP_BLOCK_ZERO;
+        block_set_size(prev, block_size(prev) + HEAP_BLOCK_HEADER + block_size(block));
+        prev->size |= zero;
+        if (zero) {
+            /* Обнулённый заголовок (размер 0) тоже не пройдёт проверку в heap_free */
+            block_clear_absorbed(block);
+        } else {
+            /* Старый заголовок остаётся помеченным свободным: повторный kfree будет отвергнут */
+            block->size |= HEAP_BLOCK_FREE;
         }
+        block = prev;
     }
+
+    return block;
 }
 
 /**
- * @brief Выделение памяти в куче ядра
+ * @brief Добавление пула в кучу
+ *
+ * Область превращается в заголовок пула, один свободный блок и замыкающий
+ * занятый блок нулевого размера, на котором останавливается объединение.
+ * prev_size первого блока помечен HEAP_POOL_FIRST - так освободившийся
+ * целиком пул узнаётся без обхода блоков.
+ */
+static void heap_pool_add(heap_t *heap, uint32_t start, uint32_t size, uint32_t order, uint32_t flags) {
+    heap_pool_t *pool = (heap_pool_t*)start;
+    pool->size = size;
+    pool->order = order;
+    pool->flags = flags;
+    pool->next = heap->pools;
+    heap->pools = pool;
+
+    if (heap->pool_count++ == 0 || start < heap->start_addr) {
+        heap->start_addr = start;
+    }
+    if (start + size > heap->end_addr) {
+        heap->end_addr = start + size;
+    }
+    heap->total_size += size;
+
+    /* Создаем первый свободный блок и замыкающий блок */
+    heap_block_t *first_block = (heap_block_t*)(start + sizeof(heap_pool_t));
+    first_block->prev_size = HEAP_POOL_FIRST;
+    first_block->size = size - POOL_OVERHEAD;
+
+    heap_block_t *sentinel = block_next(first_block);
+    sentinel->size = 0;
+
+    block_mark_free(first_block);
+    heap_insert_free(heap, first_block);
+}
+
+/**
+ * @brief Новый пул из блока PMM
+ * @param heap Растущая куча
+ * @param size Полезный размер, который должен поместиться в пул
+ * @param flags HEAP_POOL_*
+ * @return 1 при успехе, 0 если PMM не выдал блок
+ */
+static int heap_pool_from_pmm(heap_t *heap, uint32_t size, uint32_t flags) {
+    uint32_t order = HEAP_POOL_MIN_ORDER;
+    uint32_t pool_size = PAGE_SIZE << HEAP_POOL_MIN_ORDER;
+
+    while (order < PMM_MAX_ORDER && pool_size < size) {
+        order++;
+        pool_size <<= 1;
+    }
+    if (pool_size < size) {
+        return 0;
+    }
+
+    uint32_t start = pmm_alloc_pages(order);
+    if (!start) {
+        return 0;
+    }
+    pmm_set_page_flags(start, 1u << order, PG_HEAP);
+
+    heap_granules_set(start, pool_size, 1);
+    heap_pool_add(heap, start, pool_size, order, flags);
+    return 1;
+}
+
+/**
+ * @brief Рост кучи под запрос заданного размера
+ *
+ * Поиск TLSF округляет размер вверх до границы подкласса (до 1/16),
+ * поэтому пул берётся с этим запасом.
+ */
+static int heap_grow(heap_t *heap, uint32_t size) {
+    uint32_t need = size + (size >> HEAP_SL_LOG2) + POOL_OVERHEAD;
+    if (need < size || !heap_pool_from_pmm(heap, need, HEAP_POOL_RELEASABLE)) {
+        return 0;
+    }
+
+    heap->grows++;
+    return 1;
+}
+
+/**
+ * @brief Пул, который освободился целиком и может вернуться PMM
+ * @return Единственный свободный блок пула или NULL
+ */
+static heap_block_t* heap_pool_empty_block(heap_pool_t *pool) {
+    heap_block_t *first = (heap_block_t*)((uint8_t*)pool + sizeof(heap_pool_t));
+    if (!(pool->flags & HEAP_POOL_RELEASABLE) || !block_is_free(first) ||
+        block_size(block_next(first)) != 0) {
+        return NULL;
+    }
+    return first;
+}
+
+/**
+ * @brief Возврат PMM пустых пулов сверх запаса
+ *
+ * kfree не отдаёт опустевший пул сразу: иначе выделение и освобождение
+ * на границе пула каждый раз брали бы и возвращали блок PMM. Пулы
+ * возвращаются в простое (с запасом HEAP_SPARE_POOLS) и под давлением
+ * памяти (shrinker, без запаса).
+ * @param keep Сколько пустых пулов оставить
+ * @return Возвращено страниц
+ */
+uint32_t heap_trim(heap_t *heap, uint32_t keep) {
+    uint32_t released = 0;
+    heap_pool_t **link = &heap->pools;
+
+    heap->trim_wanted = 0;
+    while (*link) {
+        heap_pool_t *pool = *link;
+        heap_block_t *block = heap_pool_empty_block(pool);
+        if (block && keep) {
+            keep--;
+            block = NULL;
+        }
+        if (!block) {
+            link = &pool->next;
+            continue;
+        }
+
+        *link = pool->next;
+        heap_remove_free(heap, block);
+        heap->pool_count--;
+        heap->total_size -= pool->size;
+        heap->shrinks++;
+        heap_granules_set((uint32_t)pool, pool->size, 0);
+        pmm_free_pages((uint32_t)pool, pool->order);
+        released += 1u << pool->order;
+    }
+    if (!released) {
+        return 0;
+    }
+
+    /* Пересчитываем границы оставшихся пулов */
+    heap->start_addr = 0;
+    heap->end_addr = 0;
+    for (heap_pool_t *rest = heap->pools; rest; rest = rest->next) {
+        if (!heap->start_addr || (uint32_t)rest < heap->start_addr) {
+            heap->start_addr = (uint32_t)rest;
+        }
+        if ((uint32_t)rest + rest->size > heap->end_addr) {
+            heap->end_addr = (uint32_t)rest + rest->size;
+        }
+    }
+    return released;
+}
+
+/**
+ * @brief Shrinker: все пустые пулы кучи ядра возвращаются PMM
+ */
+static uint32_t heap_shrink(uint32_t target) {
+    (void)target;
+    return heap_trim(&kernel_heap, 0);
+}
+
+static shrinker_t heap_shrinker = { .name = "heap", .cost = SHRINKER_COST_HEAP, .scan = heap_shrink };
+
+/**
+ * @brief Размещение кучи фиксированного размера в области памяти
+ * @param heap Экземпляр кучи
+ * @param start_addr Начальный адрес области
+ * @param size Размер области в байтах
+ */
+void heap_create(heap_t *heap, uint32_t start_addr, uint32_t size) {
+    /* Выравниваем адрес и размер */
+    uint32_t end_addr = align_down(start_addr + size, HEAP_ALIGN);
+    start_addr = align_up(start_addr, HEAP_ALIGN);
+    size = end_addr > start_addr ? end_addr - start_addr : 0;
+    if (size > HEAP_MAX_BLOCK) {
+        size = HEAP_MAX_BLOCK;
+    }
+
+    memory_set(heap, 0, sizeof(heap_t));
+    if (size >= POOL_OVERHEAD + HEAP_MIN_PAYLOAD) {
+        heap_pool_add(heap, start_addr, size, 0, 0);
+    }
+}
+
+/**
+ * @brief Выравнивание полезной части свободного блока
+ *
+ * Отступ до выровненного адреса отделяется в самостоятельный свободный
+ * блок и возвращается в список, а не теряется.
+ * @param block Свободный блок, уже исключённый из списка
+ * @param align Выравнивание (степень двойки больше HEAP_ALIGN)
+ * @return Блок с выровненной полезной частью (ещё свободный, вне списка)
+ */
+static heap_block_t* heap_align_block(heap_t *heap, heap_block_t *block, uint32_t align) {
+    uint32_t ptr = (uint32_t)block_to_ptr(block);
+    uint32_t aligned = align_up(ptr, align);
+    if (aligned == ptr) {
+        return block;
+    }
+
+    /* Отступ должен вместить заголовок и минимальную полезную часть */
+    if (aligned - ptr < MIN_BLOCK_SIZE) {
+        aligned = align_up(ptr + MIN_BLOCK_SIZE, align);
+    }
+    uint32_t gap = aligned - ptr;
+
+    heap_block_t *aligned_block = block_from_ptr((void*)aligned);
+    aligned_block->size = (block_size(block) - gap) | (block->size & HEAP_BLOCK_ZERO);
+    block_set_size(block, gap - HEAP_BLOCK_HEADER);
+
+    block_mark_free(block);
+    heap_insert_free(heap, block);
+    return aligned_block;
+}
+
+/**
+ * @brief Поиск и захват свободного блока
+ * @param heap Экземпляр кучи
  * @param size Размер для выделения
- * @return Указатель на выделенную память или NULL при ошибке
+ * @param align Выравнивание полезной части (степень двойки)
+ * @param zero Сюда записывается HEAP_BLOCK_ZERO, если блок был обнулён
+ * @return Занятый блок или NULL
  */
-void* kmalloc(size_t size) {
-    if (size == 0) {
+static heap_block_t* heap_take_block(heap_t *heap, size_t size, size_t align, uint32_t *zero) {
+    if (size == 0 || size > HEAP_MAX_BLOCK || align > HEAP_MAX_BLOCK) {
         return NULL;
     }
-    
+
     /* Выравниваем размер */
-    size = align_up(size, 8);
-    
-    /* Ищем подходящий блок */
-    heap_block_t *block = find_free_block(size);
+    size = align_up(size, HEAP_ALIGN);
+    if (size < HEAP_MIN_PAYLOAD) {
+        size = HEAP_MIN_PAYLOAD;
+    }
+
+    /* Для сильного выравнивания ищем блок с запасом под отступ */
+    uint32_t search = size;
+    if (align > HEAP_ALIGN) {
+        search = size + align + MIN_BLOCK_SIZE;
+    }
+
+    heap_block_t *block = find_free_block(heap, search);
+    if (!block && heap->growable && heap_grow(heap, search)) {
+        block = find_free_block(heap, search);
+    }
     if (!block) {
         return NULL; /* Нет свободного места */
     }
-    
-    /* Разделяем блок, если нужно */
-    split_block(block, size);
-    
-    /* Помечаем блок как занятый */
-    block->used = 1;
-    kernel_heap.used_size += block->size;
-    
-    /* Возвращаем указатель на данные блока */
-    return (void*)((uint8_t*)block + sizeof(heap_block_t));
+
+    *zero = block->size & HEAP_BLOCK_ZERO;
+    heap_remove_free(heap, block);
+    if (align > HEAP_ALIGN) {
+        block = heap_align_block(heap, block, align);
+    }
+    block_mark_used(block);
+    split_block(heap, block, size, *zero);
+
+    heap->used_size += block_size(block);
+    heap->used_blocks++;
+    return block;
+}
+
+/**
+ * @brief Выделение блока из экземпляра кучи
+ * @param heap Экземпляр кучи
+ * @param size Размер для выделения
+ * @return Указатель на выделенную память или NULL
+ */
+void* heap_alloc(heap_t *heap, size_t size) {
+    uint32_t zero;
+    heap_block_t *block = heap_take_block(heap, size, HEAP_ALIGN, &zero);
+    return block ? block_to_ptr(block) : NULL;
+}
+
+/**
+ * @brief Выделение блока с выравниванием из экземпляра кучи
+ * @param heap Экземпляр кучи
+ * @param size Размер для выделения
+ * @param align Выравнивание (степень двойки)
+ * @return Выровненный указатель или NULL
+ */
+void* heap_alloc_aligned(heap_t *heap, size_t size, size_t align) {
+    uint32_t zero;
+
+    if (align == 0 || (align & (align - 1))) {
+        return NULL;
+    }
+
+    heap_block_t *block = heap_take_block(heap, size, align, &zero);
+    return block ? block_to_ptr(block) : NULL;
+}
+
+/**
+ * @brief Выделение обнулённого блока из экземпляра кучи
+ *
+ * У блока с флагом HEAP_BLOCK_ZERO обнуляются только бывшие связи списка.
+ * @param heap Экземпляр кучи
+ * @param size Размер для выделения
+ * @return Указатель на обнулённую память или NULL
+ */
+void* heap_zalloc(heap_t *heap, size_t size) {
+    uint32_t zero;
+    heap_block_t *block = heap_take_block(heap, size, HEAP_ALIGN, &zero);
+    if (!block) {
+        return NULL;
+    }
+
+    void *ptr = block_to_ptr(block);
+    memory_set(ptr, 0, zero ? HEAP_MIN_PAYLOAD : block_size(block));
+    return ptr;
+}
+
+/**
+ * @brief Освобождение блока экземпляра кучи
+ * @param heap Экземпляр кучи
+ * @param ptr Указатель, полученный от heap_alloc
+ */
+void heap_free(heap_t *heap, void *ptr) {
+    if (!ptr || !heap_owns(heap, ptr)) {
+        return;
+    }
+
+    heap_block_t *block = block_from_ptr(ptr);
+
+    /* Проверяем, что блок был занят */
+    if (block_is_free(block) || block_size(block) < HEAP_MIN_PAYLOAD) {
+        return;
+    }
+
+    heap->used_size -= block_size(block);
+    heap->used_blocks--;
+    if (heap->scrub) {
+        memory_set(ptr, 0, block_size(block));
+        block->size |= HEAP_BLOCK_ZERO;
+    }
+    block = merge_blocks(heap, block);
+    block_mark_free(block);
+    heap_insert_free(heap, block);
+    /* Блок от метки пула до замыкающего - пул пуст, его вернёт heap_trim */
+    if (heap->growable && block->prev_size == HEAP_POOL_FIRST &&
+        block_size(block_next(block)) == 0) {
+        heap->trim_wanted = 1;
+    }
+}
+
+/**
+ * @brief Изменение размера блока экземпляра кучи
+ *
+ * Блок уменьшается или растёт на месте за счёт свободного соседа справа;
+ * только если это невозможно, данные переносятся в новый блок.
+ * @return Указатель на блок нового размера или NULL
+ */
+void* heap_realloc(heap_t *heap, void *ptr, size_t new_size) {
+    if (new_size == 0 || new_size > HEAP_MAX_BLOCK) {
+        return NULL;
+    }
+
+    heap_block_t *block = block_from_ptr(ptr);
+    uint32_t old_size = block_size(block);
+
+    new_size = align_up(new_size, HEAP_ALIGN);
+    if (new_size < HEAP_MIN_PAYLOAD) {
+        new_size = HEAP_MIN_PAYLOAD;
+    }
+
+    /* Пытаемся расширить блок за счёт следующего */
+    if (new_size > old_size) {
+        heap_block_t *next = block_next(block);
+        if (block_is_free(next) &&
+            old_size + HEAP_BLOCK_HEADER + block_size(next) >= new_size) {
+            heap_remove_free(heap, next);
+            block_set_size(block, old_size + HEAP_BLOCK_HEADER + block_size(next));
+            block_mark_used(block);
+        }
+    }
+
+    if (block_size(block) >= new_size) {
+        split_block(heap, block, new_size, 0);
+        heap->used_size += block_size(block) - old_size;
+        return ptr;
+    }
+
+    /* Не можем расширить, выделяем новый блок */
+    void *new_ptr = heap_alloc(heap, new_size);
+    if (new_ptr) {
+        memory_copy(new_ptr, ptr, old_size);
+        heap_free(heap, ptr);
+    }
+
+    return new_ptr;
+}
+
+/**
+ * @brief Наибольший свободный блок кучи
+ *
+ * Старший непустой список TLSF находится по битовым картам; в нём
+ * просматриваются первые HEAP_PROF_SCAN блоков, так что результат точен
+ * до подкласса (1/16 размера) и не требует обхода кучи.
+ * @return Полезный размер блока в байтах или 0, если свободных нет
+ */
+uint32_t heap_largest_free(const heap_t *heap) {
+    if (!heap->fl_bitmap) {
+        return 0;
+    }
+
+    uint32_t fl = heap_fls(heap->fl_bitmap);
+    uint32_t sl = heap_fls(heap->sl_bitmap[fl]);
+    uint32_t largest = 0;
+    const heap_block_t *block = heap->free_lists[fl][sl];
+
+    for (uint32_t i = 0; block && i < HEAP_PROF_SCAN; i++) {
+        if (block_size(block) > largest) {
+            largest = block_size(block);
+        }
+        block = block->next_free;
+    }
+    return largest;
+}
+
+/**
+ * @brief Сообщение о нарушенном инварианте кучи
+ * @return -1
+ */
+static int heap_check_fail(const char *what, uint32_t where) {
+    print_string("heap_check: ");
+    print_string(what);
+    print_string(": ");
+    print_hex(where);
+    print_string("\n");
+    return -1;
+}
+
+/**
+ * @brief Проверка инвариантов кучи
+ *
+ * Обходит блоки каждого пула (границы, граничные теги, флаги PREV_FREE,
+ * отсутствие соседних свободных блоков), затем сегрегированные списки
+ * (битовые карты, связи, класс каждого блока) и сверяет счётчики.
+ * Время линейно по числу блоков - только для тестов.
+ * @return 0, если куча согласована, -1 при первом нарушении
+ */
+int heap_check(const heap_t *heap) {
+    uint32_t used_blocks = 0;
+    uint32_t used_size = 0;
+    uint32_t free_blocks = 0;
+    uint32_t free_bytes = 0;
+
+    for (heap_pool_t *pool = heap->pools; pool; pool = pool->next) {
+        uint32_t pool_end = (uint32_t)pool + pool->size;
+        heap_block_t *block = (heap_block_t*)((uint8_t*)pool + sizeof(heap_pool_t));
+        int prev_free = 0;
+
+        if (block->prev_size != HEAP_POOL_FIRST) {
+            return heap_check_fail("first block lost pool mark", (uint32_t)block);
+        }
+
+        while (block_size(block) != 0) {
+            if ((uint32_t)block_next(block) + HEAP_BLOCK_HEADER > pool_end) {
+                return heap_check_fail("block crosses pool end", (uint32_t)block);
+            }
+            if (!(block->size & HEAP_BLOCK_PREV_FREE) != !prev_free) {
+                return heap_check_fail("PREV_FREE flag mismatch", (uint32_t)block);
+            }
+            if (prev_free && block_size(block_prev(block)) + HEAP_BLOCK_HEADER +
+                             (uint32_t)block_prev(block) != (uint32_t)block) {
+                return heap_check_fail("boundary tag mismatch", (uint32_t)block);
+            }
+
+            if (block_is_free(block)) {
+                if (prev_free) {
+                    return heap_check_fail("adjacent free blocks", (uint32_t)block);
+                }
+                free_blocks++;
+                free_bytes += block_size(block);
+            } else {
+                if (block->size & HEAP_BLOCK_ZERO) {
+                    return heap_check_fail("ZERO flag on used block", (uint32_t)block);
+                }
+                used_blocks++;
+                used_size += block_size(block);
+            }
+            prev_free = block_is_free(block);
+            block = block_next(block);
+        }
+
+        if ((uint32_t)block + HEAP_BLOCK_HEADER != pool_end) {
+            return heap_check_fail("sentinel not at pool end", (uint32_t)block);
+        }
+        if (!(block->size & HEAP_BLOCK_PREV_FREE) != !prev_free) {
+            return heap_check_fail("sentinel PREV_FREE mismatch", (uint32_t)block);
+        }
+    }
+
+    uint32_t listed = 0;
+    for (uint32_t fl = 0; fl < HEAP_FL_COUNT; fl++) {
+        if (!(heap->fl_bitmap & (1u << fl)) != !heap->sl_bitmap[fl]) {
+            return heap_check_fail("fl bitmap mismatch", fl);
+        }
+        for (uint32_t sl = 0; sl < HEAP_SL_COUNT; sl++) {
+            heap_block_t *block = heap->free_lists[fl][sl];
+            if (!(heap->sl_bitmap[fl] & (1u << sl)) != !block) {
+                return heap_check_fail("sl bitmap mismatch", fl * HEAP_SL_COUNT + sl);
+            }
+
+            heap_block_t *prev = NULL;
+            for (; block; prev = block, block = block->next_free) {
+                uint32_t block_fl, block_sl;
+                mapping_insert(block_size(block), &block_fl, &block_sl);
+                if (!block_is_free(block) || block->prev_free != prev ||
+                    block_fl != fl || block_sl != sl) {
+                    return heap_check_fail("bad free list entry", (uint32_t)block);
+                }
+                if (++listed > free_blocks) {
+                    return heap_check_fail("free list cycle", (uint32_t)block);
+                }
+            }
+        }
+    }
+
+    if (listed != free_blocks || free_blocks != heap->free_blocks ||
+        free_bytes != heap->free_bytes) {
+        return heap_check_fail("free block counters", listed);
+    }
+    if (used_blocks != heap->used_blocks || used_size != heap->used_size) {
+        return heap_check_fail("used block counters", used_blocks);
+    }
+    return 0;
+}
+
+/**
+ * @brief Инициализация кучи ядра
+ *
+ * Начальный пул берётся у PMM и остаётся за кучей навсегда,
+ * дальше куча растёт и сжимается пулами по требованию.
+ * @param initial_size Размер начального пула в байтах
+ */
+void heap_init(uint32_t initial_size) {
+    print_string("Heap Initialization... ");
+
+    memory_set(&kernel_heap, 0, sizeof(heap_t));
+    kernel_heap.growable = 1;
+#ifdef HEAP_SCRUB
+    kernel_heap.scrub = 1;
+#endif
+
+    if (!heap_pool_from_pmm(&kernel_heap, initial_size, 0)) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    shrinker_register(&heap_shrinker);
+
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Start: ");
+    print_hex(kernel_heap.start_addr);
+    print_string("\n  - Size: ");
+    print_hex(kernel_heap.total_size);
+    print_string(" bytes (grows on demand)\n");
+}
+
+/**
+ * @brief Включение или выключение обнуления памяти при освобождении
+ *
+ * Действует на кучу и на объекты кэшей kmalloc.
+ * @param enabled 1 - обнулять при kfree, 0 - нет
+ */
+void heap_set_scrub(int enabled) {
+    kernel_heap.scrub = enabled;
+}
+
+/**
+ * @brief Количество страниц под size байт
+ * @return Страницы или 0, если размер больше наибольшего блока PMM
+ */
+static uint32_t heap_pages_for(size_t size) {
+    if (size > PMM_MAX_BLOCK_PAGES * PAGE_SIZE) {
+        return 0;
+    }
+    return (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+}
+
+/**
+ * @brief Ячейка хеш-таблицы, где лежит (или должна лежать) запись об адресе
+ */
+static heap_page_alloc_t** page_alloc_slot(uint32_t addr) {
+    heap_page_alloc_t **link = &page_allocs[(addr >> PAGE_SHIFT) & (HEAP_PAGE_BUCKETS - 1)];
+    while (*link && (*link)->addr != addr) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+/**
+ * @brief Выделение непрерывных страниц напрямую у PMM (без учёта в heap_prof)
+ */
+static void* kmalloc_pages_raw(uint32_t count) {
+    if (!page_alloc_cache) {
+        page_alloc_cache = kmem_cache_create("page_alloc", sizeof(heap_page_alloc_t), SLAB_MIN_SIZE);
+        if (!page_alloc_cache) {
+            return NULL;
+        }
+    }
+
+    heap_page_alloc_t *record = kmem_cache_alloc(page_alloc_cache);
+    if (!record) {
+        return NULL;
+    }
+
+    uint32_t addr = pmm_alloc_pages_exact(count);
+    if (!addr) {
+        kmem_cache_free(page_alloc_cache, record);
+        return NULL;
+    }
+    pmm_set_page_flags(addr, count, PG_HEAP);
+
+    record->addr = addr;
+    record->pages = count;
+    record->site = 0;
+    heap_page_alloc_t **slot = page_alloc_slot(addr);
+    record->next = NULL;
+    *slot = record;
+
+    page_alloc_count++;
+    page_alloc_pages += count;
+    return (void*)addr;
+}
+
+/**
+ * @brief Освобождение страничного выделения
+ * @return 1, если указатель был выдан kmalloc_pages, иначе 0
+ */
+static int kfree_pages(void *ptr) {
+    heap_page_alloc_t **slot = page_alloc_slot((uint32_t)ptr);
+    heap_page_alloc_t *record = *slot;
+    if (!record) {
+        return 0;
+    }
+
+    if (kernel_heap.scrub) {
+        memory_set(ptr, 0, record->pages * PAGE_SIZE);
+    }
+
+    *slot = record->next;
+    page_alloc_count--;
+    page_alloc_pages -= record->pages;
+    pmm_free_pages_exact(record->addr, record->pages);
+    kmem_cache_free(page_alloc_cache, record);
+    return 1;
+}
+
+/**
+ * @brief Выделение памяти без учёта в heap_prof
+ *
+ * Запросы HEAP_SMALL и HEAP_MEDIUM обслуживаются кэшами slab-аллокатора,
+ * TLSF используется для HEAP_LARGE и как запасной путь,
+ * если PMM не смог выдать страницу под новый слаб.
+ */
+static void* kmalloc_raw(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (size >= HEAP_DIRECT_THRESHOLD) {
+        uint32_t pages = heap_pages_for(size);
+        return pages ? kmalloc_pages_raw(pages) : NULL;
+    }
+
+    if (heap_size_class(size) != HEAP_LARGE) {
+        void *obj = slab_kmalloc(size);
+        if (obj) {
+            return obj;
+        }
+    }
+
+    return heap_alloc(&kernel_heap, size);
+}
+
+/**
+ * @brief Освобождение памяти без учёта в heap_prof
+ */
+static void kfree_raw(void *ptr) {
+    if (heap_owns(&kernel_heap, ptr)) {
+        heap_free(&kernel_heap, ptr);
+        return;
+    }
+
+    /* Вне кучи: страничное выделение (выровнено на страницу) или объект слаба */
+    if (!((uint32_t)ptr & ~PAGE_MASK)) {
+        kfree_pages(ptr);
+    } else {
+        slab_kfree(ptr);
+    }
+}
+
+/**
+ * @brief Выделение обнулённой памяти без учёта в heap_prof
+ */
+static void* kzalloc_raw(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (size >= HEAP_DIRECT_THRESHOLD) {
+        void *pages = kmalloc_raw(size);
+        if (pages) {
+            memory_set(pages, 0, size);
+        }
+        return pages;
+    }
+
+    if (heap_size_class(size) != HEAP_LARGE) {
+        void *obj = slab_kmalloc(size);
+        if (obj) {
+            memory_set(obj, 0, size);
+            return obj;
+        }
+    }
+
+    return heap_zalloc(&kernel_heap, size);
+}
+
+/**
+ * @brief Размер выделения kmalloc и ячейка метки его места вызова
+ * @param ptr Указатель, выданный kmalloc
+ * @param tag Сюда записывается адрес метки
+ * @return Полезный размер или 0, если указатель не является живым выделением
+ */
+static uint32_t kmalloc_lookup(void *ptr, uint8_t **tag) {
+    if (heap_owns(&kernel_heap, ptr)) {
+        heap_block_t *block = block_from_ptr(ptr);
+        if (block_is_free(block) || block_size(block) < HEAP_MIN_PAYLOAD) {
+            return 0;
+        }
+        /* prev_size следующего блока не используется, пока этот блок занят */
+        *tag = (uint8_t*)&block_next(block)->prev_size;
+        return block_size(block);
+    }
+
+    if (!((uint32_t)ptr & ~PAGE_MASK)) {
+        heap_page_alloc_t *record = *page_alloc_slot((uint32_t)ptr);
+        if (!record) {
+            return 0;
+        }
+        *tag = &record->site;
+        return record->pages * PAGE_SIZE;
+    }
+
+    *tag = slab_object_tag(ptr);
+    return *tag ? slab_object_size(ptr) : 0;
+}
+
+/**
+ * @brief Учёт нового выделения за местом вызова
+ * @return ptr
+ */
+static void* kmalloc_track(void *ptr, const void *key, const char *name) {
+    uint8_t *tag;
+    uint32_t size = ptr ? kmalloc_lookup(ptr, &tag) : 0;
+
+    if (size) {
+        *tag = heap_prof_site(key, name);
+        heap_prof_alloc(*tag, size);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Выделение непрерывных страниц напрямую у PMM
+ *
+ * Память выровнена на страницу; освобождается через kfree.
+ * @param count Количество страниц
+ * @return Указатель на первую страницу или NULL
+ */
+void* kmalloc_pages(uint32_t count) {
+    return kmalloc_track(kmalloc_pages_raw(count), __builtin_return_address(0), NULL);
+}
+
+/**
+ * @brief Выделение памяти в куче ядра
+ *
+ * Выделение учитывается в heap_prof за адресом вызова.
+ * @param size Размер для выделения
+ * @return Указатель на выделенную память или NULL при ошибке
+ */
+void* kmalloc(size_t size) {
+    return kmalloc_track(kmalloc_raw(size), __builtin_return_address(0), NULL);
+}
+
+/**
+ * @brief Выделение памяти с явным тегом для heap_prof
+ *
+ * Все выделения с одним тегом учитываются вместе, где бы ни был вызов.
+ * @param size Размер для выделения
+ * @param tag Имя тега (строка должна жить всё время работы ядра)
+ * @return Указатель на выделенную память или NULL при ошибке
+ */
+void* kmalloc_tagged(size_t size, const char *tag) {
+    return kmalloc_track(kmalloc_raw(size), tag, tag);
 }
 
 /**
@@ -155,109 +1152,156 @@ void kfree(void* ptr) {
     if (!ptr) {
         return;
     }
-    
-    /* Получаем блок из указателя */
-    heap_block_t *block = (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
-    
-    /* Проверяем, что блок находится в пределах кучи */
-    if ((uint8_t*)block < (uint8_t*)kernel_heap.start_addr || 
-        (uint8_t*)block >= (uint8_t*)kernel_heap.end_addr) {
-        return;
+
+    uint8_t *tag;
+    uint32_t size = kmalloc_lookup(ptr, &tag);
+    if (size) {
+        heap_prof_free(*tag, size);
     }
-    
-    /* Проверяем, что блок был занят */
-    if (!block->used) {
-        return;
+    kfree_raw(ptr);
+}
+
+/**
+ * @brief Выделение обнулённой памяти
+ * @param size Размер для выделения
+ * @return Указатель на обнулённую память или NULL при ошибке
+ */
+void* kzalloc(size_t size) {
+    return kmalloc_track(kzalloc_raw(size), __builtin_return_address(0), NULL);
+}
+
+/**
+ * @brief Выделение обнулённого массива
+ * @param count Количество элементов
+ * @param size Размер элемента
+ * @return Указатель на обнулённую память или NULL при ошибке или переполнении
+ */
+void* kcalloc(size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size) {
+        return NULL;
+    }
+    return kmalloc_track(kzalloc_raw(count * size), __builtin_return_address(0), NULL);
+}
+
+/**
+ * @brief Выделение памяти с заданным выравниванием
+ *
+ * Отступ до выровненного адреса возвращается в свободные списки кучи.
+ * Крупные запросы с выравниванием не больше страницы уходят в PMM.
+ * @param size Размер для выделения
+ * @param align Выравнивание в байтах (степень двойки)
+ * @return Выровненный указатель или NULL; освобождается через kfree
+ */
+void* kmalloc_aligned(size_t size, size_t align) {
+    void *ptr;
+
+    if (size == 0 || align == 0 || (align & (align - 1))) {
+        return NULL;
+    }
+
+    if (align <= HEAP_ALIGN || (size >= HEAP_DIRECT_THRESHOLD && align <= PAGE_SIZE)) {
+        ptr = kmalloc_raw(size);
+    } else {
+        ptr = heap_alloc_aligned(&kernel_heap, size, align);
+    }
+    return kmalloc_track(ptr, __builtin_return_address(0), NULL);
+}
+
+/**
+ * @brief Изменение размера страничного выделения
+ *
+ * При уменьшении лишние страницы сразу возвращаются PMM.
+ */
+static void* krealloc_pages(void *ptr, size_t new_size) {
+    heap_page_alloc_t *record = *page_alloc_slot((uint32_t)ptr);
+    uint32_t pages = heap_pages_for(new_size);
+
+    if (pages && pages <= record->pages) {
+        pmm_free_pages_exact(record->addr + pages * PAGE_SIZE, record->pages - pages);
+        page_alloc_pages -= record->pages - pages;
+        record->pages = pages;
+        return ptr;
+    }
+
+    void *new_ptr = kmalloc_raw(new_size);
+    if (new_ptr) {
+        memory_copy(new_ptr, ptr, record->pages * PAGE_SIZE);
+        kfree_raw(ptr);
     }
-    
-    /* Освобождаем блок */
-    block->used = 0;
-    kernel_heap.used_size -= block->size;
-    
-    /* Очищаем содержимое блока */
-    memory_set(ptr, 0, block->size);
-    
-    /* Объединяем с соседними свободными блоками */
-    merge_blocks(block);
+    return new_ptr;
+}
+
+/**
+ * @brief Изменение размера выделения без учёта в heap_prof
+ * @param old_size Полезный размер текущего выделения
+ */
+static void* krealloc_raw(void *ptr, uint32_t old_size, size_t new_size) {
+    if (heap_owns(&kernel_heap, ptr)) {
+        return heap_realloc(&kernel_heap, ptr, new_size);
+    }
+
+    if (!((uint32_t)ptr & ~PAGE_MASK)) {
+        return krealloc_pages(ptr, new_size);
+    }
+
+    /* Объект слаба: размер объекта фиксирован, при росте - перенос */
+    if (new_size <= old_size) {
+        return ptr;
+    }
+    void *new_obj = kmalloc_raw(new_size);
+    if (new_obj) {
+        memory_copy(new_obj, ptr, old_size);
+        kfree_raw(ptr);
+    }
+    return new_obj;
 }
 
 /**
  * @brief Изменение размера выделенной памяти
+ *
+ * Результат учитывается в heap_prof за местом вызова krealloc.
  * @param ptr Указатель на память
  * @param new_size Новый размер
  * @return Указатель на память с новым размером или NULL при ошибке
  */
 void* krealloc(void* ptr, size_t new_size) {
+    void *caller = __builtin_return_address(0);
+
     if (!ptr) {
-        return kmalloc(new_size);
+        return kmalloc_track(kmalloc_raw(new_size), caller, NULL);
     }
-    
+
     if (new_size == 0) {
         kfree(ptr);
         return NULL;
     }
-    
-    /* Получаем текущий блок */
-    heap_block_t *block = (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
-    
-    /* Выравниваем новый размер */
-    new_size = align_up(new_size, 8);
-    
-    /* Если новый размер меньше или равен текущему */
-    if (new_size <= block->size) {
-        return ptr;
-    }
-    
-    /* Пытаемся расширить блок */
-    if (block->next && !block->next->used) {
-        size_t total_size = block->size + sizeof(heap_block_t) + block->next->size;
-        if (total_size >= new_size) {
-            /* Можем расширить блок */
-            block->size = new_size;
-            kernel_heap.used_size += (new_size - block->size);
-            
-            /* Обновляем следующий блок */
-            if (total_size - new_size >= MIN_BLOCK_SIZE) {
-                heap_block_t *new_next = (heap_block_t*)((uint8_t*)block + sizeof(heap_block_t) + new_size);
-                new_next->size = total_size - new_size - sizeof(heap_block_t);
-                new_next->used = 0;
-                new_next->next = block->next->next;
-                new_next->prev = block;
-                
-                if (block->next->next) {
-                    block->next->next->prev = new_next;
-                }
-                block->next = new_next;
-            } else {
-                /* Следующий блок слишком мал, объединяем */
-                block->size = total_size;
-                block->next = block->next->next;
-                if (block->next) {
-                    block->next->prev = block;
-                }
-            }
-            return ptr;
-        }
+
+    uint8_t *tag;
+    uint32_t old_size = kmalloc_lookup(ptr, &tag);
+    if (!old_size) {
+        return NULL; /* Указатель не выдан kmalloc */
     }
-    
-    /* Не можем расширить, выделяем новый блок */
-    void* new_ptr = kmalloc(new_size);
-    if (new_ptr) {
-        memory_copy(new_ptr, ptr, block->size);
-        kfree(ptr);
+
+    uint8_t site = *tag;
+    heap_prof_free(site, old_size);
+
+    void *new_ptr = krealloc_raw(ptr, old_size, new_size);
+    if (!new_ptr) {
+        /* Старое выделение осталось на месте */
+        heap_prof_alloc(site, old_size);
+        return NULL;
     }
-    
-    return new_ptr;
+    return kmalloc_track(new_ptr, caller, NULL);
 }
 
 /**
- * @brief Вывод информации о состоянии кучи окак
+ * @brief Вывод информации о состоянии кучи
  */
 void heap_dump_info(void) {
     print_string("Kernel Heap Info:\n");
-    print_string("  - Start: 0x");
+    print_string("  - Start: ");
     print_hex(kernel_heap.start_addr);
-    print_string("\n  - End: 0x");
+    print_string("\n  - End: ");
     print_hex(kernel_heap.end_addr);
     print_string("\n  - Total size: ");
     print_hex(kernel_heap.total_size);
@@ -268,25 +1312,32 @@ void heap_dump_info(void) {
     print_string("  - Free size: ");
     print_hex(kernel_heap.total_size - kernel_heap.used_size);
     print_string(" bytes\n");
-    
-    /* Подсчитываем количество блоков */
-    uint32_t total_blocks = 0;
-    uint32_t used_blocks = 0;
-    heap_block_t *current = kernel_heap.first_block;
-    
-    while (current != NULL) {
-        total_blocks++;
-        if (current->used) {
-            used_blocks++;
-        }
-        current = current->next;
-    }
-    
+
+    print_string("  - Pools: ");
+    print_dec(kernel_heap.pool_count);
+    print_string(" (");
+    print_dec(kernel_heap.grows);
+    print_string(" taken from PMM, ");
+    print_dec(kernel_heap.shrinks);
+    print_string(" returned)\n");
+    print_string("  - Page allocations: ");
+    print_dec(page_alloc_count);
+    print_string(" (");
+    print_dec(page_alloc_pages);
+    print_string(" pages)\n");
+    print_string("  - Scrub on free: ");
+    print_string(kernel_heap.scrub ? "on\n" : "off\n");
+
+    /* Счётчики блоков ведутся при выделении и освобождении - обход не нужен */
     print_string("  - Total blocks: ");
-    print_hex(total_blocks);
+    print_hex(kernel_heap.used_blocks + kernel_heap.free_blocks);
     print_string("\n  - Used blocks: ");
-    print_hex(used_blocks);
+    print_hex(kernel_heap.used_blocks);
     print_string("\n  - Free blocks: ");
-    print_hex(total_blocks - used_blocks);
-    print_string("\n");
-} 
\ No newline at end of file
+    print_hex(kernel_heap.free_blocks);
+    print_string("\n  - Largest free block: ");
+    print_hex(heap_largest_free(&kernel_heap));
+    print_string(" bytes\n");
+
+    slab_dump_info();
+}
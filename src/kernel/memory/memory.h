@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "../multiboot.h"
 
 /* Константы памяти */
 #define PAGE_SIZE 4096
@@ -20,7 +21,34 @@
 
 /* Максимальное количество страниц (4GB / 4KB = 1M страниц) */
 #define MAX_PAGES 1048576
-#define BITMAP_SIZE (MAX_PAGES / 32)
+
+/* Уровней в битовой карте со сводками (32^4 бит покрывают 4GB страниц) */
+#define PMM_BITMAP_LEVELS 4
+
+/* Buddy-аллокатор: порядки 0..10, наибольший блок 2^10 страниц = 4MB */
+#define PMM_MAX_ORDER 10
+#define PMM_ORDERS (PMM_MAX_ORDER + 1)
+#define PMM_MAX_BLOCK_PAGES (1u << PMM_MAX_ORDER)
+
+/* Пул заранее обнулённых страниц */
+#define PMM_ZERO_POOL_TARGET 128  /* Желаемая глубина пула обнулённых страниц */
+#define PMM_DIRTY_MAX 1024        /* Сверх этого освобождённые страницы идут сразу в buddy */
+#define PMM_ZERO_BATCH 16         /* Страниц за один вызов pmm_idle_work */
+
+/* Граница зоны ISA DMA */
+#define PMM_DMA_LIMIT (16 * 1024 * 1024)
+
+/* Структур загрузчика (mbi, карта памяти, строки), которые обходят служебные данные PMM */
+#define PMM_BOOT_RANGES 16
+
+/* Узлы NUMA: у каждого свои зоны DMA (если есть) и Normal */
+#define PMM_MAX_NODES 4
+#define PMM_MAX_ZONES (PMM_MAX_NODES * PMM_ZONE_COUNT)
+#define NUMA_LOCAL_DISTANCE 10     /* Расстояние до своего узла по SLIT */
+#define NUMA_REMOTE_DISTANCE 20    /* Расстояние до чужого узла без SLIT */
+
+/* Объём памяти, предполагаемый при отсутствии информации от загрузчика */
+#define PMM_FALLBACK_MEMORY (16 * 1024 * 1024)
 
 /* Состояния страницы */
 #define PAGE_FREE 0
@@ -33,50 +61,585 @@ typedef enum {
     HEAP_LARGE    /* 513+ байт */
 } heap_type_t;
 
-/* Структура блока кучи */
+/* Параметры TLSF (two-level segregated fit) */
+#define HEAP_ALIGN_LOG2 3                  /* Выравнивание полезной части: 8 байт */
+#define HEAP_ALIGN (1u << HEAP_ALIGN_LOG2)
+#define HEAP_SL_LOG2 4                     /* 16 подклассов на каждый класс первого уровня */
+#define HEAP_SL_COUNT (1u << HEAP_SL_LOG2)
+#define HEAP_FL_SHIFT (HEAP_SL_LOG2 + HEAP_ALIGN_LOG2) /* Блоки меньше 128 байт - линейно в классе 0 */
+#define HEAP_SMALL_BLOCK (1u << HEAP_FL_SHIFT)
+#define HEAP_FL_MAX_LOG2 30                /* Наибольший блок - меньше 1GB */
+#define HEAP_FL_COUNT (HEAP_FL_MAX_LOG2 - HEAP_FL_SHIFT + 1)
+#define HEAP_MAX_BLOCK (1u << HEAP_FL_MAX_LOG2)
+
+/* Флаги в младших битах heap_block_t::size */
+#define HEAP_BLOCK_FREE 0x1                /* Блок свободен */
+#define HEAP_BLOCK_PREV_FREE 0x2           /* Предыдущий блок свободен, prev_size действителен */
+#define HEAP_BLOCK_ZERO 0x4                /* Свободный блок обнулён (кроме связей списка) */
+#define HEAP_BLOCK_FLAGS (HEAP_ALIGN - 1)
+
+/* Служебная часть блока: prev_size и size; связи списка лежат в полезной части */
+#define HEAP_BLOCK_HEADER 8
+#define HEAP_MIN_PAYLOAD 8
+
+/* Блок кучи с граничным тегом */
 typedef struct heap_block {
-    uint32_t size;           /* Размер блока */
-    uint8_t used;            /* Флаг использования */
-    struct heap_block *next; /* Следующий блок */
-    struct heap_block *prev; /* Предыдущий блок */
+    uint32_t prev_size;            /* Граничный тег: размер предыдущего блока, если он свободен */
+    uint32_t size;                 /* Размер полезной части | HEAP_BLOCK_* */
+    struct heap_block *next_free;  /* Сегрегированный список (только у свободных блоков) */
+    struct heap_block *prev_free;
 } heap_block_t;
 
-/* Структура кучи */
+/* Рост кучи ядра блоками PMM */
+#define HEAP_POOL_MIN_ORDER 6        /* Наименьший пул - 2^6 страниц (256KB) */
+#define HEAP_GRANULE_SHIFT (PAGE_SHIFT + HEAP_POOL_MIN_ORDER) /* Гранула карты владения */
+#define HEAP_POOL_FIRST 1            /* prev_size первого блока пула (не кратно HEAP_ALIGN) */
+#define HEAP_SPARE_POOLS 1           /* Пустых пулов, удерживаемых про запас в простое */
+
+/* Запросы от этого размера kmalloc отдаёт сразу PMM, минуя списки кучи */
+#define HEAP_DIRECT_THRESHOLD (64 * 1024)
+#define HEAP_PAGE_BUCKETS 64         /* Корзин хеш-таблицы страничных выделений */
+
+/* Запись о страничном выделении kmalloc_pages */
+typedef struct heap_page_alloc {
+    uint32_t addr;                   /* Адрес первой страницы */
+    uint32_t pages;                  /* Количество страниц */
+    struct heap_page_alloc *next;    /* Следующая запись в корзине */
+    uint8_t site;                    /* Место вызова (heap_prof) */
+} heap_page_alloc_t;
+
+/* Флаги пула */
+#define HEAP_POOL_RELEASABLE 0x1     /* Пул взят у PMM и возвращается ему, когда опустеет */
+
+/* Пул - непрерывная область кучи: заголовок, блоки и замыкающий блок */
+typedef struct heap_pool {
+    struct heap_pool *next;
+    uint32_t size;           /* Размер области пула в байтах */
+    uint32_t order;          /* Порядок блока PMM под пулом */
+    uint32_t flags;          /* HEAP_POOL_* */
+} heap_pool_t;
+
+/* Структура кучи: пулы памяти и управляющие структуры TLSF */
 typedef struct {
-    uint32_t start_addr;     /* Начальный адрес кучи */
-    uint32_t end_addr;       /* Конечный адрес кучи */
-    uint32_t total_size;     /* Общий размер кучи */
+    uint32_t start_addr;     /* Наименьший адрес пулов кучи */
+    uint32_t end_addr;       /* Граница за последним пулом */
+    uint32_t total_size;     /* Общий размер пулов */
     uint32_t used_size;      /* Используемый размер */
-    heap_block_t *first_block; /* Первый блок */
+    heap_pool_t *pools;      /* Список пулов */
+    uint32_t pool_count;
+    int growable;            /* Куча может расти за счёт PMM */
+    uint32_t grows;          /* Пулов взято у PMM */
+    uint32_t shrinks;        /* Пулов возвращено PMM */
+    int trim_wanted;         /* Пул освободился целиком: работа для pmm_idle_work */
+    int scrub;               /* Обнулять блоки при освобождении */
+    uint32_t free_bytes;     /* Сумма полезных размеров свободных блоков */
+    uint32_t free_blocks;    /* Свободных блоков в списках */
+    uint32_t used_blocks;    /* Занятых блоков */
+    uint32_t fl_bitmap;      /* Бит f: в классе f есть непустой подкласс */
+    uint32_t sl_bitmap[HEAP_FL_COUNT]; /* Бит s слова f: список [f][s] не пуст */
+    heap_block_t *free_lists[HEAP_FL_COUNT][HEAP_SL_COUNT];
 } heap_t;
 
+/* Slab-аллокатор */
+#define SLAB_MAGIC 0x51AB0BEC       /* Метка заголовка слаба в начале страницы */
+#define SLAB_MIN_SIZE 8             /* Наименьший объект и минимальное выравнивание */
+#define SLAB_MAX_SIZE 512           /* Наибольший размер, который kmalloc отдаёт слабам */
+#define SLAB_KMALLOC_CACHES 7       /* Кэши kmalloc: 8, 16, ..., 512 байт */
+#define SLAB_BITMAP_WORDS 16        /* Слов в битовой карте свободных объектов слаба */
+#define SLAB_MAX_OBJECTS (SLAB_BITMAP_WORDS * 32)
+#define SLAB_MAX_EMPTY 1            /* Пустых слабов, удерживаемых кэшем про запас */
+
+/* Флаги кэша */
+#define SLAB_CACHE_TAGGED 0x1       /* В конце страницы слаба - байт метки на объект (kmalloc) */
+
+struct kmem_cache;
+
+/* Заголовок слаба: лежит в начале страницы, объекты следуют за ним */
+typedef struct kmem_slab {
+    uint32_t magic;              /* SLAB_MAGIC */
+    struct kmem_cache *cache;    /* Кэш-владелец */
+    struct kmem_slab *next;      /* Соседи в списке partial/full/empty */
+    struct kmem_slab *prev;
+    uint16_t inuse;              /* Занятых объектов */
+    uint16_t free_hint;          /* Слово карты, с которого начинается поиск */
+    uint32_t free_map[SLAB_BITMAP_WORDS]; /* 1 - объект свободен */
+} kmem_slab_t;
+
+/* Кэш объектов одного размера */
+typedef struct kmem_cache {
+    const char *name;
+    uint32_t object_size;        /* Размер объекта с учётом выравнивания */
+    uint32_t first_offset;       /* Смещение первого объекта от начала слаба */
+    uint32_t objects_per_slab;
+    uint32_t flags;              /* SLAB_CACHE_* */
+    kmem_slab_t *partial;        /* Слабы со свободными и занятыми объектами */
+    kmem_slab_t *full;           /* Полностью занятые слабы */
+    kmem_slab_t *empty;          /* Пустые слабы, удерживаемые про запас */
+    uint32_t empty_slabs;
+    uint32_t slabs;              /* Всего слабов (страниц) у кэша */
+    uint32_t active_objects;     /* Выделенных объектов */
+    struct kmem_cache *next;     /* Следующий кэш в общем списке */
+} kmem_cache_t;
+
+/* Профилирование kmalloc по местам вызова */
+#define HEAP_PROF_SITES 128          /* Записей в таблице мест (степень двойки); 0 - "прочие" */
+#define HEAP_PROF_PROBES 8           /* Проб при поиске места, дальше - запись "прочие" */
+#define HEAP_PROF_CLASSES 32         /* Классов гистограммы: [2^k, 2^(k+1)) байт */
+#define HEAP_PROF_SCAN 16            /* Блоков старшего списка TLSF, просматриваемых при поиске наибольшего */
+#define HEAP_PROF_TOP 10             /* Мест, выводимых heapstat */
+
+/* Место вызова kmalloc: адрес возврата или явный тег */
+typedef struct {
+    const void *key;             /* Адрес вызова или указатель на строку тега */
+    const char *name;            /* Имя тега (NULL для адреса вызова) */
+    uint32_t live_bytes;         /* Занято сейчас */
+    uint32_t live_count;         /* Живых выделений */
+    uint32_t allocs;             /* Всего выделений */
+    uint32_t peak_bytes;         /* Наибольшее значение live_bytes */
+} heap_site_t;
+
+/* Счётчики профилирования, обновляются при каждом kmalloc/kfree */
+typedef struct {
+    heap_site_t sites[HEAP_PROF_SITES];
+    uint32_t site_count;         /* Занятых записей */
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t class_allocs[HEAP_PROF_CLASSES]; /* Выделений по log2 размера */
+    uint32_t class_live[HEAP_PROF_CLASSES];   /* Живых выделений по log2 размера */
+} heap_prof_t;
+
+/* Арена (bump-аллокатор) для короткоживущих выделений */
+#define ARENA_ALIGN 8                /* Выравнивание выделений арены */
+
+/* Заголовок чанка арены: блок PMM, чанки связаны от нового к старому */
+typedef struct arena_chunk {
+    struct arena_chunk *prev;    /* Предыдущий (более старый) чанк */
+    uint32_t order;              /* Порядок блока PMM */
+    uint32_t end;                /* Граница чанка */
+    uint32_t reserved;
+} arena_chunk_t;
+
+/* Арена; дескриптор лежит в первом чанке сразу за его заголовком */
+typedef struct {
+    uint32_t cur;                /* Следующий свободный байт текущего чанка */
+    uint32_t end;                /* Граница текущего чанка */
+    arena_chunk_t *chunk;        /* Текущий чанк */
+    uint32_t base_order;         /* Наименьший порядок чанка */
+    uint32_t used;               /* Байт выделено с момента сброса */
+    uint32_t peak;               /* Наибольшее значение used */
+} arena_t;
+
+/* Контрольная точка арены для вложенного освобождения */
+typedef struct {
+    arena_chunk_t *chunk;
+    uint32_t cur;
+    uint32_t used;
+} arena_mark_t;
+
+/* Зоны физической памяти */
+typedef enum {
+    PMM_ZONE_DMA,     /* Ниже 16MB, доступна ISA DMA */
+    PMM_ZONE_NORMAL,  /* Вся остальная память */
+    PMM_ZONE_COUNT
+} pmm_zone_type_t;
+
+/* Битовая карта со сводными уровнями для поиска установленного бита */
+typedef struct {
+    uint32_t *level[PMM_BITMAP_LEVELS]; /* level[0] - биты, выше - "слово ниже не пусто" */
+    uint32_t words[PMM_BITMAP_LEVELS];  /* Размер каждого уровня в словах */
+    uint32_t levels;                    /* Фактическое число уровней */
+    uint32_t cursor;                    /* Бит, с которого начинается поиск (next-fit) */
+} pmm_bitmap_t;
+
+/* Зона buddy-аллокатора */
+typedef struct {
+    const char *name;
+    pmm_zone_type_t type;
+    uint32_t node;        /* Узел NUMA */
+    uint32_t base_pfn;    /* Первая страница зоны, выровненная на PMM_MAX_BLOCK_PAGES */
+    uint32_t start_pfn;   /* Первая страница зоны (до неё - соседняя зона) */
+    uint32_t end_pfn;     /* Страница за последней страницей зоны */
+    uint32_t free_pages;  /* Свободных страниц в зоне */
+    uint32_t order_mask;  /* Бит k установлен, если есть свободный блок порядка k */
+    uint32_t free_blocks[PMM_ORDERS];   /* Число свободных блоков каждого порядка */
+    pmm_bitmap_t free_map[PMM_ORDERS];  /* Бит i порядка k: свободен блок [i*2^k, (i+1)*2^k) */
+} pmm_zone_t;
+
+/* Конвейер фонового обнуления: освобождённые страницы -> обнулённый пул */
+typedef struct {
+    uint32_t dirty_head;     /* Освобождённые, ещё не обнулённые страницы */
+    uint32_t dirty_count;
+    uint32_t zero_head;      /* Обнулённые страницы для pmm_alloc_page_zeroed */
+    uint32_t zero_count;
+    uint32_t hits;           /* pmm_alloc_page_zeroed обслужен из пула */
+    uint32_t misses;         /* Пул был пуст, страница обнулена на месте */
+    uint32_t zeroed;         /* Всего страниц обнулено в простое */
+    int use_movnti;          /* Обнулять невременными записями (SSE2 MOVNTI) */
+} pmm_zero_pool_t;
+
+/* Узел NUMA: непрерывный диапазон памяти с одинаковым расстоянием до процессоров */
+typedef struct {
+    uint32_t domain;                     /* Proximity domain из SRAT */
+    uint32_t start_pfn;
+    uint32_t end_pfn;
+    pmm_zone_t *zones[PMM_ZONE_COUNT];   /* Зоны узла (NULL - нет такой) */
+    uint8_t distance[PMM_MAX_NODES];     /* Расстояния до узлов по SLIT */
+    uint8_t fallback[PMM_MAX_NODES];     /* Узлы по возрастанию расстояния, первый - сам */
+    uint32_t hits;                       /* Выделено здесь, как и просили */
+    uint32_t misses;                     /* Выделено здесь вместо другого узла */
+    uint32_t foreign;                    /* Просили здесь, выделено на другом узле */
+} pmm_node_t;
+
+/* Освобождение памяти по требованию PMM (см. shrink_memory) */
+typedef uint32_t (*shrinker_scan_t)(uint32_t target);
+
+/* Источник освобождаемой памяти: кэш, пул, вытеснение */
+typedef struct shrinker {
+    const char *name;
+    uint32_t cost;           /* Цена страницы: дешёвые вызываются первыми */
+    shrinker_scan_t scan;    /* Освободить до target страниц, вернуть освобождённое */
+    uint32_t calls;          /* Вызовов scan */
+    uint32_t freed;          /* Всего освобождено страниц */
+    uint32_t kcycles;        /* Время в scan, тысяч тактов */
+    uint32_t cycles;         /* и остаток (< 1000) */
+    struct shrinker *next;   /* Следующий по возрастанию cost */
+} shrinker_t;
+
+/* Цены встроенных источников */
+#define SHRINKER_COST_SLAB 2     /* Пустые слабы про запас */
+#define SHRINKER_COST_HEAP 2     /* Пустые пулы кучи */
+#define SHRINKER_COST_ZRAM 16    /* Сжатие анонимных страниц */
+
+/* Флаги страничного кадра (page_t::flags) */
+#define PG_RESERVED 0x0001       /* Не выделяется: BIOS, ядро, дыры карты памяти */
+#define PG_SLAB 0x0002           /* Страница slab-кэша */
+#define PG_PAGECACHE 0x0004      /* Принадлежит страничному кэшу */
+#define PG_DIRTY 0x0008          /* Изменена и ещё не записана на носитель */
+#define PG_LOCKED 0x0010         /* Занята вводом-выводом, не вытесняется */
+#define PG_HEAP 0x0020           /* Пул или страничное выделение кучи ядра */
+#define PG_PAGETABLE 0x0040      /* Каталог или таблица страниц */
+#define PG_VMALLOC 0x0080        /* Отображена в область vmalloc */
+#define PG_TYPE_MASK (PG_RESERVED | PG_SLAB | PG_PAGECACHE | PG_HEAP | PG_PAGETABLE | PG_VMALLOC)
+
+/* Граница массива дескрипторов: строка кэша */
+#define PAGE_DESC_ALIGN 64
+
+/* Дескриптор физической страницы: 16 байт, четыре в строке кэша */
+typedef struct page {
+    uint16_t flags;          /* PG_* */
+    uint8_t order;           /* Порядок блока, если страница - его первая */
+    uint8_t unused;
+    uint32_t refcount;       /* Число владельцев, 0 - страница свободна */
+    struct page *next;       /* Связь в списках владельца */
+    struct page *prev;
+} page_t;
+
 /* Структура менеджера физической памяти */
 typedef struct {
-    uint32_t bitmap[BITMAP_SIZE]; /* Битовое поле для отслеживания страниц */
-    uint32_t total_pages;         /* Общее количество страниц */
+    uint32_t *bitmap;             /* Битовое поле (1 - страница занята), размещается после ядра */
+    uint32_t bitmap_words;        /* Размер битовой карты в 32-битных словах */
+    uint32_t *pool_bitmap;        /* 1 - страница лежит в списке конвейера обнуления */
+    page_t *pages;                /* База страничных кадров: дескриптор на каждую страницу */
+    pmm_zone_t zones[PMM_MAX_ZONES]; /* Buddy-зоны узлов по возрастанию адреса */
+    uint32_t zone_count;
+    pmm_node_t nodes[PMM_MAX_NODES];  /* Узлы NUMA по возрастанию адреса */
+    uint32_t node_count;
+    uint32_t local_node;          /* Узел процессора, на котором работает ядро */
+    pmm_zero_pool_t zero_pool;    /* Фоновое обнуление освобождённых страниц */
+    uint32_t total_pages;         /* Страниц до верхней границы доступной памяти */
     uint32_t free_pages;          /* Количество свободных страниц */
     uint32_t kernel_end;          /* Конец ядра в памяти */
+    uint32_t reserved_end;        /* Конец ядра, модулей и служебных данных PMM */
+    uint32_t usable_memory;       /* Объём доступной памяти по карте загрузчика (KB) */
+    shrinker_t *shrinkers;        /* Источники освобождаемой памяти по возрастанию цены */
+    int reclaiming;               /* Идёт shrink_memory (защита от рекурсии через PMM) */
+    int reclaim_wanted;           /* Ниже PMM_LOW_WATERMARK: работа для фонового вытеснения */
+    uint32_t direct_reclaims;     /* Освобождений в пути выделения */
+    uint32_t background_reclaims; /* Освобождений в простое */
+    uint32_t alloc_failures;      /* Выделений, не обслуженных и после освобождения */
 } pmm_t;
 
+/* Виртуальная память: физическая память отображается 1:1 до VMM_IDENTITY_LIMIT */
+#define VMM_IDENTITY_LIMIT 0x80000000  /* Память выше 2GB PMM не использует */
+#define MM_USER_BASE 0x80000000        /* Пользовательская часть адресного пространства */
+#define MM_USER_END 0xC0000000
+#define VMM_VIRT_BASE 0xC0000000       /* Окно отображений ядра (не 1:1) */
+#define VMM_VIRT_END 0xF0000000        /* Выше - MMIO (APIC и т.п.), отображается 1:1 по запросу */
+
+#define VMM_LARGE_PAGE_SIZE 0x400000   /* Страница PSE: 4MB */
+#define VMM_LARGE_PAGE_SHIFT 22
+#define VMM_ENTRIES 1024               /* Записей в каталоге и в таблице страниц */
+
+/* Флаги записей каталога и таблиц страниц */
+#define VMM_PRESENT 0x001
+#define VMM_WRITE 0x002
+#define VMM_USER 0x004
+#define VMM_NOCACHE 0x010
+#define VMM_ACCESSED 0x020
+#define VMM_DIRTY 0x040
+#define VMM_LARGE 0x080                /* PS: запись каталога - страница 4MB */
+#define VMM_GLOBAL 0x100               /* G: не сбрасывается при смене CR3 */
+#define VMM_COW 0x200                  /* Бит AVL: копировать страницу при записи */
+#define VMM_SWAP 0x400                 /* Бит AVL отсутствующей записи: биты 12-31 - слот zram */
+#define VMM_FLAGS_MASK 0xFFF
+
+/* Сверх этого числа отложенных invlpg сбрасывается весь TLB */
+#define VMM_FLUSH_BATCH 32
+
+/* Флаги областей окна ядра (vm_reserve) */
+#define VM_WRITE 0x1                   /* Запись разрешена */
+#define VM_DEMAND 0x2                  /* Страницы выделяются при первом обращении */
+#define VM_FAULT_AROUND 0x4            /* Ошибка заполняет соседние страницы блока */
+#define VM_VMALLOC 0x8                 /* Область vmalloc: страницы принадлежат ей */
+#define VM_LAZY_FREE 0x10              /* Освобождена vfree, ждёт сброса TLB */
+
+/* Страниц в блоке fault-around (степень двойки) */
+#define VM_FAULT_AROUND_PAGES 8
+
+/* Страниц в ожидающих сброса областях vfree, после которых он выполняется */
+#define VMALLOC_LAZY_MAX (32 * 1024 * 1024 / PAGE_SIZE)
+
+/* Область виртуального окна ядра [start, end) */
+typedef struct vm_area {
+    uint32_t start;
+    uint32_t end;
+    uint32_t flags;                /* VM_* */
+    uint32_t resident;             /* Страниц с выделенной памятью */
+    struct vm_area *next;          /* Следующая область по возрастанию адреса */
+} vm_area_t;
+
+/* Запас свободных страниц: ниже MIN освобождение идёт прямо в выделении,
+ * ниже LOW будится фоновое, которое работает до HIGH */
+#define PMM_MIN_WATERMARK 32
+#define PMM_LOW_WATERMARK 64
+#define PMM_HIGH_WATERMARK 256
+#define PMM_RECLAIM_BATCH 32             /* Страниц за один проход освобождения */
+#define PMM_RECLAIM_RETRIES 4            /* Попыток освобождения перед отказом в выделении */
+#define MM_RECLAIM_SCAN 4096             /* Записей таблиц, просматриваемых за проход */
+
+/* Сжатый своп в памяти (zram) */
+#define ZRAM_CLASS_SIZE 64               /* Шаг классов размеров хранилища */
+#define ZRAM_CLASSES 31                  /* Классы 64..1984 байт: два объекта на страницу слаба */
+#define ZRAM_MAX_STORED (ZRAM_CLASSES * ZRAM_CLASS_SIZE) /* Хуже сжатые страницы не вытесняются */
+#define ZRAM_MAX_SLOTS (1u << 18)        /* Слотов в таблице (страницы отображаются по мере роста) */
+
+/* Слот zram: сжатая страница или слово заполнения */
+typedef struct {
+    uint8_t *data;                 /* Сжатые данные, NULL - страница из одного слова */
+    uint32_t value;                /* Слово заполнения; у свободного слота - следующий свободный */
+    uint16_t size;                 /* Размер сжатых данных */
+    uint16_t refs;                 /* Записей таблиц, ссылающихся на слот; 0 - свободен */
+} zram_slot_t;
+
+/* Состояние zram */
+typedef struct {
+    zram_slot_t *slots;            /* Таблица слотов; NULL - zram не инициализирован */
+    uint32_t slot_top;             /* Слотов, когда-либо выданных */
+    uint32_t table_pages;          /* Отображённых страниц таблицы слотов */
+    uint32_t free_slot;            /* Свободный слот + 1 (0 - список пуст) */
+    kmem_cache_t *classes[ZRAM_CLASSES];
+    uint32_t stored;               /* Занятых слотов */
+    uint32_t same_filled;          /* Из них - страницы из одного слова */
+    uint32_t compressed_bytes;     /* Объём сжатых данных */
+    uint32_t stores;               /* Страниц вытеснено всего */
+    uint32_t loads;                /* Страниц возвращено по ошибке страницы */
+    uint32_t incompressible;       /* Отказов: страница сжимается хуже ZRAM_MAX_STORED */
+} zram_t;
+
+/* Адресное пространство процесса */
+typedef struct mm {
+    uint32_t *directory;           /* Каталог: записи ядра общие, MM_USER_BASE..MM_USER_END свои */
+    uint32_t id;                   /* Номер процесса (результат fork) */
+    uint32_t pages;                /* Отображённых пользовательских страниц */
+    uint32_t tables;               /* Таблиц пользовательской части */
+    uint32_t swapped;              /* Страниц, вытесненных в zram */
+    struct mm *parent;             /* Создавшее fork пространство (NULL - нет или уничтожено) */
+    struct mm *next;               /* Список всех адресных пространств */
+} mm_t;
+
+/* Состояние менеджера виртуальной памяти */
+typedef struct {
+    uint32_t *directory;           /* Каталог страниц ядра (адрес физический = виртуальный) */
+    uint32_t identity_end;         /* Конец отображения 1:1 физической памяти */
+    int pse;                       /* Страницы 4MB доступны */
+    int pge;                       /* Глобальные страницы доступны */
+    uint32_t large_pages;          /* Записей каталога со страницами 4MB */
+    uint32_t tables;               /* Таблиц страниц 4KB */
+    uint32_t splits;               /* Страниц 4MB, разбитых на таблицы */
+    uint32_t batch_depth;          /* Вложенность vmm_batch_begin */
+    uint32_t pending[VMM_FLUSH_BATCH]; /* Страницы, ждущие invlpg */
+    uint32_t pending_count;
+    int pending_all;               /* Переполнение: нужен полный сброс TLB */
+    uint32_t invlpgs;              /* Выполнено invlpg */
+    uint32_t full_flushes;         /* Полных сбросов TLB */
+    vm_area_t *areas;              /* Области окна VMM_VIRT_BASE..VMM_VIRT_END */
+    uint32_t zero_page;            /* Общая обнулённая страница для чтения до записи */
+    uint32_t faults;               /* Обработано ошибок страниц */
+    uint32_t zero_maps;            /* Отображений нулевой страницы */
+    uint32_t populated;            /* Страниц выделено по требованию */
+    uint32_t fault_around;         /* Из них - соседних, в блоке fault-around */
+    uint32_t vmalloc_pages;        /* Страниц в живых областях vmalloc */
+    uint32_t lazy_pages;           /* Страниц освобождённых областей до сброса TLB */
+    uint32_t purges;               /* Сбросов списка ленивого освобождения */
+    mm_t *mms;                     /* Адресные пространства: получают новые записи каталога ядра */
+    mm_t *current_mm;              /* Загруженное в CR3 (NULL - каталог ядра) */
+    uint32_t next_mm_id;
+    uint32_t cow_faults;           /* Ошибок записи в страницы COW */
+    uint32_t cow_copies;           /* Из них - с копированием страницы */
+    uint32_t cow_reuses;           /* Из них - последняя ссылка, страница взята без копии */
+    mm_t *clock_mm;                /* Стрелка часов вытеснения: адресное пространство */
+    uint32_t clock_addr;           /* и адрес в нём */
+} vmm_t;
+
 /* Глобальные переменные */
 extern pmm_t physical_memory_manager;
+extern vmm_t kernel_vmm;
+extern zram_t zram;
 extern heap_t kernel_heap;
+extern heap_prof_t heap_prof;
 
 /* Функции Physical Memory Manager */
-void pmm_init(uint32_t kernel_end);
+void pmm_init(uint32_t kernel_end, const multiboot_info_t *mbi);
 uint32_t pmm_alloc_page(void);
 void pmm_free_page(uint32_t page_addr);
+uint32_t pmm_alloc_pages(uint32_t order);
+uint32_t pmm_alloc_pages_zone(uint32_t order, pmm_zone_type_t zone);
+void pmm_free_pages(uint32_t addr, uint32_t order);
+uint32_t pmm_alloc_pages_exact(uint32_t count);
+void pmm_free_pages_exact(uint32_t addr, uint32_t count);
+uint32_t pmm_alloc_page_zeroed(void);
+int pmm_idle_work(void);
 uint32_t pmm_get_free_pages_count(void);
 void pmm_mark_page_used(uint32_t page_addr);
 void pmm_mark_page_free(uint32_t page_addr);
+void pmm_mark_region_used(uint32_t addr, uint32_t size);
+void pmm_mark_region_free(uint32_t addr, uint32_t size);
 void pmm_dump_info(void);
+page_t* phys_to_page(uint32_t addr);
+uint32_t page_to_phys(const page_t *page);
+void page_get(uint32_t addr);
+void page_put(uint32_t addr);
+void pmm_set_page_flags(uint32_t addr, uint32_t count, uint32_t flags);
+uint32_t pmm_alloc_pages_node(uint32_t order, uint32_t node);
+int32_t pmm_page_node(uint32_t addr);
+
+/* Топология NUMA (ACPI SRAT/SLIT) */
+void numa_init(uint32_t total_pages);
+void numa_dump_info(void);
+
+/* Освобождение памяти под давлением */
+void shrinker_register(shrinker_t *shrinker);
+uint32_t shrink_memory(uint32_t target);
+int shrink_background(void);
+void shrinker_dump_info(void);
 
 /* Функции Kernel Heap */
-void heap_init(uint32_t start_addr, uint32_t size);
+void heap_init(uint32_t initial_size);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 void* krealloc(void* ptr, size_t size);
+void* kzalloc(size_t size);
+void* kmalloc_aligned(size_t size, size_t align);
+void* kmalloc_pages(uint32_t count);
+void* kmalloc_tagged(size_t size, const char *tag);
+void* kcalloc(size_t count, size_t size);
+void heap_set_scrub(int enabled);
 void heap_dump_info(void);
+void heap_create(heap_t *heap, uint32_t start_addr, uint32_t size);
+void* heap_alloc(heap_t *heap, size_t size);
+void* heap_zalloc(heap_t *heap, size_t size);
+void* heap_alloc_aligned(heap_t *heap, size_t size, size_t align);
+uint32_t heap_largest_free(const heap_t *heap);
+int heap_check(const heap_t *heap);
+void heap_free(heap_t *heap, void *ptr);
+uint32_t heap_trim(heap_t *heap, uint32_t keep);
+void* heap_realloc(heap_t *heap, void *ptr, size_t size);
+
+/* Функции slab-аллокатора */
+void slab_init(void);
+kmem_cache_t* kmem_cache_create(const char *name, uint32_t size, uint32_t align);
+int kmem_cache_destroy(kmem_cache_t *cache);
+uint32_t kmem_cache_shrink(kmem_cache_t *cache);
+void* kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+void* slab_kmalloc(size_t size);
+int slab_kfree(void *ptr);
+uint32_t slab_object_size(const void *ptr);
+uint8_t* slab_object_tag(const void *ptr);
+void slab_dump_info(void);
+
+/* Профилирование kmalloc */
+uint8_t heap_prof_site(const void *key, const char *name);
+void heap_prof_alloc(uint8_t site, uint32_t size);
+void heap_prof_free(uint8_t site, uint32_t size);
+uint32_t heap_fragmentation(const heap_t *heap);
+void heap_prof_dump(uint32_t top);
+
+/* Функции арены */
+arena_t* arena_create(uint32_t order);
+void* arena_alloc(arena_t *arena, size_t size);
+arena_mark_t arena_save(const arena_t *arena);
+void arena_restore(arena_t *arena, arena_mark_t mark);
+void arena_reset(arena_t *arena);
+void arena_destroy(arena_t *arena);
+
+/* Функции Virtual Memory Manager */
+void vmm_init(void);
+int map_page(uint32_t virt, uint32_t phys, uint32_t flags);
+void unmap_page(uint32_t virt);
+void unmap_page_noflush(uint32_t virt);
+uint32_t virt_to_phys(uint32_t virt);
+int vmm_identity_map(uint32_t addr, uint32_t size, uint32_t flags);
+void vmm_batch_begin(void);
+void vmm_batch_end(void);
+void vmm_flush_all(void);
+void vmm_dump_info(void);
+void* vm_reserve(size_t size, uint32_t flags);
+void vm_release(void *addr);
+vm_area_t* vm_find_area(uint32_t addr);
+int vmm_handle_fault(uint32_t addr, uint32_t error);
+void* vmalloc(size_t size);
+void* vzalloc(size_t size);
+void vfree(void *addr);
+void vmalloc_purge(void);
+mm_t* mm_create(void);
+mm_t* mm_fork(mm_t *parent);
+void mm_destroy(mm_t *mm);
+void mm_exit(mm_t *mm);
+void mm_switch(mm_t *mm);
+mm_t* mm_current(void);
+int mm_map_anon(mm_t *mm, uint32_t addr, uint32_t size);
+int mm_handle_fault(uint32_t addr, uint32_t error);
+uint32_t mm_reclaim(uint32_t target);
+void zram_init(void);
+int32_t zram_store(uint32_t page);
+int zram_load(uint32_t slot, uint32_t page);
+void zram_slot_get(uint32_t slot);
+void zram_slot_put(uint32_t slot);
+void zram_dump_info(void);
+
+/* Возможности процессора для операций с памятью (memory_get_features) */
+#define MEMORY_FEATURE_ERMS 0x1      /* Быстрые REP MOVSB/STOSB */
+#define MEMORY_FEATURE_SSE2 0x2      /* SSE2 с разрешёнными XMM (CR4.OSFXSR) */
+
+/* Операции короче этого - простым побайтовым циклом */
+#define MEMORY_SMALL 32
+/* До этого размера - циклом по словам: запуск REP обходится дороже */
+#define MEMORY_REP_MIN 256
+
+/* Слово, через которое разрешено читать память любого типа */
+typedef uint32_t __attribute__((may_alias)) memory_word_t;
+
+/* Байт, размноженный на все четыре байта слова */
+#define MEMORY_SPLAT(b) ((uint32_t)(b) * 0x01010101u)
+/* Ненулевое значение, если в слове есть нулевой байт */
+#define MEMORY_HAS_ZERO(v) (((v) - 0x01010101u) & ~(v) & 0x80808080u)
+/* Блоки от этого размера пишутся невременными SSE2-записями мимо кэша */
+#define MEMORY_NT_THRESHOLD (256 * 1024)
+/* Наибольшая порция SSE2 за одну секцию kernel_fpu_begin/end (прерывания запрещены) */
+#define MEMORY_FPU_CHUNK (64 * 1024)
 
 /* Вспомогательные функции */
 uint32_t align_up(uint32_t addr, uint32_t align);
@@ -85,6 +648,8 @@ void memory_set(void* dest, uint8_t val, size_t count);
 void memory_copy(void* dest, const void* src, size_t count);
 int memory_compare(const void* ptr1, const void* ptr2, size_t count);
 void* memory_find(const void* ptr, uint8_t value, size_t count);
+void memory_primitives_init(void);
+uint32_t memory_get_features(void);
 int is_aligned(uint32_t addr, uint32_t align);
 uint32_t get_page_size(void);
 uint32_t get_page_number(uint32_t addr);
@@ -93,6 +658,15 @@ uint32_t get_page_start(uint32_t addr);
 uint32_t get_page_end(uint32_t addr);
 
 /* Тестовые функции */
-void run_memory_tests(void);
+void pmm_benchmark(void);
+void heap_benchmark(void);
+void memory_benchmark(void);
+void memory_primitives_benchmark(void);
+void tlb_benchmark(void);
+void fault_benchmark(void);
+void vmalloc_benchmark(void);
+void fork_benchmark(void);
+void zram_benchmark(void);
+void numa_benchmark(void);
 
 #endif /* MEMORY_H */ 
\ No newline at end of file
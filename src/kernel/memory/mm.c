@@ -0,0 +1,455 @@
+/**
+ * @file mm.c
+ * @brief Адресные пространства процессов и копирование при записи
+ *
+ * У каждого адресного пространства свой каталог страниц: записи ядра
+ * (отображение 1:1, окно ядра, MMIO) копируются из каталога ядра и
+ * общие для всех, а пользовательская часть MM_USER_BASE..MM_USER_END
+ * своя. mm_fork не копирует данные: все страницы родителя становятся
+ * общими, только для чтения и с пометкой VMM_COW, а счётчик владельцев
+ * в page_t растёт. Первая запись в такую страницу копирует её; если же
+ * ссылка на страницу осталась последней, она просто снова становится
+ * доступной для записи. Стоимость fork определяется числом таблиц
+ * страниц, стоимость дальнейшей работы - числом записанных страниц.
+ *
+ * При нехватке памяти mm_reclaim обходит пользовательские страницы
+ * всех адресных пространств по кругу (алгоритм часов): страница с
+ * битом Accessed получает второй шанс, остальные частные страницы
+ * уходят в zram, а запись таблицы хранит номер слота (VMM_SWAP).
+ */
+
+#include "memory.h"
+#include "../cpu/cpu.h"
+#include "../idt/exceptions.h"
+
+/* Индексы каталога пользовательской части */
+#define MM_USER_FIRST_PDE (MM_USER_BASE >> VMM_LARGE_PAGE_SHIFT)
+#define MM_USER_END_PDE (MM_USER_END >> VMM_LARGE_PAGE_SHIFT)
+
+/* Флаги записи каталога пользовательской таблицы */
+#define MM_TABLE_FLAGS (VMM_PRESENT | VMM_WRITE | VMM_USER)
+
+/* Флаги, которые запись вытесненной страницы сохраняет до возврата */
+#define MM_SWAP_FLAGS (VMM_WRITE | VMM_USER | VMM_COW)
+
+/* Кэш дескрипторов адресных пространств */
+static kmem_cache_t *mm_cache = NULL;
+
+/**
+ * @brief Выделение обнулённой страницы под каталог или таблицу
+ */
+static uint32_t* mm_alloc_table(void) {
+    uint32_t page = pmm_alloc_page_zeroed();
+    if (!page) {
+        return NULL;
+    }
+    pmm_set_page_flags(page, 1, PG_PAGETABLE);
+    return (uint32_t*)page;
+}
+
+/**
+ * @brief Запись таблицы страниц для пользовательского адреса
+ * @param create Создать таблицу, если её нет
+ * @return Указатель на запись или NULL
+ */
+static uint32_t* mm_pte(mm_t *mm, uint32_t virt, int create) {
+    uint32_t *pde = &mm->directory[virt >> VMM_LARGE_PAGE_SHIFT];
+
+    if (!(*pde & VMM_PRESENT)) {
+        if (!create) {
+            return NULL;
+        }
+        uint32_t *table = mm_alloc_table();
+        if (!table) {
+            return NULL;
+        }
+        *pde = (uint32_t)table | MM_TABLE_FLAGS;
+        mm->tables++;
+    }
+
+    uint32_t *table = (uint32_t*)(*pde & PAGE_MASK);
+    return &table[(virt >> PAGE_SHIFT) & (VMM_ENTRIES - 1)];
+}
+
+/**
+ * @brief Сброс TLB для пользовательской страницы, если пространство загружено
+ */
+static void mm_flush_page(mm_t *mm, uint32_t virt) {
+    if (mm == kernel_vmm.current_mm) {
+        invlpg(virt);
+        kernel_vmm.invlpgs++;
+    }
+}
+
+/**
+ * @brief Создание пустого адресного пространства
+ * @return Адресное пространство без пользовательских страниц или NULL
+ */
+mm_t* mm_create(void) {
+    if (!mm_cache) {
+        mm_cache = kmem_cache_create("mm", sizeof(mm_t), SLAB_MIN_SIZE);
+        if (!mm_cache) {
+            return NULL;
+        }
+    }
+
+    mm_t *mm = kmem_cache_alloc(mm_cache);
+    if (!mm) {
+        return NULL;
+    }
+    mm->directory = mm_alloc_table();
+    if (!mm->directory) {
+        kmem_cache_free(mm_cache, mm);
+        return NULL;
+    }
+
+    /* Записи ядра общие; пользовательская часть пуста */
+    for (uint32_t i = 0; i < VMM_ENTRIES; i++) {
+        if (i < MM_USER_FIRST_PDE || i >= MM_USER_END_PDE) {
+            mm->directory[i] = kernel_vmm.directory[i];
+        }
+    }
+
+    mm->id = ++kernel_vmm.next_mm_id;
+    mm->pages = 0;
+    mm->tables = 0;
+    mm->swapped = 0;
+    mm->parent = NULL;
+    mm->next = kernel_vmm.mms;
+    kernel_vmm.mms = mm;
+    return mm;
+}
+
+/**
+ * @brief Уничтожение адресного пространства
+ *
+ * Каждая пользовательская страница теряет одного владельца; общие с
+ * другими пространствами страницы остаются им.
+ * @param mm Адресное пространство (не загруженное в CR3)
+ */
+void mm_destroy(mm_t *mm) {
+    if (!mm || mm == kernel_vmm.current_mm) {
+        return;
+    }
+
+    for (uint32_t i = MM_USER_FIRST_PDE; i < MM_USER_END_PDE; i++) {
+        if (!(mm->directory[i] & VMM_PRESENT)) {
+            continue;
+        }
+        uint32_t *table = (uint32_t*)(mm->directory[i] & PAGE_MASK);
+        for (uint32_t j = 0; j < VMM_ENTRIES; j++) {
+            if (table[j] & VMM_PRESENT) {
+                page_put(table[j] & PAGE_MASK);
+            } else if (table[j] & VMM_SWAP) {
+                zram_slot_put(table[j] >> PAGE_SHIFT);
+            }
+        }
+        pmm_free_page((uint32_t)table);
+    }
+    pmm_free_page((uint32_t)mm->directory);
+
+    /* Потомки остаются сиротами: их уничтожит тот, кто их держит */
+    for (mm_t *other = kernel_vmm.mms; other; other = other->next) {
+        if (other->parent == mm) {
+            other->parent = NULL;
+        }
+    }
+
+    mm_t **link = &kernel_vmm.mms;
+    while (*link && *link != mm) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = mm->next;
+    }
+    if (kernel_vmm.clock_mm == mm) {
+        kernel_vmm.clock_mm = NULL;
+    }
+    kmem_cache_free(mm_cache, mm);
+}
+
+/**
+ * @brief Завершение процесса
+ *
+ * Планировщика нет, поэтому потомки fork ни разу не запускались и никто,
+ * кроме родителя, их не уничтожит: они уходят вместе с ним, а общие с
+ * ними страницы снова принадлежат одному владельцу. Загруженное
+ * пространство перед уничтожением сменяется каталогом ядра.
+ * @param mm Завершающееся адресное пространство (NULL - ничего)
+ */
+void mm_exit(mm_t *mm) {
+    if (!mm) {
+        return;
+    }
+
+    mm_t *child = kernel_vmm.mms;
+    while (child) {
+        mm_t *next = child->next;
+        if (child->parent == mm) {
+            mm_destroy(child);
+        }
+        child = next;
+    }
+
+    if (mm == kernel_vmm.current_mm) {
+        mm_switch(NULL);
+    }
+    mm_destroy(mm);
+}
+
+/**
+ * @brief Загрузка адресного пространства в CR3
+ * @param mm Адресное пространство или NULL для каталога ядра
+ */
+void mm_switch(mm_t *mm) {
+    kernel_vmm.current_mm = mm;
+    write_cr3((uint32_t)(mm ? mm->directory : kernel_vmm.directory));
+}
+
+/**
+ * @brief Загруженное адресное пространство
+ * @return Адресное пространство или NULL, если загружен каталог ядра
+ */
+mm_t* mm_current(void) {
+    return kernel_vmm.current_mm;
+}
+
+/**
+ * @brief Отображение обнулённых анонимных страниц
+ * @param addr Начало (внутри MM_USER_BASE..MM_USER_END)
+ * @param size Размер в байтах (округляется до страницы)
+ * @return 0 при успехе, -1 при ошибке (уже отображённые страницы остаются)
+ */
+int mm_map_anon(mm_t *mm, uint32_t addr, uint32_t size) {
+    addr = align_down(addr, PAGE_SIZE);
+    size = align_up(size, PAGE_SIZE);
+    if (addr < MM_USER_BASE || addr >= MM_USER_END || size > MM_USER_END - addr) {
+        return -1;
+    }
+
+    for (uint32_t virt = addr; virt < addr + size; virt += PAGE_SIZE) {
+        uint32_t *pte = mm_pte(mm, virt, 1);
+        if (!pte) {
+            return -1;
+        }
+        if (*pte & VMM_PRESENT) {
+            continue;
+        }
+        uint32_t page = pmm_alloc_page_zeroed();
+        if (!page) {
+            return -1;
+        }
+        *pte = page | VMM_PRESENT | VMM_WRITE | VMM_USER;
+        mm->pages++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Копия адресного пространства с общими страницами
+ *
+ * Таблицы пользовательской части копируются, страницы - нет: у родителя
+ * и потомка они становятся доступными только для чтения с VMM_COW.
+ * Слоты zram вытесненных страниц становятся общими: каждый, кто
+ * обратится к странице, получит собственную распакованную копию.
+ * @param parent Родительское адресное пространство
+ * @return Новое адресное пространство или NULL
+ */
+mm_t* mm_fork(mm_t *parent) {
+    if (!parent) {
+        return NULL;
+    }
+
+    mm_t *child = mm_create();
+    if (!child) {
+        return NULL;
+    }
+    child->parent = parent;
+
+    for (uint32_t i = MM_USER_FIRST_PDE; i < MM_USER_END_PDE; i++) {
+        if (!(parent->directory[i] & VMM_PRESENT)) {
+            continue;
+        }
+        uint32_t *table = mm_alloc_table();
+        if (!table) {
+            mm_destroy(child);
+            return NULL;
+        }
+        child->directory[i] = (uint32_t)table | MM_TABLE_FLAGS;
+        child->tables++;
+
+        uint32_t *source = (uint32_t*)(parent->directory[i] & PAGE_MASK);
+        for (uint32_t j = 0; j < VMM_ENTRIES; j++) {
+            uint32_t pte = source[j];
+            if (!(pte & VMM_PRESENT)) {
+                if (pte & VMM_SWAP) {
+                    zram_slot_get(pte >> PAGE_SHIFT);
+                    table[j] = pte;
+                    child->swapped++;
+                }
+                continue;
+            }
+            if (pte & VMM_WRITE) {
+                pte = (pte & ~VMM_WRITE) | VMM_COW;
+                source[j] = pte;
+            }
+            table[j] = pte;
+            page_get(pte & PAGE_MASK);
+            child->pages++;
+        }
+    }
+
+    /* Пользовательские записи не глобальные: перезагрузки CR3 достаточно */
+    if (parent == kernel_vmm.current_mm) {
+        write_cr3(read_cr3());
+        kernel_vmm.full_flushes++;
+    }
+    return child;
+}
+
+/**
+ * @brief Возврат вытесненной страницы из zram
+ *
+ * Отсутствующая запись в TLB не попадает, сбрасывать нечего.
+ * @return 0 при успехе, -1 если нет памяти или слот повреждён
+ */
+static int mm_swap_in(mm_t *mm, uint32_t *pte) {
+    uint32_t slot = *pte >> PAGE_SHIFT;
+    uint32_t page = pmm_alloc_page();
+    if (!page) {
+        return -1;
+    }
+    if (zram_load(slot, page) != 0) {
+        pmm_free_page(page);
+        return -1;
+    }
+
+    /* Вытеснение внутри pmm_alloc_page не трогает отсутствующие записи */
+    *pte = page | (*pte & MM_SWAP_FLAGS) | VMM_PRESENT;
+    zram_slot_put(slot);
+    mm->swapped--;
+    mm->pages++;
+    return 0;
+}
+
+/**
+ * @brief Вытеснение анонимных страниц в zram
+ *
+ * Стрелка часов проходит пользовательские записи всех адресных
+ * пространств. Бит Accessed сбрасывается (второй шанс), страница без
+ * него сжимается в zram и освобождается. Общие (COW) и заблокированные
+ * страницы пропускаются.
+ * @param target Сколько страниц освободить
+ * @return Освобождено страниц
+ */
+uint32_t mm_reclaim(uint32_t target) {
+    if (!kernel_vmm.mms || !zram.slots) {
+        return 0;
+    }
+
+    mm_t *mm = kernel_vmm.clock_mm;
+    uint32_t addr = kernel_vmm.clock_addr;
+    if (!mm) {
+        mm = kernel_vmm.mms;
+        addr = MM_USER_BASE;
+    }
+
+    uint32_t freed = 0;
+    for (uint32_t scanned = 0; freed < target && scanned < MM_RECLAIM_SCAN; scanned++) {
+        if (addr >= MM_USER_END) {
+            mm = mm->next ? mm->next : kernel_vmm.mms;
+            addr = MM_USER_BASE;
+        }
+
+        uint32_t pde = mm->directory[addr >> VMM_LARGE_PAGE_SHIFT];
+        if (!(pde & VMM_PRESENT)) {
+            addr = align_down(addr, VMM_LARGE_PAGE_SIZE) + VMM_LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        uint32_t virt = addr;
+        uint32_t *pte = &((uint32_t*)(pde & PAGE_MASK))[(virt >> PAGE_SHIFT) & (VMM_ENTRIES - 1)];
+        addr += PAGE_SIZE;
+        if (!(*pte & VMM_PRESENT)) {
+            continue;
+        }
+        if (*pte & VMM_ACCESSED) {
+            *pte &= ~VMM_ACCESSED;
+            mm_flush_page(mm, virt);
+            continue;
+        }
+
+        uint32_t phys = *pte & PAGE_MASK;
+        page_t *page = phys_to_page(phys);
+        if (!page || page->refcount != 1 || (page->flags & (PG_LOCKED | PG_RESERVED))) {
+            continue;
+        }
+
+        int32_t slot = zram_store(phys);
+        if (slot < 0) {
+            continue;
+        }
+        *pte = ((uint32_t)slot << PAGE_SHIFT) | (*pte & MM_SWAP_FLAGS) | VMM_SWAP;
+        mm_flush_page(mm, virt);
+        pmm_free_page(phys);
+        mm->pages--;
+        mm->swapped++;
+        freed++;
+    }
+
+    kernel_vmm.clock_mm = mm;
+    kernel_vmm.clock_addr = addr;
+    return freed;
+}
+
+/**
+ * @brief Обработка ошибки записи в пользовательскую страницу
+ *
+ * Вытесненная страница распаковывается из zram. Страница VMM_COW с
+ * последней ссылкой снова становится доступной для записи, иначе
+ * копируется в новую страницу.
+ * @param addr Адрес ошибки (CR2)
+ * @param error Код ошибки процессора (PF_ERR_*)
+ * @return 0 если ошибка обработана, -1 если это настоящая ошибка
+ */
+int mm_handle_fault(uint32_t addr, uint32_t error) {
+    mm_t *mm = kernel_vmm.current_mm;
+    if (!mm) {
+        return -1;
+    }
+
+    uint32_t virt = addr & PAGE_MASK;
+    uint32_t *pte = mm_pte(mm, virt, 0);
+    if (!pte) {
+        return -1;
+    }
+    if (!(*pte & VMM_PRESENT) && (*pte & VMM_SWAP)) {
+        return mm_swap_in(mm, pte);
+    }
+    if ((error & (PF_ERR_PRESENT | PF_ERR_WRITE)) != (PF_ERR_PRESENT | PF_ERR_WRITE) ||
+        (*pte & (VMM_PRESENT | VMM_COW)) != (VMM_PRESENT | VMM_COW)) {
+        return -1;
+    }
+
+    kernel_vmm.cow_faults++;
+    uint32_t old = *pte & PAGE_MASK;
+    uint32_t flags = (*pte & VMM_FLAGS_MASK & ~(VMM_COW | VMM_ACCESSED | VMM_DIRTY)) | VMM_WRITE;
+
+    page_t *page = phys_to_page(old);
+    if (page && page->refcount == 1) {
+        *pte = old | flags;
+        kernel_vmm.cow_reuses++;
+    } else {
+        uint32_t copy = pmm_alloc_page();
+        if (!copy) {
+            return -1;
+        }
+        memory_copy((void*)copy, (const void*)old, PAGE_SIZE);
+        *pte = copy | flags;
+        page_put(old);
+        kernel_vmm.cow_copies++;
+    }
+
+    mm_flush_page(mm, virt);
+    return 0;
+}
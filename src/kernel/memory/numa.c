@@ -0,0 +1,266 @@
+/**
+ * @file numa.c
+ * @brief Топология NUMA из таблиц ACPI SRAT и SLIT
+ *
+ * SRAT задаёт диапазоны памяти и процессоры каждого proximity domain,
+ * SLIT - расстояния между ними. Узел - непрерывный диапазон страниц
+ * одного домена; дыры между диапазонами достаются узлу слева, так что
+ * узлы покрывают всю память без пропусков. Без SRAT (или с таблицей,
+ * которую не удалось разобрать) вся память - один узел.
+ *
+ * Каждому узлу строится список узлов по возрастанию расстояния: PMM
+ * берёт страницы с узла процессора и переходит к следующим, только
+ * когда на ближних нет свободного блока.
+ */
+
+#include "memory.h"
+#include "../video/video.h"
+#include "../cpu/cpu.h"
+#include "../drivers/acpi.h"
+
+/* Записи SRAT */
+#define SRAT_ENTRIES_OFFSET 48       /* Заголовок SDT и 12 зарезервированных байт */
+#define SRAT_CPU_AFFINITY 0
+#define SRAT_MEMORY_AFFINITY 1
+#define SRAT_X2APIC_AFFINITY 2
+#define SRAT_ENABLED 0x1
+
+/* Матрица SLIT: число доменов (8 байт) и расстояния */
+#define SLIT_LOCALITIES_OFFSET 36
+#define SLIT_MATRIX_OFFSET 44
+
+/* Источник топологии для numa_dump_info */
+static int numa_from_srat = 0;
+
+static uint32_t numa_read32(const uint8_t *ptr) {
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static uint64_t numa_read64(const uint8_t *ptr) {
+    return numa_read32(ptr) | ((uint64_t)numa_read32(ptr + 4) << 32);
+}
+
+/**
+ * @brief Узел домена, при необходимости - новый
+ * @return Индекс узла или -1, если узлов больше PMM_MAX_NODES
+ */
+static int32_t numa_node_for_domain(uint32_t domain, int create) {
+    pmm_t *pmm = &physical_memory_manager;
+    for (uint32_t i = 0; i < pmm->node_count; i++) {
+        if (pmm->nodes[i].domain == domain) {
+            return (int32_t)i;
+        }
+    }
+    if (!create || pmm->node_count == PMM_MAX_NODES) {
+        return -1;
+    }
+
+    pmm_node_t *node = &pmm->nodes[pmm->node_count];
+    memory_set(node, 0, sizeof(pmm_node_t));
+    node->domain = domain;
+    node->start_pfn = 0xFFFFFFFF;
+    return (int32_t)pmm->node_count++;
+}
+
+/**
+ * @brief Диапазоны памяти доменов из SRAT
+ * @return 1, если узлы получены и не перекрываются
+ */
+static int numa_parse_srat(const acpi_sdt_header_t *srat, uint32_t total_pages) {
+    pmm_t *pmm = &physical_memory_manager;
+    const uint8_t *entry = (const uint8_t*)srat + SRAT_ENTRIES_OFFSET;
+    const uint8_t *end = (const uint8_t*)srat + srat->length;
+
+    for (; entry + 2 <= end && entry[1] >= 2 && entry + entry[1] <= end; entry += entry[1]) {
+        if (entry[0] != SRAT_MEMORY_AFFINITY || entry[1] < 40 ||
+            !(numa_read32(entry + 28) & SRAT_ENABLED)) {
+            continue;
+        }
+
+        uint64_t base = numa_read64(entry + 8);
+        uint64_t limit = base + numa_read64(entry + 16);
+        uint64_t top = (uint64_t)total_pages << PAGE_SHIFT;
+        if (limit > top) {
+            limit = top;
+        }
+        if (base >= limit) {
+            continue;
+        }
+
+        int32_t index = numa_node_for_domain(numa_read32(entry + 2), 1);
+        if (index < 0) {
+            return 0; /* Доменов больше, чем узлов */
+        }
+        pmm_node_t *node = &pmm->nodes[index];
+        uint32_t first = (uint32_t)(base >> PAGE_SHIFT);
+        uint32_t last = (uint32_t)((limit + PAGE_SIZE - 1) >> PAGE_SHIFT);
+        if (first < node->start_pfn) {
+            node->start_pfn = first;
+        }
+        if (last > node->end_pfn) {
+            node->end_pfn = last;
+        }
+    }
+    if (pmm->node_count == 0) {
+        return 0;
+    }
+
+    /* По возрастанию адреса; перекрытие доменов - чередование, не поддерживается */
+    for (uint32_t i = 1; i < pmm->node_count; i++) {
+        pmm_node_t node = pmm->nodes[i];
+        uint32_t j = i;
+        for (; j > 0 && pmm->nodes[j - 1].start_pfn > node.start_pfn; j--) {
+            pmm->nodes[j] = pmm->nodes[j - 1];
+        }
+        pmm->nodes[j] = node;
+    }
+    for (uint32_t i = 1; i < pmm->node_count; i++) {
+        if (pmm->nodes[i].start_pfn < pmm->nodes[i - 1].end_pfn) {
+            return 0;
+        }
+    }
+
+    /* Дыры - узлу слева, первый узел начинается с нуля */
+    pmm->nodes[0].start_pfn = 0;
+    for (uint32_t i = 0; i + 1 < pmm->node_count; i++) {
+        pmm->nodes[i].end_pfn = pmm->nodes[i + 1].start_pfn;
+    }
+    pmm->nodes[pmm->node_count - 1].end_pfn = total_pages;
+    return 1;
+}
+
+/**
+ * @brief Узел загрузочного процессора по его APIC ID
+ */
+static uint32_t numa_cpu_node(const acpi_sdt_header_t *srat) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    uint32_t apic_id = ebx >> 24;
+
+    const uint8_t *entry = (const uint8_t*)srat + SRAT_ENTRIES_OFFSET;
+    const uint8_t *end = (const uint8_t*)srat + srat->length;
+    for (; entry + 2 <= end && entry[1] >= 2 && entry + entry[1] <= end; entry += entry[1]) {
+        uint32_t domain;
+        if (entry[0] == SRAT_CPU_AFFINITY && entry[1] >= 16 &&
+            (numa_read32(entry + 4) & SRAT_ENABLED) && entry[3] == apic_id) {
+            domain = entry[2] | (entry[9] << 8) | (entry[10] << 16) | ((uint32_t)entry[11] << 24);
+        } else if (entry[0] == SRAT_X2APIC_AFFINITY && entry[1] >= 24 &&
+                   (numa_read32(entry + 12) & SRAT_ENABLED) && numa_read32(entry + 8) == apic_id) {
+            domain = numa_read32(entry + 4);
+        } else {
+            continue;
+        }
+        int32_t node = numa_node_for_domain(domain, 0);
+        return node < 0 ? 0 : (uint32_t)node;
+    }
+    return 0;
+}
+
+/**
+ * @brief Расстояния между узлами из SLIT (без неё - 10 и 20)
+ */
+static void numa_parse_slit(const acpi_sdt_header_t *slit) {
+    pmm_t *pmm = &physical_memory_manager;
+    uint64_t localities = 0;
+    if (slit && slit->length >= SLIT_MATRIX_OFFSET) {
+        localities = numa_read64((const uint8_t*)slit + SLIT_LOCALITIES_OFFSET);
+        if (localities > 256 || SLIT_MATRIX_OFFSET + localities * localities > slit->length) {
+            localities = 0;
+        }
+    }
+    const uint8_t *matrix = (const uint8_t*)slit + SLIT_MATRIX_OFFSET;
+
+    for (uint32_t i = 0; i < pmm->node_count; i++) {
+        for (uint32_t j = 0; j < pmm->node_count; j++) {
+            uint32_t from = pmm->nodes[i].domain;
+            uint32_t to = pmm->nodes[j].domain;
+            uint8_t distance = i == j ? NUMA_LOCAL_DISTANCE : NUMA_REMOTE_DISTANCE;
+            if (from < localities && to < localities) {
+                distance = matrix[from * (uint32_t)localities + to];
+            }
+            pmm->nodes[i].distance[j] = distance;
+        }
+    }
+}
+
+/**
+ * @brief Построение узлов NUMA до создания зон PMM
+ *
+ * Таблицы читаются по физическим адресам - вызывается до vmm_init.
+ * @param total_pages Страниц до верхней границы памяти
+ */
+void numa_init(uint32_t total_pages) {
+    pmm_t *pmm = &physical_memory_manager;
+    const acpi_sdt_header_t *srat = acpi_find_table("SRAT");
+
+    pmm->node_count = 0;
+    pmm->local_node = 0;
+    numa_from_srat = srat && numa_parse_srat(srat, total_pages);
+    if (!numa_from_srat) {
+        pmm->node_count = 0;
+        numa_node_for_domain(0, 1);
+        pmm->nodes[0].start_pfn = 0;
+        pmm->nodes[0].end_pfn = total_pages;
+    } else {
+        pmm->local_node = numa_cpu_node(srat);
+    }
+    numa_parse_slit(numa_from_srat ? acpi_find_table("SLIT") : NULL);
+
+    /* Запасные узлы: по расстоянию, при равенстве - по адресу */
+    for (uint32_t i = 0; i < pmm->node_count; i++) {
+        pmm_node_t *node = &pmm->nodes[i];
+        for (uint32_t k = 0; k < pmm->node_count; k++) {
+            uint32_t j = k;
+            for (; j > 0 && node->distance[node->fallback[j - 1]] > node->distance[k]; j--) {
+                node->fallback[j] = node->fallback[j - 1];
+            }
+            node->fallback[j] = (uint8_t)k;
+        }
+    }
+}
+
+/**
+ * @brief Вывод узлов NUMA: границы, свободная память, счётчики выделений
+ */
+void numa_dump_info(void) {
+    pmm_t *pmm = &physical_memory_manager;
+    print_string("  - NUMA: ");
+    print_dec(pmm->node_count);
+    print_string(numa_from_srat ? " node(s) from SRAT" : " node (no SRAT)");
+    print_string(", CPU on node ");
+    print_dec(pmm->local_node);
+    print_string("\n");
+
+    for (uint32_t i = 0; i < pmm->node_count; i++) {
+        const pmm_node_t *node = &pmm->nodes[i];
+        uint32_t free = 0;
+        for (uint32_t type = 0; type < PMM_ZONE_COUNT; type++) {
+            if (node->zones[type]) {
+                free += node->zones[type]->free_pages;
+            }
+        }
+
+        print_string("    node ");
+        print_dec(i);
+        print_string(" (domain ");
+        print_dec(node->domain);
+        print_string("): ");
+        print_dec(node->start_pfn >> (20 - PAGE_SHIFT));
+        print_string("-");
+        print_dec(node->end_pfn >> (20 - PAGE_SHIFT));
+        print_string(" MB, ");
+        print_dec(free);
+        print_string(" free pages; hit ");
+        print_dec(node->hits);
+        print_string(", miss ");
+        print_dec(node->misses);
+        print_string(", foreign ");
+        print_dec(node->foreign);
+        print_string("; distance");
+        for (uint32_t j = 0; j < pmm->node_count; j++) {
+            print_string(" ");
+            print_dec(node->distance[j]);
+        }
+        print_string("\n");
+    }
+}
@@ -2,44 +2,810 @@
  * @file pmm.c
  * @brief Physical Memory Manager - управление физическими страницами
  * 
- * Реализация менеджера физической памяти с использованием битовой карты
- * для отслеживания свободных и занятых страниц размером 4KB
+ * Менеджер физической памяти построен из двух слоёв:
+ * 1. Битовая карта состояния страниц (1 - занята) - отвечает на вопрос
+ *    "свободна ли страница" за O(1) и служит основой для операций над диапазонами.
+ * 2. Двоичный buddy-аллокатор порядков 0..PMM_MAX_ORDER в зонах DMA (<16MB)
+ *    и Normal. Для каждого порядка зона хранит битовую карту свободных блоков
+ *    со сводными уровнями, поэтому поиск блока - это несколько __builtin_ctz,
+ *    а разбиение и слияние стоят O(log n).
+ *
+ * Зоны принадлежат узлам NUMA (numa.c): выделение начинается с узла
+ * процессора и переходит к остальным по возрастанию расстояния.
+ * Конвейер обнуления держит только страницы своего узла.
+ *
+ * Освобождённые одиночные страницы не обнуляются на месте: они попадают
+ * в "грязный" список, а цикл простоя (pmm_idle_work) обнуляет их порциями
+ * и складывает в пул, из которого берёт pmm_alloc_page_zeroed.
+ *
+ * Поверх битовой карты лежит база страничных кадров - массив page_t на
+ * каждую страницу до верхней границы памяти: счётчик владельцев, тип
+ * владельца (PG_*) и порядок блока. Выделение заводит дескрипторы
+ * блока, освобождение сначала снимает одну ссылку и возвращает страницы
+ * только последним владельцем.
  */
 
 #include "memory.h"
 #include "../video/video.h"
+#include "../cpu/cpu.h"
+#include "../lib/string.h"
 
 /* Глобальный экземпляр менеджера физической памяти */
 pmm_t physical_memory_manager;
 
+/* Обработчик региона карты памяти: база, длина, тип (MULTIBOOT_MEMORY_*) */
+typedef void (*pmm_region_fn)(uint64_t base, uint64_t len, uint32_t type);
+
+/* Следующий свободный адрес для служебных данных PMM во время загрузки */
+static uint32_t pmm_boot_cursor;
+
+/* Структуры загрузчика, которые pmm_boot_alloc не должен затереть */
+static struct {
+    uint32_t start;
+    uint32_t end;
+} pmm_boot_ranges[PMM_BOOT_RANGES];
+static uint32_t pmm_boot_range_count;
+
+/* Имена зон для pmm_dump_info */
+static const char *pmm_zone_names[PMM_ZONE_COUNT] = { "DMA", "Normal" };
+
+/**
+ * @brief Выделение обнулённой памяти под служебные данные PMM
+ *
+ * Область, задевающая структуру загрузчика, переносится на следующую
+ * страницу за ней (выравнивание страницы покрывает PAGE_DESC_ALIGN).
+ * @param bytes Размер в байтах
+ * @return Указатель на область после предыдущих данных
+ */
+static void* pmm_boot_alloc(uint32_t bytes) {
+    bytes = align_up(bytes, sizeof(uint32_t));
+    for (uint32_t i = 0; i < pmm_boot_range_count; i++) {
+        if (pmm_boot_cursor < pmm_boot_ranges[i].end &&
+            pmm_boot_cursor + bytes > pmm_boot_ranges[i].start) {
+            pmm_boot_cursor = align_up(pmm_boot_ranges[i].end, PAGE_SIZE);
+            i = (uint32_t)-1; /* Новое место проверяется заново */
+        }
+    }
+
+    void *ptr = (void*)pmm_boot_cursor;
+    memory_set(ptr, 0, bytes);
+    pmm_boot_cursor += bytes;
+    return ptr;
+}
+
+/* ===================== Битовая карта со сводными уровнями ===================== */
+
+/**
+ * @brief Создание битовой карты на bits бит (все биты сброшены)
+ *
+ * Над основными битами строятся сводные уровни, пока уровень не уместится
+ * в одно слово: бит уровня N установлен, если слово уровня N-1 не пусто.
+ */
+static void pmm_bitmap_init(pmm_bitmap_t *map, uint32_t bits) {
+    uint32_t words = bits;
+
+    map->levels = 0;
+    map->cursor = 0;
+    do {
+        words = (words + 31) / 32;
+        map->level[map->levels] = pmm_boot_alloc(words * sizeof(uint32_t));
+        map->words[map->levels] = words;
+        map->levels++;
+    } while (words > 1 && map->levels < PMM_BITMAP_LEVELS);
+}
+
+/**
+ * @brief Установка бита с обновлением сводок
+ *
+ * Подъём по уровням прекращается, как только слово уже было непустым.
+ */
+static void pmm_bitmap_set(pmm_bitmap_t *map, uint32_t index) {
+    for (uint32_t level = 0; level < map->levels; level++) {
+        uint32_t *word = &map->level[level][index / 32];
+        uint32_t before = *word;
+
+        *word |= 1u << (index % 32);
+        if (before != 0) {
+            break;
+        }
+        index /= 32;
+    }
+}
+
+/**
+ * @brief Сброс бита с обновлением сводок
+ *
+ * Подъём по уровням прекращается, как только слово осталось непустым.
+ */
+static void pmm_bitmap_clear(pmm_bitmap_t *map, uint32_t index) {
+    for (uint32_t level = 0; level < map->levels; level++) {
+        uint32_t *word = &map->level[level][index / 32];
+
+        *word &= ~(1u << (index % 32));
+        if (*word != 0) {
+            break;
+        }
+        index /= 32;
+    }
+}
+
+/**
+ * @brief Проверка бита
+ */
+static int pmm_bitmap_test(const pmm_bitmap_t *map, uint32_t index) {
+    return (map->level[0][index / 32] >> (index % 32)) & 1;
+}
+
+/**
+ * @brief Поиск установленного бита уровня level не раньше позиции start
+ *
+ * Если в текущем слове уровня нет подходящих битов, следующее непустое слово
+ * находится рекурсивно через уровень выше, поэтому стоимость поиска
+ * ограничена числом уровней, а не размером памяти.
+ * @return Номер найденного бита или -1
+ */
+static int32_t pmm_bitmap_find_from(const pmm_bitmap_t *map, uint32_t level, uint32_t start) {
+    const uint32_t *bits = map->level[level];
+    uint32_t word = start / 32;
+
+    if (word >= map->words[level]) {
+        return -1;
+    }
+
+    uint32_t masked = bits[word] & (0xFFFFFFFF << (start % 32));
+    if (masked) {
+        return word * 32 + __builtin_ctz(masked);
+    }
+
+    if (level + 1 >= map->levels) {
+        return -1;
+    }
+
+    int32_t next = pmm_bitmap_find_from(map, level + 1, word + 1);
+    if (next < 0) {
+        return -1;
+    }
+    return next * 32 + __builtin_ctz(bits[next]);
+}
+
+/**
+ * @brief Поиск установленного бита от курсора next-fit с переходом в начало
+ * @return Номер найденного бита или -1
+ */
+static int32_t pmm_bitmap_find(pmm_bitmap_t *map) {
+    int32_t index = pmm_bitmap_find_from(map, 0, map->cursor);
+    if (index < 0) {
+        index = pmm_bitmap_find_from(map, 0, 0);
+    }
+    if (index >= 0) {
+        map->cursor = index + 1;
+    }
+    return index;
+}
+
+/* ===================== Битовая карта состояния страниц ===================== */
+
+/**
+ * @brief Установка состояния диапазона страниц целыми словами битовой карты
+ * @param first Индекс первой страницы
+ * @param end Индекс страницы за последней
+ * @param used 1 - пометить занятыми, 0 - свободными
+ */
+static void pmm_page_range_set(uint32_t first, uint32_t end, int used) {
+    if (end > physical_memory_manager.total_pages) {
+        end = physical_memory_manager.total_pages;
+    }
+
+    while (first < end) {
+        uint32_t bit = first % 32;
+        uint32_t count = 32 - bit;
+        if (count > end - first) {
+            count = end - first;
+        }
+
+        uint32_t mask = (count == 32) ? 0xFFFFFFFF : ((1u << count) - 1) << bit;
+        if (used) {
+            physical_memory_manager.bitmap[first / 32] |= mask;
+        } else {
+            physical_memory_manager.bitmap[first / 32] &= ~mask;
+        }
+        first += count;
+    }
+}
+
+/**
+ * @brief Поиск первой страницы с заданным состоянием
+ * @param first Начало диапазона
+ * @param end Конец диапазона
+ * @param used Искомое состояние (1 - занята, 0 - свободна)
+ * @return Индекс найденной страницы или end
+ */
+static uint32_t pmm_page_scan(uint32_t first, uint32_t end, int used) {
+    while (first < end) {
+        uint32_t word = physical_memory_manager.bitmap[first / 32];
+        if (!used) {
+            word = ~word;
+        }
+        word &= 0xFFFFFFFF << (first % 32);
+        if (word) {
+            uint32_t found = (first & ~31u) + __builtin_ctz(word);
+            return found < end ? found : end;
+        }
+        first = (first & ~31u) + 32;
+    }
+    return end;
+}
+
+/**
+ * @brief Проверка, занята ли страница
+ */
+static int pmm_page_is_used(uint32_t pfn) {
+    return (physical_memory_manager.bitmap[pfn / 32] >> (pfn % 32)) & 1;
+}
+
+/* ===================== База страничных кадров ===================== */
+
+/**
+ * @brief Заполнение дескрипторов диапазона [first, end)
+ */
+static void pmm_desc_range_set(uint32_t first, uint32_t end, uint32_t flags, uint32_t refcount) {
+    if (end > physical_memory_manager.total_pages) {
+        end = physical_memory_manager.total_pages;
+    }
+    for (page_t *page = &physical_memory_manager.pages[first];
+         page < &physical_memory_manager.pages[end]; page++) {
+        page->flags = flags;
+        page->order = 0;
+        page->refcount = refcount;
+        page->next = NULL;
+        page->prev = NULL;
+    }
+}
+
+/**
+ * @brief Дескрипторы выделенного блока: один владелец, тип не задан
+ */
+static void pmm_desc_prep(uint32_t addr, uint32_t order) {
+    uint32_t pfn = addr >> PAGE_SHIFT;
+    pmm_desc_range_set(pfn, pfn + (1u << order), 0, 1);
+    physical_memory_manager.pages[pfn].order = order;
+}
+
+/**
+ * @brief Дескриптор страницы по физическому адресу
+ * @return Дескриптор или NULL, если адрес вне памяти
+ */
+page_t* phys_to_page(uint32_t addr) {
+    uint32_t pfn = addr >> PAGE_SHIFT;
+    if (pfn >= physical_memory_manager.total_pages) {
+        return NULL;
+    }
+    return &physical_memory_manager.pages[pfn];
+}
+
+/**
+ * @brief Физический адрес страницы по дескриптору
+ */
+uint32_t page_to_phys(const page_t *page) {
+    return (uint32_t)(page - physical_memory_manager.pages) << PAGE_SHIFT;
+}
+
+/**
+ * @brief Ещё один владелец выделенной страницы
+ * @param addr Физический адрес страницы
+ */
+void page_get(uint32_t addr) {
+    page_t *page = phys_to_page(addr);
+    if (page && page->refcount) {
+        page->refcount++;
+    }
+}
+
+/**
+ * @brief Снятие ссылки на страницу
+ *
+ * Последний владелец возвращает весь блок, начинающийся со страницы.
+ * @param addr Физический адрес страницы
+ */
+void page_put(uint32_t addr) {
+    page_t *page = phys_to_page(addr);
+    if (page && page->refcount && !(page->flags & PG_RESERVED)) {
+        pmm_free_pages(addr & PAGE_MASK, page->order);
+    }
+}
+
+/**
+ * @brief Пометка выделенных страниц типом владельца
+ * @param addr Адрес первой страницы
+ * @param count Количество страниц
+ * @param flags PG_*
+ */
+void pmm_set_page_flags(uint32_t addr, uint32_t count, uint32_t flags) {
+    page_t *page = phys_to_page(addr);
+    for (; page && count && page < &physical_memory_manager.pages[physical_memory_manager.total_pages];
+         page++, count--) {
+        page->flags |= flags;
+    }
+}
+
+/* ===================== Buddy-аллокатор ===================== */
+
+/**
+ * @brief Инициализация зоны [start_pfn, end_pfn) без свободных блоков
+ */
+static void pmm_zone_init(pmm_zone_t *zone, pmm_zone_type_t type, uint32_t node,
+                          uint32_t start_pfn, uint32_t end_pfn) {
+    zone->name = pmm_zone_names[type];
+    zone->type = type;
+    zone->node = node;
+    zone->base_pfn = start_pfn & ~(PMM_MAX_BLOCK_PAGES - 1);
+    zone->start_pfn = start_pfn;
+    zone->end_pfn = end_pfn > start_pfn ? end_pfn : start_pfn;
+    zone->free_pages = 0;
+    zone->order_mask = 0;
+
+    uint32_t span = align_up(zone->end_pfn - zone->base_pfn, PMM_MAX_BLOCK_PAGES);
+    for (uint32_t order = 0; order < PMM_ORDERS; order++) {
+        zone->free_blocks[order] = 0;
+        pmm_bitmap_init(&zone->free_map[order], span >> order);
+    }
+}
+
+/**
+ * @brief Зона, которой принадлежит страница
+ */
+static pmm_zone_t* pmm_zone_of(uint32_t pfn) {
+    for (uint32_t i = 0; i < physical_memory_manager.zone_count; i++) {
+        pmm_zone_t *zone = &physical_memory_manager.zones[i];
+        if (pfn >= zone->start_pfn && pfn < zone->end_pfn) {
+            return zone;
+        }
+    }
+    return NULL;
+}
+
+static void pmm_block_insert(pmm_zone_t *zone, uint32_t index, uint32_t order) {
+    pmm_bitmap_set(&zone->free_map[order], index >> order);
+    zone->free_blocks[order]++;
+    zone->order_mask |= 1u << order;
+}
+
+static void pmm_block_remove(pmm_zone_t *zone, uint32_t index, uint32_t order) {
+    pmm_bitmap_clear(&zone->free_map[order], index >> order);
+    if (--zone->free_blocks[order] == 0) {
+        zone->order_mask &= ~(1u << order);
+    }
+}
+
+static int pmm_block_is_free(const pmm_zone_t *zone, uint32_t index, uint32_t order) {
+    return pmm_bitmap_test(&zone->free_map[order], index >> order);
+}
+
+/**
+ * @brief Возврат блока в зону со слиянием с соседями-"приятелями"
+ * @param index Индекс первой страницы блока относительно base_pfn
+ * @param order Порядок блока
+ */
+static void pmm_zone_free_block(pmm_zone_t *zone, uint32_t index, uint32_t order) {
+    zone->free_pages += 1u << order;
+    physical_memory_manager.free_pages += 1u << order;
+
+    while (order < PMM_MAX_ORDER) {
+        uint32_t buddy = index ^ (1u << order);
+        if (!pmm_block_is_free(zone, buddy, order)) {
+            break;
+        }
+        pmm_block_remove(zone, buddy, order);
+        index &= ~(1u << order);
+        order++;
+    }
+    pmm_block_insert(zone, index, order);
+}
+
+/**
+ * @brief Выделение блока из зоны с разбиением большего блока
+ * @return Индекс первой страницы относительно base_pfn или -1
+ */
+static int32_t pmm_zone_alloc_block(pmm_zone_t *zone, uint32_t order) {
+    uint32_t candidates = zone->order_mask & (0xFFFFFFFF << order);
+    if (!candidates) {
+        return -1;
+    }
+
+    /* Наименьший подходящий порядок, в котором есть свободный блок */
+    uint32_t current = __builtin_ctz(candidates);
+    int32_t block = pmm_bitmap_find(&zone->free_map[current]);
+    if (block < 0) {
+        return -1; /* Не должно происходить: order_mask и карта рассогласованы */
+    }
+
+    uint32_t index = (uint32_t)block << current;
+    pmm_block_remove(zone, index, current);
+
+    /* Правые половины возвращаются в зону */
+    while (current > order) {
+        current--;
+        pmm_block_insert(zone, index + (1u << current), current);
+    }
+
+    zone->free_pages -= 1u << order;
+    physical_memory_manager.free_pages -= 1u << order;
+    return index;
+}
+
+/**
+ * @brief Добавление диапазона страниц одной зоны максимальными выровненными блоками
+ * @param first Первая страница (абсолютный номер)
+ * @param end Страница за последней
+ */
+static void pmm_zone_insert_range(pmm_zone_t *zone, uint32_t first, uint32_t end) {
+    uint32_t index = first - zone->base_pfn;
+    uint32_t limit = end - zone->base_pfn;
+
+    while (index < limit) {
+        uint32_t order = index ? __builtin_ctz(index) : PMM_MAX_ORDER;
+        if (order > PMM_MAX_ORDER) {
+            order = PMM_MAX_ORDER;
+        }
+        while ((1u << order) > limit - index) {
+            order--;
+        }
+        pmm_zone_free_block(zone, index, order);
+        index += 1u << order;
+    }
+}
+
+/**
+ * @brief Изъятие из зоны свободных страниц диапазона [first, end)
+ *
+ * Для каждой свободной страницы находится содержащий её свободный блок,
+ * блок удаляется, а его части вне диапазона возвращаются обратно.
+ */
+static void pmm_zone_carve_range(pmm_zone_t *zone, uint32_t first, uint32_t end) {
+    uint32_t pfn = pmm_page_scan(first, end, 0);
+
+    while (pfn < end) {
+        uint32_t index = pfn - zone->base_pfn;
+        uint32_t order = 0;
+        while (order <= PMM_MAX_ORDER && !pmm_block_is_free(zone, index, order)) {
+            order++;
+        }
+        if (order > PMM_MAX_ORDER) {
+            pfn = pmm_page_scan(pfn + 1, end, 0); /* Не должно происходить */
+            continue;
+        }
+
+        uint32_t block_first = zone->base_pfn + (index & ~((1u << order) - 1));
+        uint32_t block_end = block_first + (1u << order);
+        uint32_t cut_end = block_end < end ? block_end : end;
+
+        pmm_block_remove(zone, block_first - zone->base_pfn, order);
+        zone->free_pages -= 1u << order;
+        physical_memory_manager.free_pages -= 1u << order;
+
+        if (block_first < pfn) {
+            pmm_zone_insert_range(zone, block_first, pfn);
+        }
+        if (cut_end < block_end) {
+            pmm_zone_insert_range(zone, cut_end, block_end);
+        }
+        pmm_page_range_set(pfn, cut_end, 1);
+        pmm_desc_range_set(pfn, cut_end, PG_RESERVED, 1);
+
+        pfn = pmm_page_scan(cut_end, end, 0);
+    }
+}
+
+/**
+ * @brief Применение операции к частям диапазона, попадающим в каждую зону
+ */
+static void pmm_for_each_zone_part(uint32_t first, uint32_t end,
+                                   void (*fn)(pmm_zone_t*, uint32_t, uint32_t)) {
+    if (end > physical_memory_manager.total_pages) {
+        end = physical_memory_manager.total_pages;
+    }
+    for (uint32_t i = 0; i < physical_memory_manager.zone_count && first < end; i++) {
+        pmm_zone_t *zone = &physical_memory_manager.zones[i];
+        uint32_t part_first = first > zone->start_pfn ? first : zone->start_pfn;
+        uint32_t part_end = end < zone->end_pfn ? end : zone->end_pfn;
+        if (part_first < part_end) {
+            fn(zone, part_first, part_end);
+        }
+    }
+}
+
+/**
+ * @brief Освобождение занятых страниц диапазона одной зоны
+ *
+ * Уже свободные страницы пропускаются, поэтому повторное освобождение
+ * диапазона не портит счётчики.
+ */
+static void pmm_zone_release_range(pmm_zone_t *zone, uint32_t first, uint32_t end) {
+    uint32_t run = pmm_page_scan(first, end, 1);
+
+    while (run < end) {
+        uint32_t run_end = pmm_page_scan(run, end, 0);
+        pmm_zone_insert_range(zone, run, run_end);
+        pmm_page_range_set(run, run_end, 0);
+        pmm_desc_range_set(run, run_end, 0, 0);
+        run = pmm_page_scan(run_end, end, 1);
+    }
+}
+
+/**
+ * @brief Заполнение зоны свободными блоками по битовой карте страниц
+ */
+static void pmm_zone_seed(pmm_zone_t *zone, uint32_t first, uint32_t end) {
+    uint32_t run = pmm_page_scan(first, end, 0);
+
+    while (run < end) {
+        uint32_t run_end = pmm_page_scan(run, end, 1);
+        pmm_zone_insert_range(zone, run, run_end);
+        run = pmm_page_scan(run_end, end, 0);
+    }
+}
+
+/* ===================== Инициализация ===================== */
+
+/**
+ * @brief Обход карты памяти, переданной загрузчиком
+ *
+ * Если карты нет, используются mem_lower/mem_upper, а при их отсутствии -
+ * консервативные PMM_FALLBACK_MEMORY байт.
+ * @param mbi Информация от загрузчика (может быть NULL)
+ * @param fn Обработчик каждого региона
+ */
+static void pmm_walk_memory_map(const multiboot_info_t *mbi, pmm_region_fn fn) {
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        uint32_t addr = mbi->mmap_addr;
+        uint32_t end = mbi->mmap_addr + mbi->mmap_length;
+        while (addr < end) {
+            const multiboot_mmap_entry_t *entry = (const multiboot_mmap_entry_t*)addr;
+            fn(entry->addr, entry->len, entry->type);
+            addr += entry->size + sizeof(entry->size);
+        }
+    } else if (mbi && (mbi->flags & MULTIBOOT_INFO_MEMORY)) {
+        fn(0, (uint64_t)mbi->mem_lower * 1024, MULTIBOOT_MEMORY_AVAILABLE);
+        fn(0x100000, (uint64_t)mbi->mem_upper * 1024, MULTIBOOT_MEMORY_AVAILABLE);
+    } else {
+        fn(0x100000, PMM_FALLBACK_MEMORY - 0x100000, MULTIBOOT_MEMORY_AVAILABLE);
+    }
+}
+
+/* Вычисление верхней границы доступной памяти (не выше отображения 1:1) */
+static uint64_t pmm_scan_top;
+static uint64_t pmm_scan_usable;
+
+static void pmm_region_measure(uint64_t base, uint64_t len, uint32_t type) {
+    if (type != MULTIBOOT_MEMORY_AVAILABLE || base >= VMM_IDENTITY_LIMIT) {
+        return;
+    }
+    uint64_t end = base + len;
+    if (end > VMM_IDENTITY_LIMIT) {
+        end = VMM_IDENTITY_LIMIT;
+    }
+    if (end > pmm_scan_top) {
+        pmm_scan_top = end;
+    }
+    pmm_scan_usable += end - base;
+}
+
+/* Освобождение доступных регионов (границы округляются внутрь) */
+static void pmm_region_release(uint64_t base, uint64_t len, uint32_t type) {
+    if (type != MULTIBOOT_MEMORY_AVAILABLE || base >= 0x100000000ULL) {
+        return;
+    }
+    uint64_t first = (base + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint64_t end = (base + len) >> PAGE_SHIFT;
+    if (end > first) {
+        pmm_page_range_set((uint32_t)first, end > MAX_PAGES ? MAX_PAGES : (uint32_t)end, 0);
+    }
+}
+
+/* Резервирование дыр: reserved, ACPI, NVS, bad RAM (границы округляются наружу) */
+static void pmm_region_reserve(uint64_t base, uint64_t len, uint32_t type) {
+    if (type == MULTIBOOT_MEMORY_AVAILABLE || base >= 0x100000000ULL) {
+        return;
+    }
+    uint64_t first = base >> PAGE_SHIFT;
+    uint64_t end = (base + len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    pmm_page_range_set((uint32_t)first, end > MAX_PAGES ? MAX_PAGES : (uint32_t)end, 1);
+}
+
+/**
+ * @brief Конец области, занятой ядром и модулями загрузчика
+ */
+static uint32_t pmm_boot_image_end(uint32_t kernel_end, const multiboot_info_t *mbi) {
+    uint32_t end = kernel_end;
+
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MODS)) {
+        const multiboot_module_t *mods = (const multiboot_module_t*)mbi->mods_addr;
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            if (mods[i].mod_end > end) {
+                end = mods[i].mod_end;
+            }
+        }
+    }
+    return end;
+}
+
+/* Запоминание структуры загрузчика, которую служебные данные обходят */
+static void pmm_boot_range_add(uint32_t addr, uint32_t size) {
+    if (size && pmm_boot_range_count < PMM_BOOT_RANGES) {
+        pmm_boot_ranges[pmm_boot_range_count].start = addr;
+        pmm_boot_ranges[pmm_boot_range_count].end = addr + size;
+        pmm_boot_range_count++;
+    }
+}
+
+/**
+ * @brief Сбор структур загрузчика, которые ещё не прочитаны
+ *
+ * Служебные данные PMM обнуляются раньше, чем ядро прочтёт командную
+ * строку и модули, а QEMU -kernel кладёт командную строку и массив
+ * модулей сразу за образом ядра; GRUB может положить туда mbi или карту
+ * памяти. pmm_boot_alloc перешагивает эти области.
+ */
+static void pmm_boot_ranges_collect(const multiboot_info_t *mbi) {
+    pmm_boot_range_count = 0;
+    if (!mbi) {
+        return;
+    }
+
+    pmm_boot_range_add((uint32_t)mbi, sizeof(multiboot_info_t));
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+        pmm_boot_range_add(mbi->mmap_addr, mbi->mmap_length);
+    }
+    if ((mbi->flags & MULTIBOOT_INFO_CMDLINE) && mbi->cmdline) {
+        pmm_boot_range_add(mbi->cmdline, strlen((const char*)mbi->cmdline) + 1);
+    }
+    if ((mbi->flags & MULTIBOOT_INFO_BOOT_LOADER_NAME) && mbi->boot_loader_name) {
+        pmm_boot_range_add(mbi->boot_loader_name, strlen((const char*)mbi->boot_loader_name) + 1);
+    }
+    if (mbi->flags & MULTIBOOT_INFO_MODS) {
+        const multiboot_module_t *mods = (const multiboot_module_t*)mbi->mods_addr;
+        pmm_boot_range_add(mbi->mods_addr, mbi->mods_count * sizeof(multiboot_module_t));
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            if (mods[i].cmdline) {
+                pmm_boot_range_add(mods[i].cmdline, strlen((const char*)mods[i].cmdline) + 1);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Резервирование диапазона до запуска buddy-аллокатора (только битовая карта)
+ */
+static void pmm_reserve_early(uint32_t addr, uint32_t size) {
+    uint64_t first = addr >> PAGE_SHIFT;
+    uint64_t end = ((uint64_t)addr + size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    pmm_page_range_set((uint32_t)first, (uint32_t)end, 1);
+}
+
+/**
+ * @brief Резервирование структур загрузчика, которые ещё понадобятся ядру
+ */
+static void pmm_reserve_boot_info(const multiboot_info_t *mbi) {
+    if (!mbi) {
+        return;
+    }
+
+    pmm_reserve_early((uint32_t)mbi, sizeof(multiboot_info_t));
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+        pmm_reserve_early(mbi->mmap_addr, mbi->mmap_length);
+    }
+    if (mbi->flags & MULTIBOOT_INFO_CMDLINE) {
+        pmm_reserve_early(mbi->cmdline, PAGE_SIZE);
+    }
+    if (mbi->flags & MULTIBOOT_INFO_MODS) {
+        pmm_reserve_early(mbi->mods_addr, mbi->mods_count * sizeof(multiboot_module_t));
+    }
+    /* Остальные строки загрузчика - так же, как их обходил pmm_boot_alloc */
+    for (uint32_t i = 0; i < pmm_boot_range_count; i++) {
+        pmm_reserve_early(pmm_boot_ranges[i].start,
+                          pmm_boot_ranges[i].end - pmm_boot_ranges[i].start);
+    }
+}
+
 /**
  * @brief Инициализация менеджера физической памяти
+ *
+ * Размер битовых карт вычисляется по карте памяти загрузчика, сами карты
+ * размещаются сразу после ядра и модулей. Сначала строится битовая карта
+ * состояния страниц: все страницы заняты, затем освобождаются доступные
+ * регионы и заново резервируются дыры (reserved/ACPI), первый мегабайт,
+ * ядро, модули и служебные данные. По ней заполняются buddy-зоны.
+ *
  * @param kernel_end Адрес конца ядра в памяти
+ * @param mbi Информация от Multiboot-загрузчика (NULL, если её нет)
  */
-void pmm_init(uint32_t kernel_end) {
+void pmm_init(uint32_t kernel_end, const multiboot_info_t *mbi) {
     print_string("PMM Initialization... ");
     
+    /* Определяем верхнюю границу доступной памяти */
+    pmm_scan_top = 0;
+    pmm_scan_usable = 0;
+    pmm_walk_memory_map(mbi, pmm_region_measure);
+
+    uint64_t top_pages = pmm_scan_top >> PAGE_SHIFT;
+    uint32_t total_pages = top_pages > MAX_PAGES ? MAX_PAGES : (uint32_t)top_pages;
+    
     /* Инициализация структуры */
     physical_memory_manager.kernel_end = kernel_end;
-    physical_memory_manager.total_pages = MAX_PAGES;
-    physical_memory_manager.free_pages = MAX_PAGES;
+    physical_memory_manager.total_pages = total_pages;
+    physical_memory_manager.bitmap_words = (total_pages + 31) / 32;
+    physical_memory_manager.usable_memory = (uint32_t)(pmm_scan_usable >> 10);
+    physical_memory_manager.free_pages = 0;
+
+    /* Служебные данные размещаются сразу после ядра и модулей */
+    pmm_boot_ranges_collect(mbi);
+    pmm_boot_cursor = align_up(pmm_boot_image_end(kernel_end, mbi), PAGE_SIZE);
+    physical_memory_manager.bitmap = pmm_boot_alloc(physical_memory_manager.bitmap_words * sizeof(uint32_t));
+    physical_memory_manager.pool_bitmap = pmm_boot_alloc(physical_memory_manager.bitmap_words * sizeof(uint32_t));
+    pmm_boot_cursor = align_up(pmm_boot_cursor, PAGE_DESC_ALIGN);
+    physical_memory_manager.pages = pmm_boot_alloc(total_pages * sizeof(page_t));
+
+    /* Узлы NUMA делятся на зоны по границе DMA */
+    numa_init(total_pages);
+    uint32_t dma_end = PMM_DMA_LIMIT >> PAGE_SHIFT;
+    physical_memory_manager.zone_count = 0;
+    for (uint32_t i = 0; i < physical_memory_manager.node_count; i++) {
+        pmm_node_t *node = &physical_memory_manager.nodes[i];
+        if (node->start_pfn < dma_end) {
+            pmm_zone_t *zone = &physical_memory_manager.zones[physical_memory_manager.zone_count++];
+            pmm_zone_init(zone, PMM_ZONE_DMA, i, node->start_pfn,
+                          node->end_pfn < dma_end ? node->end_pfn : dma_end);
+            node->zones[PMM_ZONE_DMA] = zone;
+        }
+        if (node->end_pfn > dma_end) {
+            pmm_zone_t *zone = &physical_memory_manager.zones[physical_memory_manager.zone_count++];
+            pmm_zone_init(zone, PMM_ZONE_NORMAL, i,
+                          node->start_pfn > dma_end ? node->start_pfn : dma_end, node->end_pfn);
+            node->zones[PMM_ZONE_NORMAL] = zone;
+        }
+    }
+    physical_memory_manager.reserved_end = align_up(pmm_boot_cursor, PAGE_SIZE);
     
-    /* Очистка битовой карты */
-    memory_set(physical_memory_manager.bitmap, 0, sizeof(physical_memory_manager.bitmap));
+    /* Все страницы изначально заняты, включая несуществующие биты хвоста */
+    memory_set(physical_memory_manager.bitmap, 0xFF,
+               physical_memory_manager.bitmap_words * sizeof(uint32_t));
+
+    /* Освобождаем доступную память и снова помечаем дыры */
+    pmm_walk_memory_map(mbi, pmm_region_release);
+    pmm_walk_memory_map(mbi, pmm_region_reserve);
     
-    /* Помечаем страницы ядра как занятые */
-    uint32_t kernel_pages = (kernel_end + PAGE_SIZE - 1) >> PAGE_SHIFT;
-    for (uint32_t i = 0; i < kernel_pages; i++) {
-        pmm_mark_page_used(i << PAGE_SHIFT);
+    /* Первый мегабайт (BIOS, видеопамять), ядро, модули и служебные данные */
+    pmm_reserve_early(0, physical_memory_manager.reserved_end);
+    pmm_reserve_boot_info(mbi);
+
+    /* Всё, что осталось занятым, - зарезервировано навсегда */
+    uint32_t run = pmm_page_scan(0, total_pages, 1);
+    while (run < total_pages) {
+        uint32_t run_end = pmm_page_scan(run, total_pages, 0);
+        pmm_desc_range_set(run, run_end, PG_RESERVED, 1);
+        run = pmm_page_scan(run_end, total_pages, 1);
     }
-    
-    /* Помечаем первые 1MB как занятые (для BIOS, видеопамяти и т.д.) */
-    uint32_t reserved_pages = 1024 * 1024 / PAGE_SIZE; /* 1MB / 4KB = 256 страниц */
-    for (uint32_t i = 0; i < reserved_pages; i++) {
-        pmm_mark_page_used(i << PAGE_SHIFT);
+
+    /* Конвейер обнуления пуст; MOVNTI доступна, если есть SSE2 */
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    memory_set(&physical_memory_manager.zero_pool, 0, sizeof(pmm_zero_pool_t));
+    physical_memory_manager.zero_pool.use_movnti = (edx & CPUID_EDX_SSE2) != 0;
+
+    /* Страницы конвейера уже учтены свободными и shrinker не нужен:
+     * при нехватке памяти его отдаёт pmm_pool_drain */
+    physical_memory_manager.shrinkers = NULL;
+
+    /* Свободные страницы передаются buddy-зонам */
+    for (uint32_t i = 0; i < physical_memory_manager.zone_count; i++) {
+        pmm_zone_t *zone = &physical_memory_manager.zones[i];
+        pmm_zone_seed(zone, zone->start_pfn, zone->end_pfn);
     }
     
     print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Usable memory: ");
+    print_dec(physical_memory_manager.usable_memory);
+    print_string(" KB\n");
     print_string("  - Total pages: ");
     print_hex(physical_memory_manager.total_pages);
     print_string("\n  - Free pages: ");
@@ -47,23 +813,435 @@ void pmm_init(uint32_t kernel_end) {
     print_string("\n");
 }
 
+/* ===================== Выделение и освобождение ===================== */
+
+/**
+ * @brief Выделение блока из buddy-зон type и ниже, минуя конвейер обнуления
+ *
+ * Узлы перебираются по списку запасных узла node: сначала все зоны
+ * самого узла, затем ближайшего к нему и так далее.
+ * @param nodes Сколько узлов списка пробовать (1 - только node)
+ */
+static uint32_t pmm_buddy_alloc(uint32_t order, pmm_zone_type_t type, uint32_t node, uint32_t nodes) {
+    const pmm_node_t *preferred = &physical_memory_manager.nodes[node];
+    for (uint32_t n = 0; n < nodes && n < physical_memory_manager.node_count; n++) {
+        const pmm_node_t *candidate = &physical_memory_manager.nodes[preferred->fallback[n]];
+        for (int i = type; i >= 0; i--) {
+            pmm_zone_t *zone = candidate->zones[i];
+            int32_t index = zone ? pmm_zone_alloc_block(zone, order) : -1;
+            if (index >= 0) {
+                uint32_t pfn = zone->base_pfn + index;
+                pmm_page_range_set(pfn, pfn + (1u << order), 1);
+                return pfn << PAGE_SHIFT;
+            }
+        }
+    }
+    return 0; /* Нет свободного блока нужного размера */
+}
+
+/**
+ * @brief Возврат занятого блока в buddy-зону
+ */
+static void pmm_buddy_release(uint32_t addr, uint32_t order) {
+    uint32_t pfn = addr >> PAGE_SHIFT;
+    pmm_zone_t *zone = pmm_zone_of(pfn);
+
+    if (zone) {
+        pmm_page_range_set(pfn, pfn + (1u << order), 0);
+        pmm_zone_free_block(zone, pfn - zone->base_pfn, order);
+    }
+}
+
+/* ===================== Конвейер обнуления страниц ===================== */
+
+static int pmm_page_is_pooled(uint32_t pfn) {
+    return (physical_memory_manager.pool_bitmap[pfn / 32] >> (pfn % 32)) & 1;
+}
+
+/**
+ * @brief Добавление страницы в список конвейера (связь - первое слово страницы)
+ */
+static void pmm_pool_push(uint32_t *head, uint32_t *count, uint32_t page) {
+    uint32_t pfn = page >> PAGE_SHIFT;
+
+    *(uint32_t*)page = *head;
+    *head = page;
+    (*count)++;
+    physical_memory_manager.pool_bitmap[pfn / 32] |= 1u << (pfn % 32);
+}
+
+/**
+ * @brief Извлечение страницы из списка конвейера
+ * @return Адрес страницы или 0, если список пуст
+ */
+static uint32_t pmm_pool_pop(uint32_t *head, uint32_t *count) {
+    uint32_t page = *head;
+    if (!page) {
+        return 0;
+    }
+
+    uint32_t pfn = page >> PAGE_SHIFT;
+    *head = *(uint32_t*)page;
+    (*count)--;
+    physical_memory_manager.pool_bitmap[pfn / 32] &= ~(1u << (pfn % 32));
+    return page;
+}
+
+/**
+ * @brief Обнуление страницы
+ *
+ * При наличии SSE2 используются невременные записи MOVNTI: они идут мимо
+ * кэша и не вытесняют из него рабочие данные ядра.
+ */
+static void pmm_zero_page(uint32_t page) {
+    if (!physical_memory_manager.zero_pool.use_movnti) {
+        memory_set((void*)page, 0, PAGE_SIZE);
+        return;
+    }
+
+    uint32_t *word = (uint32_t*)page;
+    uint32_t *end = word + PAGE_SIZE / sizeof(uint32_t);
+    for (; word < end; word += 4) {
+        __asm__ volatile("movnti %1, 0(%0)\n\t"
+                         "movnti %1, 4(%0)\n\t"
+                         "movnti %1, 8(%0)\n\t"
+                         "movnti %1, 12(%0)"
+                         : : "r"(word), "r"(0) : "memory");
+    }
+    __asm__ volatile("sfence" ::: "memory");
+}
+
 /**
- * @brief Поиск свободной страницы в битовой карте
- * @return Индекс свободной страницы или -1, если нет свободных страниц
+ * @brief Возврат всех страниц конвейера в buddy-зоны
+ * @return Возвращено страниц
  */
-static int find_free_page(void) {
-    for (uint32_t i = 0; i < BITMAP_SIZE; i++) {
-        if (physical_memory_manager.bitmap[i] != 0xFFFFFFFF) {
-            /* Найдена группа с свободными страницами */
-            uint32_t bitmap_entry = physical_memory_manager.bitmap[i];
-            for (uint32_t j = 0; j < 32; j++) {
-                if (!(bitmap_entry & (1 << j))) {
-                    return i * 32 + j;
-                }
+static uint32_t pmm_pool_drain(void) {
+    pmm_zero_pool_t *pool = &physical_memory_manager.zero_pool;
+    uint32_t drained = 0;
+    uint32_t page;
+
+    while ((page = pmm_pool_pop(&pool->dirty_head, &pool->dirty_count)) != 0) {
+        pmm_buddy_release(page, 0);
+        drained++;
+    }
+    while ((page = pmm_pool_pop(&pool->zero_head, &pool->zero_count)) != 0) {
+        pmm_buddy_release(page, 0);
+        drained++;
+    }
+    return drained;
+}
+
+/**
+ * @brief Порция фоновой работы PMM для цикла простоя
+ *
+ * Сначала - фоновое освобождение памяти, если запас ниже водяного знака,
+ * и возврат PMM опустевших пулов кучи сверх запаса.
+ * Затем обнуляет до PMM_ZERO_BATCH страниц: сначала освобождённые
+ * ("грязные"), затем, пока пул не достиг PMM_ZERO_POOL_TARGET, свежие из
+ * buddy. Когда пул полон, грязные страницы возвращаются в buddy без обнуления.
+ * @return 1, если работа ещё осталась и засыпать пока не стоит
+ */
+int pmm_idle_work(void) {
+    pmm_zero_pool_t *pool = &physical_memory_manager.zero_pool;
+
+    if (shrink_background()) {
+        return 1;
+    }
+    if (kernel_heap.trim_wanted) {
+        heap_trim(&kernel_heap, HEAP_SPARE_POOLS);
+    }
+
+    int node_empty = 0;
+    for (uint32_t i = 0; i < PMM_ZERO_BATCH; i++) {
+        uint32_t page = pmm_pool_pop(&pool->dirty_head, &pool->dirty_count);
+
+        if (pool->zero_count >= PMM_ZERO_POOL_TARGET) {
+            if (!page) {
+                break;
+            }
+            pmm_buddy_release(page, 0);
+            continue;
+        }
+
+        if (!page) {
+            page = pmm_buddy_alloc(0, PMM_ZONE_NORMAL, physical_memory_manager.local_node, 1);
+            if (!page) {
+                node_empty = 1;
+                break;
             }
         }
+
+        pmm_zero_page(page);
+        pool->zeroed++;
+        pmm_pool_push(&pool->zero_head, &pool->zero_count, page);
+    }
+
+    /* Пул пополняется только своим узлом: свободные страницы чужих узлов
+     * работой не считаются, иначе простой никогда не засыпал бы */
+    return pool->dirty_head != 0 ||
+           (pool->zero_count < PMM_ZERO_POOL_TARGET && !node_empty);
+}
+
+/**
+ * @brief Учёт выделения в счётчиках узлов NUMA
+ * @param addr Выделенная страница
+ * @param node Узел, на котором её просили
+ */
+static void pmm_node_account(uint32_t addr, uint32_t node) {
+    pmm_t *pmm = &physical_memory_manager;
+    uint32_t actual = (uint32_t)pmm_page_node(addr);
+    if (actual == node) {
+        pmm->nodes[node].hits++;
+    } else {
+        pmm->nodes[actual].misses++;
+        pmm->nodes[node].foreign++;
+    }
+}
+
+/**
+ * @brief Проверка запаса после выделения
+ *
+ * Ниже PMM_LOW_WATERMARK будится фоновое освобождение, ниже
+ * PMM_MIN_WATERMARK оно идёт сразу: источникам (zram) самим нужны страницы.
+ */
+static void pmm_check_watermarks(void) {
+    uint32_t free = pmm_get_free_pages_count();
+    if (free < PMM_LOW_WATERMARK) {
+        physical_memory_manager.reclaim_wanted = 1;
+        if (free < PMM_MIN_WATERMARK && shrink_memory(PMM_RECLAIM_BATCH)) {
+            physical_memory_manager.direct_reclaims++;
+        }
     }
-    return -1; /* Нет свободных страниц */
+}
+
+/**
+ * @brief Выделение обнулённой страницы
+ *
+ * Берёт страницу из пула, заполняемого в простое; если пул пуст,
+ * обнуляет обычную страницу на месте.
+ * @return Адрес страницы или 0 при ошибке
+ */
+uint32_t pmm_alloc_page_zeroed(void) {
+    pmm_zero_pool_t *pool = &physical_memory_manager.zero_pool;
+    uint32_t page = pmm_pool_pop(&pool->zero_head, &pool->zero_count);
+
+    if (page) {
+        *(uint32_t*)page = 0; /* Слово связи списка */
+        pmm_desc_prep(page, 0);
+        pool->hits++;
+        /* В конвейере только страницы узла процессора (pmm_free_pages,
+         * pmm_idle_work), так что это попадание; учёт - как у buddy */
+        pmm_node_account(page, physical_memory_manager.local_node);
+        pmm_check_watermarks();
+        return page;
+    }
+
+    pool->misses++;
+    page = pmm_alloc_page();
+    if (page) {
+        pmm_zero_page(page);
+    }
+    return page;
+}
+
+/**
+ * @brief Выделение 2^order страниц из зон zone и ниже, начиная с узла node
+ *
+ * Запрос к Normal при нехватке памяти обслуживается из DMA, запрос к DMA -
+ * только из DMA; чужие узлы - по возрастанию расстояния. Одиночная
+ * страница своего узла сначала берётся из грязного списка (она ещё
+ * горячая в кэше). Если buddy пуст, в него возвращается конвейер
+ * обнуления, затем память освобождают зарегистрированные shrinker и
+ * попытка повторяется (до PMM_RECLAIM_RETRIES раз). После выделения
+ * проверяется запас (pmm_check_watermarks).
+ */
+static uint32_t pmm_alloc_pages_from(uint32_t order, pmm_zone_type_t zone, uint32_t node) {
+    pmm_t *pmm = &physical_memory_manager;
+    uint32_t addr = 0;
+    if (order == 0 && zone == PMM_ZONE_NORMAL && node == pmm->local_node) {
+        addr = pmm_pool_pop(&pmm->zero_pool.dirty_head, &pmm->zero_pool.dirty_count);
+    }
+
+    if (!addr) {
+        addr = pmm_buddy_alloc(order, zone, node, pmm->node_count);
+    }
+    /* Страницы конвейера свободны, но не слиты с соседями в buddy */
+    if (!addr && pmm_pool_drain()) {
+        addr = pmm_buddy_alloc(order, zone, node, pmm->node_count);
+    }
+    for (uint32_t retry = 0; !addr && retry < PMM_RECLAIM_RETRIES; retry++) {
+        uint32_t target = (1u << order) > PMM_RECLAIM_BATCH ? (1u << order) : PMM_RECLAIM_BATCH;
+        if (!shrink_memory(target)) {
+            break;
+        }
+        physical_memory_manager.direct_reclaims++;
+        /* Освобождённые страницы лежат в грязном списке */
+        pmm_pool_drain();
+        addr = pmm_buddy_alloc(order, zone, node, pmm->node_count);
+    }
+    if (!addr) {
+        physical_memory_manager.alloc_failures++;
+        return 0;
+    }
+
+    pmm_node_account(addr, node);
+    pmm_desc_prep(addr, order);
+    pmm_check_watermarks();
+    return addr;
+}
+
+/* ===================== Внешний интерфейс ===================== */
+
+/**
+ * @brief Выделение 2^order физически непрерывных страниц из зоны zone или ниже
+ *
+ * Предпочитается узел процессора (см. pmm_alloc_pages_from).
+ * @param order Порядок блока (0..PMM_MAX_ORDER)
+ * @param zone Наивысшая допустимая зона
+ * @return Физический адрес блока (выровнен на его размер) или 0 при ошибке
+ * @note Содержимое блока не определено (см. pmm_alloc_page_zeroed)
+ */
+uint32_t pmm_alloc_pages_zone(uint32_t order, pmm_zone_type_t zone) {
+    if (order > PMM_MAX_ORDER || zone >= PMM_ZONE_COUNT) {
+        return 0;
+    }
+    return pmm_alloc_pages_from(order, zone, physical_memory_manager.local_node);
+}
+
+/**
+ * @brief Выделение 2^order страниц, предпочтительно с узла node
+ *
+ * Если на узле нет свободного блока, используются ближайшие к нему.
+ * @param order Порядок блока (0..PMM_MAX_ORDER)
+ * @param node Узел NUMA
+ * @return Физический адрес блока или 0 при ошибке
+ */
+uint32_t pmm_alloc_pages_node(uint32_t order, uint32_t node) {
+    if (order > PMM_MAX_ORDER || node >= physical_memory_manager.node_count) {
+        return 0;
+    }
+    return pmm_alloc_pages_from(order, PMM_ZONE_NORMAL, node);
+}
+
+/**
+ * @brief Узел NUMA, которому принадлежит страница
+ * @param addr Физический адрес
+ * @return Номер узла или -1 для адреса вне памяти
+ */
+int32_t pmm_page_node(uint32_t addr) {
+    pmm_zone_t *zone = pmm_zone_of(addr >> PAGE_SHIFT);
+    return zone ? (int32_t)zone->node : -1;
+}
+
+/**
+ * @brief Выделение 2^order физически непрерывных страниц из любой зоны
+ * @param order Порядок блока (0..PMM_MAX_ORDER)
+ * @return Физический адрес блока или 0 при ошибке
+ */
+uint32_t pmm_alloc_pages(uint32_t order) {
+    return pmm_alloc_pages_zone(order, PMM_ZONE_NORMAL);
+}
+
+/**
+ * @brief Освобождение блока, выделенного pmm_alloc_pages
+ *
+ * У разделяемого блока снимается только одна ссылка. Зарезервированные
+ * страницы не освобождаются. Одиночные страницы уходят в грязный список
+ * и обнуляются позже в простое, многостраничные блоки сразу возвращаются
+ * в buddy.
+ * @param addr Адрес блока
+ * @param order Порядок, с которым блок выделялся
+ */
+void pmm_free_pages(uint32_t addr, uint32_t order) {
+    uint32_t pfn = addr >> PAGE_SHIFT;
+
+    if (order > PMM_MAX_ORDER || (pfn & ((1u << order) - 1)) ||
+        pfn + (1u << order) > physical_memory_manager.total_pages) {
+        return; /* Некорректный адрес или порядок */
+    }
+
+    /* Проверяем, был ли блок занят */
+    if (!pmm_page_is_used(pfn) || pmm_page_is_pooled(pfn)) {
+        return; /* Блок уже свободен */
+    }
+
+    page_t *page = &physical_memory_manager.pages[pfn];
+    if (page->flags & PG_RESERVED) {
+        return;
+    }
+    if (page->refcount > 1) {
+        for (uint32_t i = 0; i < (1u << order); i++) {
+            page[i].refcount--;
+        }
+        return;
+    }
+    pmm_desc_range_set(pfn, pfn + (1u << order), 0, 0);
+
+    /* Конвейер держит только страницы узла процессора */
+    pmm_zero_pool_t *pool = &physical_memory_manager.zero_pool;
+    if (order == 0 && pool->dirty_count < PMM_DIRTY_MAX &&
+        (physical_memory_manager.node_count == 1 ||
+         pmm_page_node(addr) == (int32_t)physical_memory_manager.local_node)) {
+        pmm_pool_push(&pool->dirty_head, &pool->dirty_count, addr);
+        return;
+    }
+
+    pmm_buddy_release(addr, order);
+}
+
+/**
+ * @brief Освобождение произвольного числа страниц, выделенных pmm_alloc_pages_exact
+ *
+ * Диапазон разбивается на наибольшие выровненные блоки buddy.
+ * @param addr Адрес первой страницы
+ * @param count Количество страниц
+ */
+void pmm_free_pages_exact(uint32_t addr, uint32_t count) {
+    uint32_t pfn = addr >> PAGE_SHIFT;
+
+    while (count) {
+        uint32_t order = 31 - __builtin_clz(count);
+        if (pfn) {
+            uint32_t align = __builtin_ctz(pfn);
+            if (align < order) {
+                order = align;
+            }
+        }
+        if (order > PMM_MAX_ORDER) {
+            order = PMM_MAX_ORDER;
+        }
+
+        pmm_free_pages(pfn << PAGE_SHIFT, order);
+        pfn += 1u << order;
+        count -= 1u << order;
+    }
+}
+
+/**
+ * @brief Выделение непрерывного диапазона из count страниц
+ *
+ * Берётся блок buddy ближайшего порядка, а хвост сверх count страниц
+ * сразу возвращается, так что округление до степени двойки ничего не стоит.
+ * @param count Количество страниц (не больше PMM_MAX_BLOCK_PAGES)
+ * @return Адрес первой страницы или 0 при ошибке
+ */
+uint32_t pmm_alloc_pages_exact(uint32_t count) {
+    if (count == 0 || count > PMM_MAX_BLOCK_PAGES) {
+        return 0;
+    }
+
+    uint32_t order = 0;
+    while ((1u << order) < count) {
+        order++;
+    }
+
+    uint32_t addr = pmm_alloc_pages(order);
+    if (addr && (1u << order) > count) {
+        pmm_free_pages_exact(addr + count * PAGE_SIZE, (1u << order) - count);
+        /* Диапазон освобождается по частям, а не блоком порядка order */
+        physical_memory_manager.pages[addr >> PAGE_SHIFT].order = 0;
+    }
+    return addr;
 }
 
 /**
@@ -71,19 +1249,7 @@ static int find_free_page(void) {
  * @return Адрес выделенной страницы или 0 при ошибке
  */
 uint32_t pmm_alloc_page(void) {
-    if (physical_memory_manager.free_pages == 0) {
-        return 0; /* Нет свободных страниц */
-    }
-    
-    int page_index = find_free_page();
-    if (page_index == -1) {
-        return 0; /* Не удалось найти свободную страницу */
-    }
-    
-    uint32_t page_addr = page_index << PAGE_SHIFT;
-    pmm_mark_page_used(page_addr);
-    
-    return page_addr;
+    return pmm_alloc_pages(0);
 }
 
 /**
@@ -91,33 +1257,17 @@ uint32_t pmm_alloc_page(void) {
  * @param page_addr Адрес страницы для освобождения
  */
 void pmm_free_page(uint32_t page_addr) {
-    uint32_t page_index = page_addr >> PAGE_SHIFT;
-    uint32_t bitmap_index = page_index / 32;
-    uint32_t bit_index = page_index % 32;
-    
-    if (bitmap_index >= BITMAP_SIZE) {
-        return; /* Некорректный адрес */
-    }
-    
-    /* Проверяем, была ли страница занята */
-    if (!(physical_memory_manager.bitmap[bitmap_index] & (1 << bit_index))) {
-        return; /* Страница уже свободна */
-    }
-    
-    /* Освобождаем страницу */
-    physical_memory_manager.bitmap[bitmap_index] &= ~(1 << bit_index);
-    physical_memory_manager.free_pages++;
-    
-    /* Очищаем содержимое страницы */
-    memory_set((void*)page_addr, 0, PAGE_SIZE);
+    pmm_free_pages(page_addr, 0);
 }
 
 /**
  * @brief Получение количества свободных страниц
- * @return Количество свободных страниц
+ * @return Свободные страницы buddy плюс страницы конвейера обнуления
  */
 uint32_t pmm_get_free_pages_count(void) {
-    return physical_memory_manager.free_pages;
+    return physical_memory_manager.free_pages +
+           physical_memory_manager.zero_pool.dirty_count +
+           physical_memory_manager.zero_pool.zero_count;
 }
 
 /**
@@ -125,19 +1275,7 @@ uint32_t pmm_get_free_pages_count(void) {
  * @param page_addr Адрес страницы
  */
 void pmm_mark_page_used(uint32_t page_addr) {
-    uint32_t page_index = page_addr >> PAGE_SHIFT;
-    uint32_t bitmap_index = page_index / 32;
-    uint32_t bit_index = page_index % 32;
-    
-    if (bitmap_index >= BITMAP_SIZE) {
-        return; /* Некорректный адрес */
-    }
-    
-    /* Проверяем, была ли страница свободна */
-    if (!(physical_memory_manager.bitmap[bitmap_index] & (1 << bit_index))) {
-        physical_memory_manager.bitmap[bitmap_index] |= (1 << bit_index);
-        physical_memory_manager.free_pages--;
-    }
+    pmm_mark_region_used(page_addr & PAGE_MASK, PAGE_SIZE);
 }
 
 /**
@@ -145,33 +1283,166 @@ void pmm_mark_page_used(uint32_t page_addr) {
  * @param page_addr Адрес страницы
  */
 void pmm_mark_page_free(uint32_t page_addr) {
-    uint32_t page_index = page_addr >> PAGE_SHIFT;
-    uint32_t bitmap_index = page_index / 32;
-    uint32_t bit_index = page_index % 32;
-    
-    if (bitmap_index >= BITMAP_SIZE) {
-        return; /* Некорректный адрес */
+    pmm_mark_region_free(page_addr & PAGE_MASK, PAGE_SIZE);
+}
+
+/**
+ * @brief Пометить диапазон памяти как занятый
+ *
+ * Границы округляются наружу до страниц, так что частично
+ * затронутые страницы тоже резервируются.
+ * @param addr Начальный адрес
+ * @param size Размер в байтах
+ */
+void pmm_mark_region_used(uint32_t addr, uint32_t size) {
+    uint64_t first = addr >> PAGE_SHIFT;
+    uint64_t end = ((uint64_t)addr + size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+    /* Страницы конвейера числятся занятыми - сначала возвращаем их в buddy */
+    pmm_pool_drain();
+    pmm_for_each_zone_part((uint32_t)first, (uint32_t)end, pmm_zone_carve_range);
+}
+
+/**
+ * @brief Пометить диапазон памяти как свободный
+ *
+ * Границы округляются внутрь: освобождаются только страницы,
+ * целиком лежащие в диапазоне.
+ * @param addr Начальный адрес
+ * @param size Размер в байтах
+ */
+void pmm_mark_region_free(uint32_t addr, uint32_t size) {
+    uint64_t first = ((uint64_t)addr + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint64_t end = ((uint64_t)addr + size) >> PAGE_SHIFT;
+    if (end > first) {
+        pmm_pool_drain();
+        pmm_for_each_zone_part((uint32_t)first, (uint32_t)end, pmm_zone_release_range);
     }
-    
-    /* Проверяем, была ли страница занята */
-    if (physical_memory_manager.bitmap[bitmap_index] & (1 << bit_index)) {
-        physical_memory_manager.bitmap[bitmap_index] &= ~(1 << bit_index);
-        physical_memory_manager.free_pages++;
+}
+
+/* Строки разбивки страниц по типу владельца */
+#define PMM_TYPE_FREE 0
+#define PMM_TYPE_KERNEL 1
+#define PMM_TYPE_COUNT 8
+
+static const char *pmm_type_names[PMM_TYPE_COUNT] = {
+    "free", "kernel", "reserved", "slab", "heap", "page tables", "vmalloc", "page cache"
+};
+
+static const uint16_t pmm_type_flags[PMM_TYPE_COUNT] = {
+    0, 0, PG_RESERVED, PG_SLAB, PG_HEAP, PG_PAGETABLE, PG_VMALLOC, PG_PAGECACHE
+};
+
+/**
+ * @brief Разбивка страниц по типу владельца из базы страничных кадров
+ */
+static void pmm_dump_page_types(void) {
+    uint32_t counts[PMM_TYPE_COUNT] = { 0 };
+    uint32_t shared = 0, dirty = 0, locked = 0;
+
+    for (uint32_t pfn = 0; pfn < physical_memory_manager.total_pages; pfn++) {
+        const page_t *page = &physical_memory_manager.pages[pfn];
+        if (!pmm_page_is_used(pfn) || pmm_page_is_pooled(pfn)) {
+            counts[PMM_TYPE_FREE]++;
+            continue;
+        }
+
+        uint32_t type = PMM_TYPE_KERNEL;
+        for (uint32_t i = PMM_TYPE_KERNEL + 1; i < PMM_TYPE_COUNT; i++) {
+            if (page->flags & pmm_type_flags[i]) {
+                type = i;
+                break;
+            }
+        }
+        counts[type]++;
+        shared += page->refcount > 1;
+        dirty += (page->flags & PG_DIRTY) != 0;
+        locked += (page->flags & PG_LOCKED) != 0;
     }
+
+    print_string("  - Page frames: ");
+    print_dec(physical_memory_manager.total_pages);
+    print_string(" x ");
+    print_dec(sizeof(page_t));
+    print_string(" bytes at ");
+    print_hex((uint32_t)physical_memory_manager.pages);
+    print_string("\n");
+    for (uint32_t i = 0; i < PMM_TYPE_COUNT; i++) {
+        print_string("    ");
+        print_string(pmm_type_names[i]);
+        print_string(": ");
+        print_dec(counts[i]);
+        print_string(" pages (");
+        print_dec(counts[i] * (PAGE_SIZE / 1024));
+        print_string(" KB)\n");
+    }
+    print_string("    shared: ");
+    print_dec(shared);
+    print_string(", dirty: ");
+    print_dec(dirty);
+    print_string(", locked: ");
+    print_dec(locked);
+    print_string("\n");
 }
 
 /**
  * @brief Вывод информации о состоянии менеджера физической памяти
  */
 void pmm_dump_info(void) {
+    /* Страницы конвейера обнуления свободны, как и для остальных потребителей */
+    uint32_t free = pmm_get_free_pages_count();
+
     print_string("Physical Memory Manager Info:\n");
     print_string("  - Total pages: ");
     print_hex(physical_memory_manager.total_pages);
     print_string("\n  - Free pages: ");
-    print_hex(physical_memory_manager.free_pages);
+    print_hex(free);
     print_string("\n  - Used pages: ");
-    print_hex(physical_memory_manager.total_pages - physical_memory_manager.free_pages);
-    print_string("\n  - Kernel end: 0x");
+    print_hex(physical_memory_manager.total_pages - free);
+    print_string("\n  - Usable memory: ");
+    print_dec(physical_memory_manager.usable_memory);
+    print_string(" KB\n  - Kernel end: 0x");
     print_hex(physical_memory_manager.kernel_end);
+    print_string("\n  - Metadata end: ");
+    print_hex(physical_memory_manager.reserved_end);
+    print_string("\n");
+
+    const pmm_zero_pool_t *pool = &physical_memory_manager.zero_pool;
+    print_string("  - Zero pool: ");
+    print_dec(pool->zero_count);
+    print_string("/");
+    print_dec(PMM_ZERO_POOL_TARGET);
+    print_string(" pages, dirty: ");
+    print_dec(pool->dirty_count);
+    print_string(pool->use_movnti ? " (movnti)\n" : " (memory_set)\n");
+    print_string("  - Zero pool hits: ");
+    print_dec(pool->hits);
+    print_string(", misses: ");
+    print_dec(pool->misses);
+    print_string(", zeroed in idle: ");
+    print_dec(pool->zeroed);
     print_string("\n");
-} 
\ No newline at end of file
+
+    for (uint32_t i = 0; i < physical_memory_manager.zone_count; i++) {
+        const pmm_zone_t *zone = &physical_memory_manager.zones[i];
+        print_string("  - Zone ");
+        print_string(zone->name);
+        if (physical_memory_manager.node_count > 1) {
+            print_string(" (node ");
+            print_dec(zone->node);
+            print_string(")");
+        }
+        print_string(": ");
+        print_dec(zone->free_pages);
+        print_string(" free pages\n    free blocks by order:");
+        for (uint32_t order = 0; order < PMM_ORDERS; order++) {
+            print_string(" ");
+            print_dec(zone->free_blocks[order]);
+        }
+        print_string("\n");
+    }
+    numa_dump_info();
+
+    pmm_dump_page_types();
+    shrinker_dump_info();
+}
@@ -0,0 +1,203 @@
+/**
+ * @file profile.c
+ * @brief Профилирование kmalloc: места вызова, гистограммы размеров, фрагментация
+ *
+ * Каждое выделение kmalloc относится к месту вызова - адресу возврата или
+ * явному тегу kmalloc_tagged. Места лежат в таблице с открытой адресацией,
+ * индекс места хранится рядом с выделением (см. heap.c), поэтому kfree
+ * списывает байты с того же места. Все счётчики обновляются за O(1)
+ * при выделении и освобождении, обхода кучи не требуется.
+ */
+
+#include "memory.h"
+#include "../video/video.h"
+
+/* Глобальные счётчики профилирования */
+heap_prof_t heap_prof;
+
+/**
+ * @brief Класс гистограммы: k для размеров [2^k, 2^(k+1))
+ */
+static uint32_t heap_prof_class(uint32_t size) {
+    return 31 - __builtin_clz(size);
+}
+
+/**
+ * @brief Индекс места вызова в таблице, с добавлением нового
+ *
+ * Место ищется не дальше HEAP_PROF_PROBES проб от хеша ключа; если все
+ * пробы заняты чужими местами, выделение учитывается в записи 0 ("прочие").
+ * @param key Адрес вызова или указатель на строку тега
+ * @param name Имя тега или NULL
+ * @return Индекс записи
+ */
+uint8_t heap_prof_site(const void *key, const char *name) {
+    uint32_t index = ((uint32_t)key * 2654435761u) >> 25; /* 7 старших бит */
+
+    for (uint32_t probe = 0; probe < HEAP_PROF_PROBES; probe++) {
+        index = (index + probe) & (HEAP_PROF_SITES - 1);
+        if (index == 0) {
+            continue; /* Запись 0 зарезервирована */
+        }
+
+        heap_site_t *site = &heap_prof.sites[index];
+        if (site->key == key) {
+            return index;
+        }
+        if (!site->key) {
+            site->key = key;
+            site->name = name;
+            heap_prof.site_count++;
+            return index;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Учёт выделения
+ * @param site Индекс места вызова
+ * @param size Полезный размер выделения
+ */
+void heap_prof_alloc(uint8_t site, uint32_t size) {
+    heap_site_t *entry = &heap_prof.sites[site];
+    uint32_t class = heap_prof_class(size);
+
+    entry->live_bytes += size;
+    entry->live_count++;
+    entry->allocs++;
+    if (entry->live_bytes > entry->peak_bytes) {
+        entry->peak_bytes = entry->live_bytes;
+    }
+
+    heap_prof.allocs++;
+    heap_prof.live_bytes += size;
+    if (heap_prof.live_bytes > heap_prof.peak_bytes) {
+        heap_prof.peak_bytes = heap_prof.live_bytes;
+    }
+    heap_prof.class_allocs[class]++;
+    heap_prof.class_live[class]++;
+}
+
+/**
+ * @brief Учёт освобождения
+ * @param site Индекс места вызова, записанный при выделении
+ * @param size Полезный размер выделения
+ */
+void heap_prof_free(uint8_t site, uint32_t size) {
+    heap_site_t *entry = &heap_prof.sites[site];
+
+    entry->live_bytes -= size;
+    entry->live_count--;
+
+    heap_prof.frees++;
+    heap_prof.live_bytes -= size;
+    heap_prof.class_live[heap_prof_class(size)]--;
+}
+
+/**
+ * @brief Фрагментация свободной памяти кучи
+ *
+ * 0% - вся свободная память одним блоком, ближе к 100% - раздроблена
+ * на мелкие блоки: 100 - наибольший свободный блок / вся свободная память.
+ * @return Процент фрагментации
+ */
+uint32_t heap_fragmentation(const heap_t *heap) {
+    uint32_t free_bytes = heap->free_bytes;
+    uint32_t largest = heap_largest_free(heap);
+
+    if (!free_bytes) {
+        return 0;
+    }
+
+    /* Масштабируем, чтобы умножение на 100 не переполнилось */
+    while (free_bytes > 0x1000000) {
+        free_bytes >>= 1;
+        largest >>= 1;
+    }
+    return 100 - largest * 100 / free_bytes;
+}
+
+/**
+ * @brief Вывод счётчиков профилирования и top мест по занятым байтам
+ * @param top Количество выводимых мест
+ */
+void heap_prof_dump(uint32_t top) {
+    print_string("kmalloc profile:\n");
+    print_string("  - Live: ");
+    print_dec(heap_prof.live_bytes);
+    print_string(" bytes in ");
+    print_dec(heap_prof.allocs - heap_prof.frees);
+    print_string(" allocations (peak ");
+    print_dec(heap_prof.peak_bytes);
+    print_string(")\n  - Total: ");
+    print_dec(heap_prof.allocs);
+    print_string(" allocs, ");
+    print_dec(heap_prof.frees);
+    print_string(" frees, ");
+    print_dec(heap_prof.site_count);
+    print_string(" sites\n");
+
+    print_string("  - Heap free: ");
+    print_dec(kernel_heap.free_bytes);
+    print_string(" bytes, largest block ");
+    print_dec(heap_largest_free(&kernel_heap));
+    print_string(", fragmentation ");
+    print_dec(heap_fragmentation(&kernel_heap));
+    print_string("%\n");
+
+    print_string("Size classes (bytes: allocs/live):\n");
+    for (uint32_t class = 0; class < HEAP_PROF_CLASSES; class++) {
+        if (!heap_prof.class_allocs[class]) {
+            continue;
+        }
+        print_string("  - ");
+        print_dec(1u << class);
+        print_string("+: ");
+        print_dec(heap_prof.class_allocs[class]);
+        print_string("/");
+        print_dec(heap_prof.class_live[class]);
+        print_string("\n");
+    }
+
+    /* Выбор top мест по live_bytes: таблица мала, хватает простого выбора */
+    print_string("Top sites (live bytes, live/total allocs, peak):\n");
+    uint8_t shown[HEAP_PROF_SITES];
+    memory_set(shown, 0, sizeof(shown));
+
+    for (uint32_t n = 0; n < top; n++) {
+        int32_t best = -1;
+        for (uint32_t i = 0; i < HEAP_PROF_SITES; i++) {
+            const heap_site_t *site = &heap_prof.sites[i];
+            if (shown[i] || !site->allocs) {
+                continue;
+            }
+            if (best < 0 || site->live_bytes > heap_prof.sites[best].live_bytes) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        shown[best] = 1;
+
+        const heap_site_t *site = &heap_prof.sites[best];
+        print_string("  - ");
+        if (best == 0) {
+            print_string("(other)");
+        } else if (site->name) {
+            print_string(site->name);
+        } else {
+            print_hex((uint32_t)site->key);
+        }
+        print_string(": ");
+        print_dec(site->live_bytes);
+        print_string(", ");
+        print_dec(site->live_count);
+        print_string("/");
+        print_dec(site->allocs);
+        print_string(", ");
+        print_dec(site->peak_bytes);
+        print_string("\n");
+    }
+}
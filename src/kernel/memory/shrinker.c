@@ -0,0 +1,117 @@
+/**
+ * @file shrinker.c
+ * @brief Освобождение памяти под давлением через зарегистрированные источники
+ *
+ * Подсистемы, держащие память про запас (пустые слабы) или
+ * способные её вытеснить (zram), регистрируют shrinker с ценой страницы.
+ * shrink_memory обходит их от дешёвых к дорогим, пока не наберёт нужное
+ * число страниц. PMM вызывает её перед отказом в выделении и когда запас
+ * падает ниже PMM_MIN_WATERMARK; между LOW и HIGH работает фоновое
+ * освобождение из цикла простоя.
+ */
+
+#include "memory.h"
+#include "../video/video.h"
+#include "../cpu/cpu.h"
+
+/**
+ * @brief Регистрация источника освобождаемой памяти
+ *
+ * Список упорядочен по цене; при равной цене новый идёт последним.
+ * @param shrinker Описание (должно жить всё время работы ядра)
+ */
+void shrinker_register(shrinker_t *shrinker) {
+    shrinker_t **link = &physical_memory_manager.shrinkers;
+    while (*link && (*link)->cost <= shrinker->cost) {
+        link = &(*link)->next;
+    }
+    shrinker->next = *link;
+    *link = shrinker;
+}
+
+/**
+ * @brief Освобождение памяти источниками от дешёвых к дорогим
+ *
+ * Выделения внутри источников (например, слабы zram) не запускают
+ * освобождение повторно.
+ * @param target Сколько страниц нужно
+ * @return Освобождено страниц
+ */
+uint32_t shrink_memory(uint32_t target) {
+    pmm_t *pmm = &physical_memory_manager;
+    if (pmm->reclaiming) {
+        return 0;
+    }
+    pmm->reclaiming = 1;
+
+    uint32_t freed = 0;
+    for (shrinker_t *shrinker = pmm->shrinkers; shrinker && freed < target; shrinker = shrinker->next) {
+        uint64_t start = rdtsc();
+        uint32_t pages = shrinker->scan(target - freed);
+        uint32_t spent = (uint32_t)(rdtsc() - start);
+
+        shrinker->calls++;
+        shrinker->freed += pages;
+        shrinker->cycles += spent % 1000;
+        shrinker->kcycles += spent / 1000 + shrinker->cycles / 1000;
+        shrinker->cycles %= 1000;
+        freed += pages;
+    }
+
+    pmm->reclaiming = 0;
+    return freed;
+}
+
+/**
+ * @brief Порция фонового освобождения для цикла простоя
+ *
+ * Работает, пока запас ниже PMM_HIGH_WATERMARK и источникам есть что отдать.
+ * @return 1, если работа ещё осталась
+ */
+int shrink_background(void) {
+    pmm_t *pmm = &physical_memory_manager;
+    if (!pmm->reclaim_wanted) {
+        return 0;
+    }
+
+    if (pmm_get_free_pages_count() >= PMM_HIGH_WATERMARK || !shrink_memory(PMM_RECLAIM_BATCH)) {
+        pmm->reclaim_wanted = 0;
+        return 0;
+    }
+    pmm->background_reclaims++;
+    return 1;
+}
+
+/**
+ * @brief Вывод источников освобождаемой памяти и их счётчиков
+ */
+void shrinker_dump_info(void) {
+    pmm_t *pmm = &physical_memory_manager;
+    print_string("  - Reclaim: ");
+    print_dec(pmm->direct_reclaims);
+    print_string(" direct, ");
+    print_dec(pmm->background_reclaims);
+    print_string(" background, ");
+    print_dec(pmm->alloc_failures);
+    print_string(" failed allocations; watermarks ");
+    print_dec(PMM_MIN_WATERMARK);
+    print_string("/");
+    print_dec(PMM_LOW_WATERMARK);
+    print_string("/");
+    print_dec(PMM_HIGH_WATERMARK);
+    print_string(" pages\n");
+
+    for (shrinker_t *shrinker = pmm->shrinkers; shrinker; shrinker = shrinker->next) {
+        print_string("    ");
+        print_string(shrinker->name);
+        print_string(" (cost ");
+        print_dec(shrinker->cost);
+        print_string("): ");
+        print_dec(shrinker->calls);
+        print_string(" calls, ");
+        print_dec(shrinker->freed);
+        print_string(" pages freed, ");
+        print_dec(shrinker->kcycles);
+        print_string("K cycles\n");
+    }
+}
@@ -0,0 +1,432 @@
+/**
+ * @file slab.c
+ * @brief Slab-аллокатор для объектов фиксированного размера
+ *
+ * Каждый слаб - одна физическая страница из PMM: в начале страницы лежит
+ * заголовок kmem_slab_t с битовой картой свободных объектов, за ним - сами
+ * объекты. Поэтому у объекта нет собственного заголовка, а слаб находится
+ * по адресу объекта выравниванием вниз до страницы.
+ *
+ * Кэши степеней двойки 8..512 байт обслуживают kmalloc для размеров
+ * HEAP_SMALL и HEAP_MEDIUM; kmem_cache_create создаёт кэши для
+ * произвольных объектов ядра. У кэшей kmalloc в конце страницы слаба
+ * лежит байт метки на каждый объект - место вызова для heap_prof.
+ * Пустые слабы, придержанные кэшами про запас, отдаёт shrinker "slab".
+ */
+
+#include "memory.h"
+#include "../video/video.h"
+
+/* Кэши kmalloc: 8, 16, 32, 64, 128, 256, 512 байт */
+static kmem_cache_t kmalloc_caches[SLAB_KMALLOC_CACHES];
+
+/* Кэш дескрипторов для kmem_cache_create */
+static kmem_cache_t cache_cache;
+
+/* Список всех кэшей для slab_dump_info */
+static kmem_cache_t *cache_list;
+
+/* Имена кэшей kmalloc */
+static const char *kmalloc_cache_names[SLAB_KMALLOC_CACHES] = {
+    "kmalloc-8", "kmalloc-16", "kmalloc-32", "kmalloc-64",
+    "kmalloc-128", "kmalloc-256", "kmalloc-512"
+};
+
+/**
+ * @brief Заполнение дескриптора кэша
+ */
+static void slab_cache_setup(kmem_cache_t *cache, const char *name, uint32_t size,
+                             uint32_t align, uint32_t flags) {
+    if (align < SLAB_MIN_SIZE) {
+        align = SLAB_MIN_SIZE;
+    }
+
+    memory_set(cache, 0, sizeof(kmem_cache_t));
+    cache->name = name;
+    cache->flags = flags;
+    cache->object_size = align_up(size, align);
+    cache->first_offset = align_up(sizeof(kmem_slab_t), align);
+
+    /* Байты меток занимают конец страницы, по одному на объект */
+    uint32_t slot = cache->object_size + ((flags & SLAB_CACHE_TAGGED) ? 1 : 0);
+    cache->objects_per_slab = (PAGE_SIZE - cache->first_offset) / slot;
+    if (cache->objects_per_slab > SLAB_MAX_OBJECTS) {
+        cache->objects_per_slab = SLAB_MAX_OBJECTS;
+    }
+
+    cache->next = cache_list;
+    cache_list = cache;
+}
+
+/**
+ * @brief Включение слаба в начало списка
+ */
+static void slab_list_add(kmem_slab_t **list, kmem_slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+/**
+ * @brief Исключение слаба из списка
+ */
+static void slab_list_remove(kmem_slab_t **list, kmem_slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+/**
+ * @brief Создание нового слаба из страницы PMM
+ * @return Слаб со всеми объектами свободными или NULL
+ */
+static kmem_slab_t* slab_create(kmem_cache_t *cache) {
+    uint32_t page = pmm_alloc_page();
+    if (!page) {
+        return NULL;
+    }
+    pmm_set_page_flags(page, 1, PG_SLAB);
+
+    kmem_slab_t *slab = (kmem_slab_t*)page;
+    memory_set(slab, 0, sizeof(kmem_slab_t));
+    slab->magic = SLAB_MAGIC;
+    slab->cache = cache;
+
+    /* Биты всех существующих объектов - свободны */
+    uint32_t full_words = cache->objects_per_slab / 32;
+    for (uint32_t i = 0; i < full_words; i++) {
+        slab->free_map[i] = 0xFFFFFFFF;
+    }
+    if (cache->objects_per_slab % 32) {
+        slab->free_map[full_words] = (1u << (cache->objects_per_slab % 32)) - 1;
+    }
+
+    cache->slabs++;
+    return slab;
+}
+
+/**
+ * @brief Возврат пустого слаба в PMM
+ */
+static void slab_destroy(kmem_cache_t *cache, kmem_slab_t *slab) {
+    slab->magic = 0;
+    cache->slabs--;
+    pmm_free_page((uint32_t)slab);
+}
+
+/**
+ * @brief Слаб, которому принадлежит объект
+ * @return Слаб или NULL, если адрес не похож на объект слаба
+ */
+static kmem_slab_t* slab_of(const void *obj) {
+    kmem_slab_t *slab = (kmem_slab_t*)((uint32_t)obj & PAGE_MASK);
+
+    if ((uint32_t)obj == (uint32_t)slab || slab->magic != SLAB_MAGIC) {
+        return NULL;
+    }
+    return slab;
+}
+
+/**
+ * @brief Shrinker: пустые слабы всех кэшей
+ */
+static uint32_t slab_shrink(uint32_t target) {
+    uint32_t freed = 0;
+    for (kmem_cache_t *cache = cache_list; cache && freed < target; cache = cache->next) {
+        freed += kmem_cache_shrink(cache);
+    }
+    return freed;
+}
+
+static shrinker_t slab_shrinker = { .name = "slab", .cost = SHRINKER_COST_SLAB, .scan = slab_shrink };
+
+/**
+ * @brief Инициализация slab-аллокатора и кэшей kmalloc
+ */
+void slab_init(void) {
+    cache_list = NULL;
+    slab_cache_setup(&cache_cache, "kmem_cache", sizeof(kmem_cache_t), SLAB_MIN_SIZE, 0);
+
+    uint32_t size = SLAB_MIN_SIZE;
+    for (uint32_t i = 0; i < SLAB_KMALLOC_CACHES; i++) {
+        slab_cache_setup(&kmalloc_caches[i], kmalloc_cache_names[i], size, SLAB_MIN_SIZE,
+                         SLAB_CACHE_TAGGED);
+        size <<= 1;
+    }
+    shrinker_register(&slab_shrinker);
+}
+
+/**
+ * @brief Создание кэша объектов фиксированного размера
+ * @param name Имя кэша (строка должна жить всё время жизни кэша)
+ * @param size Размер объекта в байтах
+ * @param align Выравнивание объектов (степень двойки, минимум 8)
+ * @return Кэш или NULL, если объект не помещается в слаб
+ */
+kmem_cache_t* kmem_cache_create(const char *name, uint32_t size, uint32_t align) {
+    if (size == 0 || align_up(sizeof(kmem_slab_t), align) + align_up(size, align) > PAGE_SIZE) {
+        return NULL;
+    }
+
+    kmem_cache_t *cache = kmem_cache_alloc(&cache_cache);
+    if (!cache) {
+        return NULL;
+    }
+
+    slab_cache_setup(cache, name, size, align, 0);
+    return cache;
+}
+
+/**
+ * @brief Уничтожение кэша
+ *
+ * Кэш с живыми объектами не уничтожается.
+ * @return 0 при успехе, -1 если в кэше остались объекты
+ */
+int kmem_cache_destroy(kmem_cache_t *cache) {
+    if (!cache || cache->active_objects != 0) {
+        return -1;
+    }
+
+    while (cache->empty) {
+        kmem_slab_t *slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        slab_destroy(cache, slab);
+    }
+
+    /* Убираем кэш из общего списка */
+    kmem_cache_t **link = &cache_list;
+    while (*link && *link != cache) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = cache->next;
+    }
+
+    kmem_cache_free(&cache_cache, cache);
+    return 0;
+}
+
+/**
+ * @brief Возврат пустых слабов кэша в PMM
+ * @return Освобождено страниц
+ */
+uint32_t kmem_cache_shrink(kmem_cache_t *cache) {
+    uint32_t freed = 0;
+    while (cache->empty) {
+        kmem_slab_t *slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        slab_destroy(cache, slab);
+        freed++;
+    }
+    cache->empty_slabs = 0;
+    return freed;
+}
+
+/**
+ * @brief Выделение объекта из кэша
+ *
+ * Берётся частично занятый слаб, затем пустой, затем новая страница.
+ * Свободный объект находится по битовой карте слаба через __builtin_ctz.
+ * @return Указатель на объект или NULL
+ */
+void* kmem_cache_alloc(kmem_cache_t *cache) {
+    kmem_slab_t *slab = cache->partial;
+
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+            cache->empty_slabs--;
+        } else {
+            slab = slab_create(cache);
+            if (!slab) {
+                return NULL;
+            }
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    /* Слово-подсказка указывает на первое слово, где могут быть свободные объекты */
+    uint32_t word = slab->free_hint;
+    while (slab->free_map[word] == 0) {
+        word++;
+    }
+    uint32_t bit = __builtin_ctz(slab->free_map[word]);
+    slab->free_map[word] &= ~(1u << bit);
+    slab->free_hint = word;
+    slab->inuse++;
+    cache->active_objects++;
+
+    if (slab->inuse == cache->objects_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    uint32_t index = word * 32 + bit;
+    return (uint8_t*)slab + cache->first_offset + index * cache->object_size;
+}
+
+/**
+ * @brief Возврат объекта в кэш
+ *
+ * Если в кэше уже есть пустой слаб про запас, новый пустой слаб
+ * сразу возвращается в PMM.
+ */
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    kmem_slab_t *slab = slab_of(obj);
+    if (!slab || slab->cache != cache) {
+        return; /* Чужой или некорректный указатель */
+    }
+
+    uint32_t offset = (uint32_t)obj - (uint32_t)slab - cache->first_offset;
+    uint32_t index = offset / cache->object_size;
+    if (offset % cache->object_size || index >= cache->objects_per_slab) {
+        return;
+    }
+
+    uint32_t word = index / 32;
+    uint32_t bit = 1u << (index % 32);
+    if (slab->free_map[word] & bit) {
+        return; /* Объект уже свободен */
+    }
+
+    int was_full = slab->inuse == cache->objects_per_slab;
+    slab->free_map[word] |= bit;
+    if (word < slab->free_hint) {
+        slab->free_hint = word;
+    }
+    slab->inuse--;
+    cache->active_objects--;
+
+    if (was_full) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    if (slab->inuse == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty_slabs < SLAB_MAX_EMPTY) {
+            slab_list_add(&cache->empty, slab);
+            cache->empty_slabs++;
+        } else {
+            slab_destroy(cache, slab);
+        }
+    }
+}
+
+/**
+ * @brief Кэш kmalloc для заданного размера
+ * @return Кэш или NULL, если размер больше SLAB_MAX_SIZE
+ */
+static kmem_cache_t* slab_kmalloc_cache(size_t size) {
+    uint32_t index = 0;
+    uint32_t cache_size = SLAB_MIN_SIZE;
+
+    while (cache_size < size) {
+        cache_size <<= 1;
+        index++;
+    }
+    return index < SLAB_KMALLOC_CACHES ? &kmalloc_caches[index] : NULL;
+}
+
+/**
+ * @brief Индекс занятого объекта в слабе
+ * @return Индекс или -1, если адрес не указывает на занятый объект
+ */
+static int32_t slab_object_index(const kmem_slab_t *slab, const void *obj) {
+    const kmem_cache_t *cache = slab->cache;
+    uint32_t offset = (uint32_t)obj - (uint32_t)slab - cache->first_offset;
+    uint32_t index = offset / cache->object_size;
+
+    if (offset % cache->object_size || index >= cache->objects_per_slab ||
+        (slab->free_map[index / 32] & (1u << (index % 32)))) {
+        return -1;
+    }
+    return index;
+}
+
+/**
+ * @brief Выделение памяти из кэшей kmalloc (HEAP_SMALL и HEAP_MEDIUM)
+ * @param size Размер в байтах (1..SLAB_MAX_SIZE)
+ * @return Указатель или NULL
+ */
+void* slab_kmalloc(size_t size) {
+    kmem_cache_t *cache = slab_kmalloc_cache(size);
+    return cache ? kmem_cache_alloc(cache) : NULL;
+}
+
+/**
+ * @brief Освобождение объекта, полученного через kmalloc
+ * @return 1, если указатель принадлежал слабу, иначе 0
+ */
+int slab_kfree(void *ptr) {
+    kmem_slab_t *slab = slab_of(ptr);
+    if (!slab) {
+        return 0;
+    }
+
+    /* Обнуляем содержимое объекта, если включён heap_scrub */
+    if (kernel_heap.scrub) {
+        memory_set(ptr, 0, slab->cache->object_size);
+    }
+    kmem_cache_free(slab->cache, ptr);
+    return 1;
+}
+
+/**
+ * @brief Размер объекта слаба
+ * @return Размер объекта или 0, если указатель не принадлежит слабу
+ */
+uint32_t slab_object_size(const void *ptr) {
+    kmem_slab_t *slab = slab_of(ptr);
+    return slab ? slab->cache->object_size : 0;
+}
+
+/**
+ * @brief Байт метки занятого объекта кэша kmalloc
+ * @return Указатель на метку или NULL, если объект не из кэша kmalloc или свободен
+ */
+uint8_t* slab_object_tag(const void *ptr) {
+    kmem_slab_t *slab = slab_of(ptr);
+    if (!slab || !(slab->cache->flags & SLAB_CACHE_TAGGED)) {
+        return NULL;
+    }
+
+    int32_t index = slab_object_index(slab, ptr);
+    if (index < 0) {
+        return NULL;
+    }
+    return (uint8_t*)slab + PAGE_SIZE - slab->cache->objects_per_slab + index;
+}
+
+/**
+ * @brief Вывод информации о кэшах slab-аллокатора
+ */
+void slab_dump_info(void) {
+    print_string("Slab caches (name: objects/capacity, slabs):\n");
+
+    for (kmem_cache_t *cache = cache_list; cache; cache = cache->next) {
+        print_string("  - ");
+        print_string(cache->name);
+        print_string(": ");
+        print_dec(cache->active_objects);
+        print_string("/");
+        print_dec(cache->slabs * cache->objects_per_slab);
+        print_string(", ");
+        print_dec(cache->slabs);
+        print_string(" slabs (");
+        print_dec(cache->object_size);
+        print_string(" bytes each)\n");
+    }
+}
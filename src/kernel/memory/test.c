@@ -1,134 +1,1794 @@
 /**
  * @file test.c
- * @brief Тесты для менеджера памяти
- * 
- * Демонстрация работы Physical Memory Manager и Kernel Heap
+ * @brief Бенчмарки и стресс-тесты менеджера памяти
+ *
+ * pmmbench и heapbench замеряют отдельные аллокаторы, membench прогоняет
+ * воспроизводимые (с фиксированным зерном) трассы выделений через kmalloc,
+ * PMM и арену, проверяет содержимое блоков и инварианты кучи и пишет
+ * результаты в COM1 в машиночитаемом виде.
  */
 
 #include "memory.h"
 #include "../video/video.h"
+#include "../cpu/cpu.h"
+#include "../drivers/serial.h"
+#include "../drivers/pit.h"
+#include "../drivers/clock.h"
+
+/* Количество пар alloc/free в одном замере pmmbench */
+#define PMM_BENCH_ROUNDS 1000
+
+/* Порядок и количество непрерывных блоков в замере */
+#define PMM_BENCH_ORDER 4
+#define PMM_BENCH_BLOCKS 64
+
+/* Страницы, выделяемые в замере */
+static uint32_t pmm_bench_pages[PMM_BENCH_ROUNDS];
+
+/* Генератор псевдослучайных чисел xorshift32 */
+static uint32_t bench_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
 
 /**
- * @brief Тест Physical Memory Manager
- */
-void test_pmm(void) {
-    print_string("\n=== Physical Memory Manager Test ===\n");
-    
-    /* Выводим информацию о PMM */
-    pmm_dump_info();
-    
-    /* Тестируем выделение страниц */
-    print_string("\nAllocating pages...\n");
-    uint32_t page1 = pmm_alloc_page();
-    uint32_t page2 = pmm_alloc_page();
-    uint32_t page3 = pmm_alloc_page();
-    
-    if (page1 && page2 && page3) {
-        print_string("  - Page 1: 0x");
-        print_hex(page1);
-        print_string("\n  - Page 2: 0x");
-        print_hex(page2);
-        print_string("\n  - Page 3: 0x");
-        print_hex(page3);
-        print_string("\n");
-        
-        /* Заполняем страницы данными */
-        memory_set((void*)page1, 0xAA, PAGE_SIZE);
-        memory_set((void*)page2, 0xBB, PAGE_SIZE);
-        memory_set((void*)page3, 0xCC, PAGE_SIZE);
-        
-        print_string("Pages filled with test data\n");
-        
-        /* Освобождаем страницы */
-        print_string("Freeing pages...\n");
-        pmm_free_page(page2);
-        pmm_free_page(page1);
-        pmm_free_page(page3);
-        
-        print_string("Pages freed successfully\n");
+ * @brief Замер стоимости pmm_alloc_page/pmm_free_page при заданной занятости
+ *
+ * Занимает всю свободную память, затем освобождает случайные страницы,
+ * пока не останется occupancy процентов, чтобы свободные страницы были
+ * разбросаны по всей памяти. Занятые страницы связываются в список через
+ * их первое слово, поэтому замеру не нужна куча.
+ * @param occupancy Доля занятой памяти в процентах
+ */
+static void pmm_benchmark_at(uint32_t occupancy) {
+    uint32_t seed = 0x9E3779B9 ^ occupancy;
+    uint32_t held = 0;
+    uint32_t page;
+
+    /* Забираем всю свободную память */
+    while ((page = pmm_alloc_page()) != 0) {
+        *(uint32_t*)page = held;
+        held = page;
+    }
+
+    /* Случайно возвращаем (100 - occupancy)% страниц */
+    uint32_t kept = 0;
+    while (held) {
+        uint32_t next = *(uint32_t*)held;
+        if (bench_random(&seed) % 100 < occupancy) {
+            *(uint32_t*)held = kept;
+            kept = held;
+        } else {
+            pmm_free_page(held);
+        }
+        held = next;
+    }
+
+    uint32_t rounds = pmm_get_free_pages_count() / 2;
+    if (rounds > PMM_BENCH_ROUNDS) {
+        rounds = PMM_BENCH_ROUNDS;
+    }
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < rounds; i++) {
+        pmm_bench_pages[i] = pmm_alloc_page();
+    }
+    uint64_t middle = rdtsc();
+    for (uint32_t i = 0; i < rounds; i++) {
+        pmm_free_page(pmm_bench_pages[i]);
+    }
+    uint64_t end = rdtsc();
+
+    print_string("  - ");
+    print_dec(occupancy);
+    print_string("% used: alloc ");
+    print_dec(rounds ? (uint32_t)(middle - start) / rounds : 0);
+    print_string(" cycles, free ");
+    print_dec(rounds ? (uint32_t)(end - middle) / rounds : 0);
+    print_string(" cycles (");
+    print_dec(rounds);
+    print_string(" ops)\n");
+
+    /* Непрерывные блоки по 16 страниц на той же фрагментированной памяти */
+    uint32_t blocks = 0;
+    start = rdtsc();
+    while (blocks < PMM_BENCH_BLOCKS &&
+           (pmm_bench_pages[blocks] = pmm_alloc_pages(PMM_BENCH_ORDER)) != 0) {
+        blocks++;
+    }
+    middle = rdtsc();
+    for (uint32_t i = 0; i < blocks; i++) {
+        pmm_free_pages(pmm_bench_pages[i], PMM_BENCH_ORDER);
+    }
+    end = rdtsc();
+
+    print_string("    order ");
+    print_dec(PMM_BENCH_ORDER);
+    print_string(": alloc ");
+    print_dec(blocks ? (uint32_t)(middle - start) / blocks : 0);
+    print_string(" cycles, free ");
+    print_dec(blocks ? (uint32_t)(end - middle) / blocks : 0);
+    print_string(" cycles (");
+    print_dec(blocks);
+    print_string(" blocks)\n");
+
+    /* Возвращаем удерживаемые страницы */
+    while (kept) {
+        uint32_t next = *(uint32_t*)kept;
+        pmm_free_page(kept);
+        kept = next;
+    }
+}
+
+/**
+ * @brief Бенчмарк PMM: такты на выделение/освобождение при 10%, 50% и 95% занятости
+ *
+ * Кроме одиночных страниц замеряются блоки порядка PMM_BENCH_ORDER,
+ * чтобы видеть стоимость непрерывных выделений при фрагментации.
+ */
+void pmm_benchmark(void) {
+    print_string("\nPMM benchmark (cycles per page):\n");
+    pmm_benchmark_at(10);
+    pmm_benchmark_at(50);
+    pmm_benchmark_at(95);
+}
+
+/* Параметры heapbench: живые блоки, замеряемые операции и размеры */
+#define HEAP_BENCH_LIVE 10000
+#define HEAP_BENCH_OPS 2000
+#define HEAP_BENCH_MIN 16
+#define HEAP_BENCH_MAX 512
+
+/* Эталонный блок списка first-fit (прежняя реализация кучи) */
+typedef struct ff_block {
+    uint32_t size;
+    uint8_t used;
+    struct ff_block *next;
+    struct ff_block *prev;
+} ff_block_t;
+
+static ff_block_t *ff_first;
+
+static void* heap_bench_live[HEAP_BENCH_LIVE];
+static uint32_t heap_bench_alloc_cycles[HEAP_BENCH_OPS];
+static uint32_t heap_bench_free_cycles[HEAP_BENCH_OPS];
+
+/**
+ * @brief Эталонный first-fit: один свободный блок на всю область
+ */
+static void ff_init(uint32_t start, uint32_t size) {
+    ff_first = (ff_block_t*)start;
+    ff_first->size = size - sizeof(ff_block_t);
+    ff_first->used = 0;
+    ff_first->next = NULL;
+    ff_first->prev = NULL;
+}
+
+/**
+ * @brief Эталонный first-fit: обход всех блоков от начала области
+ */
+static void* ff_alloc(uint32_t size) {
+    size = align_up(size, 8);
+    for (ff_block_t *block = ff_first; block; block = block->next) {
+        if (block->used || block->size < size) {
+            continue;
+        }
+        if (block->size >= size + sizeof(ff_block_t) + 8) {
+            ff_block_t *rest = (ff_block_t*)((uint8_t*)block + sizeof(ff_block_t) + size);
+            rest->size = block->size - size - sizeof(ff_block_t);
+            rest->used = 0;
+            rest->next = block->next;
+            rest->prev = block;
+            if (block->next) {
+                block->next->prev = rest;
+            }
+            block->next = rest;
+            block->size = size;
+        }
+        block->used = 1;
+        return (uint8_t*)block + sizeof(ff_block_t);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Эталонный first-fit: освобождение с объединением соседей
+ */
+static void ff_free(void *ptr) {
+    ff_block_t *block = (ff_block_t*)((uint8_t*)ptr - sizeof(ff_block_t));
+    block->used = 0;
+    if (block->next && !block->next->used) {
+        block->size += sizeof(ff_block_t) + block->next->size;
+        block->next = block->next->next;
+        if (block->next) {
+            block->next->prev = block;
+        }
+    }
+    if (block->prev && !block->prev->used) {
+        block->prev->size += sizeof(ff_block_t) + block->size;
+        block->prev->next = block->next;
+        if (block->next) {
+            block->next->prev = block->prev;
+        }
+    }
+}
+
+/**
+ * @brief Сортировка замеров (Шелл) для вычисления перцентилей
+ */
+static void bench_sort(uint32_t *values, uint32_t count) {
+    for (uint32_t gap = count / 2; gap > 0; gap /= 2) {
+        for (uint32_t i = gap; i < count; i++) {
+            uint32_t value = values[i];
+            uint32_t j = i;
+            while (j >= gap && values[j - gap] > value) {
+                values[j] = values[j - gap];
+                j -= gap;
+            }
+            values[j] = value;
+        }
+    }
+}
+
+/**
+ * @brief Вывод p50/p99 набора замеров
+ */
+static void bench_print_percentiles(const char *label, uint32_t *values, uint32_t count) {
+    bench_sort(values, count);
+    print_string(label);
+    print_string(" p50 ");
+    print_dec(count ? values[count / 2] : 0);
+    print_string(", p99 ");
+    print_dec(count ? values[count * 99 / 100] : 0);
+    print_string(" cycles");
+}
+
+/**
+ * @brief Один прогон heapbench для TLSF или эталонного first-fit
+ *
+ * Заполняет область HEAP_BENCH_LIVE живыми блоками случайных размеров
+ * (с выбросом части блоков, чтобы область была фрагментирована), затем
+ * замеряет каждую операцию замены случайного живого блока новым.
+ * @param name Название аллокатора
+ * @param use_tlsf 1 - TLSF (heap_alloc), 0 - эталонный список
+ * @param area Область памяти для кучи
+ * @param size Размер области
+ */
+static void heap_benchmark_run(const char *name, int use_tlsf, uint32_t area, uint32_t size) {
+    static heap_t bench_heap;
+    uint32_t seed = 0x2545F491;
+    uint32_t live = 0;
+
+    if (use_tlsf) {
+        heap_create(&bench_heap, area, size);
     } else {
-        print_string_color("Failed to allocate pages!\n", COLOR_RED, COLOR_BLACK);
-    }
-    
-    /* Выводим финальную информацию */
-    print_string("Final PMM status:\n");
-    pmm_dump_info();
-}
-
-/**
- * @brief Тест Kernel Heap
- */
-void test_heap(void) {
-    print_string("\n=== Kernel Heap Test ===\n");
-    
-    /* Выводим информацию о куче */
-    heap_dump_info();
-    
-    /* Тестируем kmalloc */
-    print_string("\nTesting kmalloc...\n");
-    
-    char* str1 = (char*)kmalloc(64);
-    char* str2 = (char*)kmalloc(128);
-    char* str3 = (char*)kmalloc(256);
-    
-    if (str1 && str2 && str3) {
-        print_string("  - Allocated 64 bytes at 0x");
-        print_hex((uint32_t)str1);
-        print_string("\n  - Allocated 128 bytes at 0x");
-        print_hex((uint32_t)str2);
-        print_string("\n  - Allocated 256 bytes at 0x");
-        print_hex((uint32_t)str3);
-        print_string("\n");
-        
-        /* Заполняем строки */
-        memory_copy(str1, "Hello from kernel heap!", 22);
-        memory_copy(str2, "This is a longer string to test heap allocation", 45);
-        memory_copy(str3, "And this is an even longer string to test larger allocations", 58);
-        
-        print_string("  - String 1: ");
-        print_string(str1);
-        print_string("\n  - String 2: ");
-        print_string(str2);
-        print_string("\n  - String 3: ");
-        print_string(str3);
+        ff_init(area, size);
+    }
+
+    /* Каждый третий блок сразу освобождается, оставляя дыры */
+    while (live < HEAP_BENCH_LIVE) {
+        uint32_t block_size = HEAP_BENCH_MIN + bench_random(&seed) % (HEAP_BENCH_MAX - HEAP_BENCH_MIN);
+        void *ptr = use_tlsf ? heap_alloc(&bench_heap, block_size) : ff_alloc(block_size);
+        if (!ptr) {
+            break;
+        }
+        if (bench_random(&seed) % 3 == 0) {
+            if (use_tlsf) {
+                heap_free(&bench_heap, ptr);
+            } else {
+                ff_free(ptr);
+            }
+        } else {
+            heap_bench_live[live++] = ptr;
+        }
+    }
+
+    uint32_t ops = 0;
+    while (ops < HEAP_BENCH_OPS && live) {
+        uint32_t victim = bench_random(&seed) % live;
+        uint32_t block_size = HEAP_BENCH_MIN + bench_random(&seed) % (HEAP_BENCH_MAX - HEAP_BENCH_MIN);
+
+        uint64_t start = rdtsc();
+        if (use_tlsf) {
+            heap_free(&bench_heap, heap_bench_live[victim]);
+        } else {
+            ff_free(heap_bench_live[victim]);
+        }
+        uint64_t middle = rdtsc();
+        void *ptr = use_tlsf ? heap_alloc(&bench_heap, block_size) : ff_alloc(block_size);
+        uint64_t end = rdtsc();
+
+        if (!ptr) {
+            heap_bench_live[victim] = heap_bench_live[--live];
+            continue;
+        }
+        heap_bench_live[victim] = ptr;
+        heap_bench_free_cycles[ops] = (uint32_t)(middle - start);
+        heap_bench_alloc_cycles[ops] = (uint32_t)(end - middle);
+        ops++;
+    }
+
+    print_string("  - ");
+    print_string(name);
+    print_string(" (");
+    print_dec(live);
+    print_string(" live):\n");
+    bench_print_percentiles("    alloc", heap_bench_alloc_cycles, ops);
+    print_string("\n");
+    bench_print_percentiles("    free ", heap_bench_free_cycles, ops);
+    print_string("\n");
+}
+
+/**
+ * @brief Бенчмарк кучи: p50/p99 тактов TLSF против прежнего first-fit списка
+ *
+ * Обе кучи по очереди размещаются в одном блоке PMM наибольшего порядка,
+ * поэтому замер не трогает кучу ядра.
+ */
+void heap_benchmark(void) {
+    uint32_t size = PMM_MAX_BLOCK_PAGES * PAGE_SIZE;
+    uint32_t area = pmm_alloc_pages(PMM_MAX_ORDER);
+    if (!area) {
+        print_string_color("heapbench: no free 4MB block\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+
+    print_string("\nHeap benchmark (cycles per operation):\n");
+    heap_benchmark_run("TLSF", 1, area, size);
+    heap_benchmark_run("first-fit list", 0, area, size);
+
+    pmm_free_pages(area, PMM_MAX_ORDER);
+}
+
+/* Параметры membench */
+#define MEMBENCH_SEED 0x2545F491     /* Зерно трасс: прогоны воспроизводимы */
+#define MEMBENCH_OPS 8192            /* Операций в трассе */
+#define MEMBENCH_SLOTS 1024          /* Слотов живых выделений */
+#define MEMBENCH_CHECK_EVERY 512     /* Период вызова heap_check */
+#define MEMBENCH_MAX_SIZE 2048       /* Наибольший размер в равномерной трассе */
+#define MEMBENCH_POW_MIN 16          /* Наименьший размер степенного распределения */
+#define MEMBENCH_POW_CLASSES 13      /* 16 байт .. 128KB */
+#define MEMBENCH_PMM_ORDERS 4        /* Порядки 0..3 в трассе PMM */
+#define MEMBENCH_ARENA_RESET 256     /* Выделений арены между сбросами */
+
+/* Состояние трассы */
+static uint8_t *membench_ptr[MEMBENCH_SLOTS];
+static uint32_t membench_size[MEMBENCH_SLOTS];
+static uint32_t membench_alloc_cycles[MEMBENCH_OPS];
+static uint32_t membench_free_cycles[MEMBENCH_OPS];
+static uint32_t membench_realloc_cycles[MEMBENCH_OPS];
+static uint32_t membench_alloc_ops;
+static uint32_t membench_free_ops;
+static uint32_t membench_realloc_ops;
+static uint32_t membench_errors;
+static uint32_t membench_seed;
+
+/**
+ * @brief Байт-узор слота: зависит от адреса и размера, чтобы ловить перекрытия
+ */
+static uint8_t membench_pattern(const uint8_t *ptr, uint32_t size) {
+    return (uint8_t)(((uint32_t)ptr >> 3) ^ size ^ 0x5A);
+}
+
+/**
+ * @brief Заполнение начала и конца выделения узором
+ */
+static void membench_fill(uint8_t *ptr, uint32_t size) {
+    uint8_t pattern = membench_pattern(ptr, size);
+    uint32_t head = size < 16 ? size : 16;
+    memory_set(ptr, pattern, head);
+    ptr[size - 1] = pattern;
+}
+
+/**
+ * @brief Проверка узора; при порче увеличивает счётчик ошибок
+ * @param ptr Текущий адрес данных
+ * @param origin Адрес, по которому узор был записан
+ * @param size Размер, с которым узор был записан
+ * @param verify_size Сколько байт должно было сохраниться
+ */
+static void membench_verify(const uint8_t *ptr, const uint8_t *origin, uint32_t size, uint32_t verify_size) {
+    uint8_t pattern = membench_pattern(origin, size);
+    uint32_t head = verify_size < 16 ? verify_size : 16;
+
+    for (uint32_t i = 0; i < head; i++) {
+        if (ptr[i] != pattern) {
+            membench_errors++;
+            return;
+        }
+    }
+    if (verify_size == size && ptr[size - 1] != pattern) {
+        membench_errors++;
+    }
+}
+
+/**
+ * @brief Сброс состояния перед трассой
+ */
+static void membench_begin(void) {
+    memory_set(membench_ptr, 0, sizeof(membench_ptr));
+    membench_alloc_ops = 0;
+    membench_free_ops = 0;
+    membench_realloc_ops = 0;
+    membench_seed = MEMBENCH_SEED;
+}
+
+/**
+ * @brief Периодическая проверка инвариантов кучи ядра
+ */
+static void membench_check(uint32_t op) {
+    if (op % MEMBENCH_CHECK_EVERY == 0 && heap_check(&kernel_heap) != 0) {
+        membench_errors++;
+    }
+}
+
+/**
+ * @brief Замеренное выделение kmalloc в слот
+ */
+static void membench_alloc(uint32_t slot, uint32_t size) {
+    uint64_t start = rdtsc();
+    uint8_t *ptr = (uint8_t*)kmalloc(size);
+    uint64_t end = rdtsc();
+
+    if (!ptr) {
+        membench_errors++;
+        return;
+    }
+    membench_alloc_cycles[membench_alloc_ops++] = (uint32_t)(end - start);
+    membench_fill(ptr, size);
+    membench_ptr[slot] = ptr;
+    membench_size[slot] = size;
+}
+
+/**
+ * @brief Замеренное освобождение слота с проверкой узора
+ */
+static void membench_free(uint32_t slot) {
+    uint8_t *ptr = membench_ptr[slot];
+    membench_verify(ptr, ptr, membench_size[slot], membench_size[slot]);
+
+    uint64_t start = rdtsc();
+    kfree(ptr);
+    uint64_t end = rdtsc();
+
+    membench_free_cycles[membench_free_ops++] = (uint32_t)(end - start);
+    membench_ptr[slot] = NULL;
+}
+
+/**
+ * @brief Замеренный krealloc слота: сохранённая часть должна уцелеть
+ */
+static void membench_realloc(uint32_t slot, uint32_t size) {
+    uint8_t *old = membench_ptr[slot];
+    uint32_t old_size = membench_size[slot];
+
+    uint64_t start = rdtsc();
+    uint8_t *ptr = (uint8_t*)krealloc(old, size);
+    uint64_t end = rdtsc();
+
+    if (!ptr) {
+        membench_errors++;
+        return;
+    }
+    membench_realloc_cycles[membench_realloc_ops++] = (uint32_t)(end - start);
+    membench_verify(ptr, old, old_size, size < old_size ? size : old_size);
+    membench_fill(ptr, size);
+    membench_ptr[slot] = ptr;
+    membench_size[slot] = size;
+}
+
+/**
+ * @brief Освобождение всех оставшихся слотов
+ */
+static void membench_drain(void) {
+    for (uint32_t slot = 0; slot < MEMBENCH_SLOTS; slot++) {
+        if (membench_ptr[slot]) {
+            membench_free(slot);
+        }
+    }
+}
+
+/**
+ * @brief Вывод min/p50/p99 одной операции на экран и в COM1
+ *
+ * Строка в COM1: "membench trace=<t> op=<op> n=<n> min=<c> p50=<c> p99=<c>".
+ */
+static void membench_report(const char *trace, const char *op, uint32_t *values, uint32_t count) {
+    if (!count) {
+        return;
+    }
+
+    bench_sort(values, count);
+    uint32_t min = values[0];
+    uint32_t p50 = values[count / 2];
+    uint32_t p99 = values[count * 99 / 100];
+
+    print_string("  - ");
+    print_string(trace);
+    print_string(" ");
+    print_string(op);
+    print_string(": min ");
+    print_dec(min);
+    print_string(", p50 ");
+    print_dec(p50);
+    print_string(", p99 ");
+    print_dec(p99);
+    print_string(" cycles (");
+    print_dec(count);
+    print_string(" ops)\n");
+
+    serial_write_string("membench trace=");
+    serial_write_string(trace);
+    serial_write_string(" op=");
+    serial_write_string(op);
+    serial_write_string(" n=");
+    serial_write_dec(count);
+    serial_write_string(" min=");
+    serial_write_dec(min);
+    serial_write_string(" p50=");
+    serial_write_dec(p50);
+    serial_write_string(" p99=");
+    serial_write_dec(p99);
+    serial_write_string("\n");
+}
+
+/**
+ * @brief Отчёт по трассе kmalloc и проверка утечек
+ * @param live_before heap_prof.live_bytes до трассы
+ */
+static void membench_finish(const char *trace, uint32_t live_before) {
+    membench_drain();
+    if (heap_check(&kernel_heap) != 0 || heap_prof.live_bytes != live_before) {
+        membench_errors++;
+    }
+
+    membench_report(trace, "alloc", membench_alloc_cycles, membench_alloc_ops);
+    membench_report(trace, "free", membench_free_cycles, membench_free_ops);
+    membench_report(trace, "realloc", membench_realloc_cycles, membench_realloc_ops);
+}
+
+/**
+ * @brief Трасса "random": случайные alloc/free/realloc, размеры 1..2048
+ */
+static void membench_random(void) {
+    uint32_t live_before = heap_prof.live_bytes;
+    membench_begin();
+
+    for (uint32_t op = 0; op < MEMBENCH_OPS; op++) {
+        uint32_t slot = bench_random(&membench_seed) % MEMBENCH_SLOTS;
+        uint32_t size = 1 + bench_random(&membench_seed) % MEMBENCH_MAX_SIZE;
+
+        if (!membench_ptr[slot]) {
+            membench_alloc(slot, size);
+        } else if (bench_random(&membench_seed) % 3 == 0) {
+            membench_realloc(slot, size);
+        } else {
+            membench_free(slot);
+        }
+        membench_check(op);
+    }
+
+    membench_finish("random", live_before);
+}
+
+/**
+ * @brief Трасса "prodcons": производитель и потребитель через очередь
+ *
+ * Пачки выделений в голове очереди чередуются с пачками освобождений
+ * в хвосте, как у буферов, передаваемых между подсистемами.
+ */
+static void membench_prodcons(void) {
+    uint32_t live_before = heap_prof.live_bytes;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    membench_begin();
+
+    for (uint32_t op = 0; op < MEMBENCH_OPS;) {
+        uint32_t burst = 1 + bench_random(&membench_seed) % 8;
+        for (uint32_t i = 0; i < burst && head - tail < MEMBENCH_SLOTS; i++, op++) {
+            uint32_t size = 32 + bench_random(&membench_seed) % 1500; /* Размер пакета */
+            membench_alloc(head++ % MEMBENCH_SLOTS, size);
+        }
+
+        burst = 1 + bench_random(&membench_seed) % 8;
+        for (uint32_t i = 0; i < burst && tail != head; i++, op++) {
+            uint32_t slot = tail++ % MEMBENCH_SLOTS;
+            if (membench_ptr[slot]) {
+                membench_free(slot);
+            }
+        }
+        membench_check(op);
+    }
+
+    membench_finish("prodcons", live_before);
+}
+
+/**
+ * @brief Трасса "powerlaw": размеры со степенным распределением
+ *
+ * Класс k (размеры 16*2^k .. 16*2^(k+1)) выбирается с вероятностью
+ * 2^-(k+1): много мелких выделений и редкие крупные, вплоть до страничных.
+ */
+static void membench_powerlaw(void) {
+    uint32_t live_before = heap_prof.live_bytes;
+    membench_begin();
+
+    for (uint32_t op = 0; op < MEMBENCH_OPS; op++) {
+        uint32_t slot = bench_random(&membench_seed) % MEMBENCH_SLOTS;
+        uint32_t class = __builtin_ctz(bench_random(&membench_seed) | (1u << (MEMBENCH_POW_CLASSES - 1)));
+        uint32_t base = MEMBENCH_POW_MIN << class;
+        uint32_t size = base + bench_random(&membench_seed) % base;
+
+        if (membench_ptr[slot]) {
+            membench_free(slot);
+        } else {
+            membench_alloc(slot, size);
+        }
+        membench_check(op);
+    }
+
+    membench_finish("powerlaw", live_before);
+}
+
+/**
+ * @brief Трасса "pmm": случайные выделения блоков порядков 0..3
+ *
+ * Первое слово блока хранит его адрес - проверка, что блоки не выданы дважды.
+ */
+static void membench_pmm(void) {
+    uint32_t free_before = pmm_get_free_pages_count();
+    membench_begin();
+
+    for (uint32_t op = 0; op < MEMBENCH_OPS; op++) {
+        uint32_t slot = bench_random(&membench_seed) % MEMBENCH_SLOTS;
+
+        if (membench_ptr[slot]) {
+            uint32_t addr = (uint32_t)membench_ptr[slot];
+            if (*(uint32_t*)addr != addr) {
+                membench_errors++;
+            }
+            uint64_t start = rdtsc();
+            pmm_free_pages(addr, membench_size[slot]);
+            uint64_t end = rdtsc();
+            membench_free_cycles[membench_free_ops++] = (uint32_t)(end - start);
+            membench_ptr[slot] = NULL;
+            continue;
+        }
+
+        uint32_t order = bench_random(&membench_seed) % MEMBENCH_PMM_ORDERS;
+        uint64_t start = rdtsc();
+        uint32_t addr = pmm_alloc_pages(order);
+        uint64_t end = rdtsc();
+        if (!addr) {
+            membench_errors++;
+            continue;
+        }
+        membench_alloc_cycles[membench_alloc_ops++] = (uint32_t)(end - start);
+        *(uint32_t*)addr = addr;
+        membench_ptr[slot] = (uint8_t*)addr;
+        membench_size[slot] = order;
+    }
+
+    for (uint32_t slot = 0; slot < MEMBENCH_SLOTS; slot++) {
+        if (membench_ptr[slot]) {
+            pmm_free_pages((uint32_t)membench_ptr[slot], membench_size[slot]);
+        }
+    }
+    if (pmm_get_free_pages_count() != free_before) {
+        membench_errors++;
+    }
+
+    membench_report("pmm", "alloc", membench_alloc_cycles, membench_alloc_ops);
+    membench_report("pmm", "free", membench_free_cycles, membench_free_ops);
+}
+
+/**
+ * @brief Трасса "arena": мелкие выделения арены со сбросом каждые 256
+ */
+static void membench_arena(void) {
+    arena_t *arena = arena_create(0);
+    if (!arena) {
+        membench_errors++;
+        return;
+    }
+    membench_begin();
+
+    for (uint32_t op = 0; op < MEMBENCH_OPS; op++) {
+        uint32_t size = 8 + bench_random(&membench_seed) % 256;
+
+        uint64_t start = rdtsc();
+        uint8_t *ptr = (uint8_t*)arena_alloc(arena, size);
+        uint64_t end = rdtsc();
+        if (!ptr) {
+            membench_errors++;
+            break;
+        }
+        membench_alloc_cycles[membench_alloc_ops++] = (uint32_t)(end - start);
+        ptr[0] = ptr[size - 1] = (uint8_t)op;
+
+        if (op % MEMBENCH_ARENA_RESET == MEMBENCH_ARENA_RESET - 1) {
+            start = rdtsc();
+            arena_reset(arena);
+            end = rdtsc();
+            membench_free_cycles[membench_free_ops++] = (uint32_t)(end - start);
+        }
+    }
+    arena_destroy(arena);
+
+    membench_report("arena", "alloc", membench_alloc_cycles, membench_alloc_ops);
+    membench_report("arena", "reset", membench_free_cycles, membench_free_ops);
+}
+
+/**
+ * @brief Набор стресс-тестов и бенчмарков памяти (команда membench)
+ *
+ * Все трассы детерминированы зерном MEMBENCH_SEED, поэтому результаты
+ * разных сборок можно сравнивать построчно по выводу COM1.
+ */
+void memory_benchmark(void) {
+    membench_errors = 0;
+
+    print_string("\nMemory benchmark (seed ");
+    print_hex(MEMBENCH_SEED);
+    print_string(", ");
+    print_dec(MEMBENCH_OPS);
+    print_string(" ops per trace):\n");
+    serial_write_string("membench begin seed=");
+    serial_write_dec(MEMBENCH_SEED);
+    serial_write_string(" ops=");
+    serial_write_dec(MEMBENCH_OPS);
+    serial_write_string("\n");
+
+    membench_random();
+    membench_prodcons();
+    membench_powerlaw();
+    membench_pmm();
+    membench_arena();
+
+    print_string("  - Errors: ");
+    print_dec(membench_errors);
+    print_string("\n");
+    serial_write_string("membench end errors=");
+    serial_write_dec(membench_errors);
+    serial_write_string("\n");
+}
+
+#define COPYBENCH_ORDER 8            /* Буферы по 1MB */
+#define COPYBENCH_BYTES (2 * 1024 * 1024) /* Объём одного замера */
+#define COPYBENCH_CAL_TICKS 10       /* Тиков PIT на калибровку TSC */
+#define COPYBENCH_ABSENT 0xEE        /* Значение, которого нет в буфере */
+
+static const uint32_t copybench_sizes[] = { 64, 512, 4096, 65536, 1024 * 1024 };
+static volatile uint32_t copybench_sink;
+
+/* Прежние побайтовые версии примитивов - эталон для сравнения */
+static void bench_byte_set(uint8_t *d, uint8_t val, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        d[i] = val;
+    }
+}
+
+static void bench_byte_copy(uint8_t *d, const uint8_t *s, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        d[i] = s[i];
+    }
+}
+
+static int bench_byte_compare(const uint8_t *p1, const uint8_t *p2, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (p1[i] != p2[i]) {
+            return (int)p1[i] - (int)p2[i];
+        }
+    }
+    return 0;
+}
+
+static const uint8_t* bench_byte_find(const uint8_t *p, uint8_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (p[i] == value) {
+            return p + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Частота TSC: калибровка clock_init или оценка по тикам PIT
+ * @return Частота в МГц
+ */
+static uint32_t copybench_tsc_mhz(void) {
+    if (clock_tsc_khz()) {
+        return clock_tsc_khz() / 1000;
+    }
+
+    uint32_t ticks = pit_get_ticks();
+    while (pit_get_ticks() == ticks) {
+        __asm__ volatile("pause");
+    }
+
+    ticks = pit_get_ticks();
+    uint64_t start = rdtsc();
+    while (pit_get_ticks() - ticks < COPYBENCH_CAL_TICKS) {
+        __asm__ volatile("pause");
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+
+    uint32_t us = COPYBENCH_CAL_TICKS * (1000000 / pit_get_frequency());
+    return cycles / us;
+}
+
+/**
+ * @brief Один замер операции над блоками size байт
+ * @param op 0 - set, 1 - copy, 2 - compare, 3 - find
+ * @param reference Использовать побайтовую версию
+ * @return Байт за 1000 тактов
+ */
+static uint32_t copybench_run(uint32_t op, int reference, uint8_t *dst, uint8_t *src, uint32_t size) {
+    uint32_t reps = COPYBENCH_BYTES / size;
+    uint32_t sink = 0;
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) {
+        switch (op) {
+        case 0:
+            if (reference) {
+                bench_byte_set(dst, (uint8_t)i, size);
+            } else {
+                memory_set(dst, (uint8_t)i, size);
+            }
+            break;
+        case 1:
+            if (reference) {
+                bench_byte_copy(dst, src, size);
+            } else {
+                memory_copy(dst, src, size);
+            }
+            break;
+        case 2:
+            sink += reference ? bench_byte_compare(dst, src, size)
+                              : memory_compare(dst, src, size);
+            break;
+        default:
+            sink += reference ? (uint32_t)bench_byte_find(src, COPYBENCH_ABSENT, size)
+                              : (uint32_t)memory_find(src, COPYBENCH_ABSENT, size);
+            break;
+        }
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+    copybench_sink = sink;
+
+    return (reps * size) / (cycles / 1000 + 1);
+}
+
+/**
+ * @brief Вывод пропускной способности в ГБ/с с двумя знаками
+ */
+static void copybench_print(uint32_t centi) {
+    print_dec(centi / 100);
+    print_string(centi % 100 < 10 ? ".0" : ".");
+    print_dec(centi % 100);
+}
+
+/**
+ * @brief Сравнение примитивов memory_* с прежними побайтовыми циклами (команда copybench)
+ *
+ * Для каждого размера блока выводит ГБ/с нового варианта и в скобках -
+ * побайтового. Частота TSC калибруется по PIT, поэтому прерывания
+ * должны быть разрешены.
+ */
+void memory_primitives_benchmark(void) {
+    static const char *names[] = { "set", "copy", "cmp", "find" };
+    uint32_t features = memory_get_features();
+
+    print_string("\nMemory primitives benchmark:\n");
+    print_string("  - Variant: ");
+    print_string(features & MEMORY_FEATURE_ERMS ? "rep movsb/stosb (ERMS)" : "rep movsl/stosl");
+    if (features & MEMORY_FEATURE_SSE2) {
+        print_string(" + SSE2 movntdq");
+    }
+    print_string("\n");
+
+    uint8_t *src = (uint8_t*)pmm_alloc_pages(COPYBENCH_ORDER);
+    uint8_t *dst = (uint8_t*)pmm_alloc_pages(COPYBENCH_ORDER);
+    if (!src || !dst) {
+        print_string("  - Not enough memory\n");
+        if (src) {
+            pmm_free_pages((uint32_t)src, COPYBENCH_ORDER);
+        }
+        if (dst) {
+            pmm_free_pages((uint32_t)dst, COPYBENCH_ORDER);
+        }
+        return;
+    }
+
+    uint32_t mhz = copybench_tsc_mhz();
+    print_string("  - TSC: ");
+    print_dec(mhz);
+    print_string(" MHz, GB/s new (byte loop):\n");
+    serial_write_string("copybench begin mhz=");
+    serial_write_dec(mhz);
+    serial_write_string(" features=");
+    serial_write_dec(features);
+    serial_write_string("\n");
+
+    uint32_t buffer_size = PAGE_SIZE << COPYBENCH_ORDER;
+    for (uint32_t k = 0; k < sizeof(copybench_sizes) / sizeof(copybench_sizes[0]); k++) {
+        uint32_t size = copybench_sizes[k];
+
+        print_string("  ");
+        print_dec(size);
+        print_string("B:");
+        for (uint32_t op = 0; op < 4; op++) {
+            /* Одинаковые буферы: compare проходит блок целиком, find не находит */
+            memory_set(src, 0x11, buffer_size);
+            memory_set(dst, 0x11, buffer_size);
+
+            uint32_t fast = copybench_run(op, 0, dst, src, size);
+            uint32_t slow = copybench_run(op, 1, dst, src, size);
+
+            /* Байт за 1000 тактов * МГц / 10^4 = сотые ГБ/с */
+            print_string(" ");
+            print_string(names[op]);
+            print_string(" ");
+            copybench_print(fast * mhz / 10000);
+            print_string(" (");
+            copybench_print(slow * mhz / 10000);
+            print_string(")");
+
+            serial_write_string("copybench op=");
+            serial_write_string(names[op]);
+            serial_write_string(" size=");
+            serial_write_dec(size);
+            serial_write_string(" mbps=");
+            serial_write_dec(fast * mhz / 1000);
+            serial_write_string(" byte_mbps=");
+            serial_write_dec(slow * mhz / 1000);
+            serial_write_string("\n");
+        }
         print_string("\n");
-        
-        /* Тестируем krealloc */
-        print_string("Testing krealloc...\n");
-        char* new_str2 = (char*)krealloc(str2, 200);
-        if (new_str2) {
-            print_string("  - Reallocated to 200 bytes at 0x");
-            print_hex((uint32_t)new_str2);
-            print_string("\n  - Content: ");
-            print_string(new_str2);
-            print_string("\n");
-            str2 = new_str2;
-        }
-        
-        /* Освобождаем память */
-        print_string("Freeing memory...\n");
-        kfree(str1);
-        kfree(str2);
-        kfree(str3);
-        
-        print_string("Memory freed successfully\n");
+    }
+
+    pmm_free_pages((uint32_t)src, COPYBENCH_ORDER);
+    pmm_free_pages((uint32_t)dst, COPYBENCH_ORDER);
+}
+
+#define TLBBENCH_MAX_SPAN (16 * 1024 * 1024) /* 4096 страниц 4KB - больше типичного STLB */
+#define TLBBENCH_PHYS VMM_LARGE_PAGE_SIZE    /* Физическое начало окна: вторая страница 4MB */
+#define TLBBENCH_ROUNDS 8
+#define TLBBENCH_STRIDE 2654435761u          /* Нечётный множитель: перестановка страниц */
+
+static volatile uint32_t tlbbench_sink;
+
+/**
+ * @brief Обход окна в псевдослучайном порядке страниц
+ *
+ * Смещение внутри страницы меняется, чтобы обращения попадали в разные
+ * наборы кэша и замер отражал промахи TLB, а не конфликты кэша.
+ * @return Тактов на одно обращение
+ */
+static uint32_t tlbbench_walk(uint32_t base, uint32_t pages) {
+    uint32_t sum = 0;
+
+    uint64_t start = rdtsc();
+    for (uint32_t round = 0; round < TLBBENCH_ROUNDS; round++) {
+        for (uint32_t i = 0; i < pages; i++) {
+            uint32_t page = (i * TLBBENCH_STRIDE) & (pages - 1);
+            sum += *(volatile uint32_t*)(base + page * PAGE_SIZE + ((page * 64) & (PAGE_SIZE - 1)));
+        }
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+    tlbbench_sink = sum;
+
+    return cycles / (TLBBENCH_ROUNDS * pages);
+}
+
+/**
+ * @brief Стоимость промахов TLB: страницы 4KB против 4MB (команда tlbbench)
+ *
+ * Одна и та же физическая память читается через отображение 1:1
+ * (страницы 4MB) и через область окна ядра из страниц 4KB.
+ */
+void tlb_benchmark(void) {
+    uint32_t span = TLBBENCH_MAX_SPAN;
+    while (span > VMM_LARGE_PAGE_SIZE && TLBBENCH_PHYS + span > kernel_vmm.identity_end) {
+        span >>= 1;
+    }
+
+    print_string("\nTLB benchmark:\n");
+    if (TLBBENCH_PHYS + span > kernel_vmm.identity_end) {
+        print_string("  - Not enough memory\n");
+        return;
+    }
+
+    uint32_t window = (uint32_t)vm_reserve(span, 0);
+    if (!window) {
+        print_string("  - No virtual window\n");
+        return;
+    }
+
+    uint32_t pages = span >> PAGE_SHIFT;
+    uint32_t flags = kernel_vmm.pge ? VMM_GLOBAL : 0;
+    uint32_t invlpgs = kernel_vmm.invlpgs;
+    uint32_t full_flushes = kernel_vmm.full_flushes;
+
+    vmm_batch_begin();
+    for (uint32_t i = 0; i < pages; i++) {
+        if (map_page(window + i * PAGE_SIZE, TLBBENCH_PHYS + i * PAGE_SIZE, flags) != 0) {
+            pages = i;
+            break;
+        }
+    }
+    vmm_batch_end();
+
+    if (pages == span >> PAGE_SHIFT) {
+        /* Первый проход прогревает кэши, второй замеряется */
+        tlbbench_walk(window, pages);
+        uint32_t small = tlbbench_walk(window, pages);
+        tlbbench_walk(TLBBENCH_PHYS, pages);
+        uint32_t large = tlbbench_walk(TLBBENCH_PHYS, pages);
+
+        print_string("  - ");
+        print_dec(pages);
+        print_string(" pages, ");
+        print_dec(TLBBENCH_ROUNDS);
+        print_string(" rounds in random page order\n");
+        print_string("  - 4KB pages: ");
+        print_dec(small);
+        print_string(" cycles/access\n");
+        print_string(kernel_vmm.pse ? "  - 4MB pages: " : "  - 4KB identity map (no PSE): ");
+        print_dec(large);
+        print_string(" cycles/access\n");
+
+        serial_write_string("tlbbench pages=");
+        serial_write_dec(pages);
+        serial_write_string(" cycles_4k=");
+        serial_write_dec(small);
+        serial_write_string(" cycles_4m=");
+        serial_write_dec(large);
+        serial_write_string("\n");
+    } else {
+        print_string("  - Not enough memory for page tables\n");
+    }
+
+    vm_release((void*)window);
+
+    print_string("  - Teardown: ");
+    print_dec(kernel_vmm.invlpgs - invlpgs);
+    print_string(" invlpg, ");
+    print_dec(kernel_vmm.full_flushes - full_flushes);
+    print_string(" full flush\n");
+}
+
+/* Параметры fault_benchmark */
+#define FAULTBENCH_SPAN (64 * 1024 * 1024) /* Зарезервированная разреженная область */
+#define FAULTBENCH_SPARSE 64               /* Шаг разреженного прохода в страницах */
+#define FAULTBENCH_DENSE 256               /* Страниц в плотном последовательном проходе */
+
+/**
+ * @brief Один проход касаний области
+ * @param base Начало прохода
+ * @param count Касаний
+ * @param stride Шаг в страницах
+ * @param write Писать (иначе читать)
+ * @return Тактов на касание
+ */
+static uint32_t faultbench_touch(uint32_t base, uint32_t count, uint32_t stride, int write) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        volatile uint32_t *word = (volatile uint32_t*)(base + i * stride * PAGE_SIZE);
+        if (write) {
+            *word = i;
+        } else {
+            (void)*word;
+        }
+    }
+    return (uint32_t)(rdtsc() - start) / count;
+}
+
+/**
+ * @brief Вывод строки результата прохода
+ */
+static void faultbench_report(const char *label, uint32_t cycles, uint32_t faults, uint32_t touches) {
+    print_string(label);
+    print_dec(cycles);
+    print_string(" cycles/touch, ");
+    print_dec(faults);
+    print_string(" faults for ");
+    print_dec(touches);
+    print_string(" touches\n");
+}
+
+/**
+ * @brief Прогон одной конфигурации области
+ */
+static void faultbench_run(const char *name, uint32_t flags) {
+    uint32_t sparse = FAULTBENCH_SPAN / PAGE_SIZE / FAULTBENCH_SPARSE;
+    uint32_t around = (flags & VM_FAULT_AROUND) ? VM_FAULT_AROUND_PAGES : 1;
+    if (pmm_get_free_pages_count() < (sparse + FAULTBENCH_DENSE) * around + 64) {
+        print_string("  - ");
+        print_string(name);
+        print_string(": not enough memory\n");
+        return;
+    }
+
+    uint32_t base = (uint32_t)vm_reserve(FAULTBENCH_SPAN, flags);
+    if (!base) {
+        print_string("  - No virtual window\n");
+        return;
+    }
+    vm_area_t *area = vm_find_area(base);
+
+    uint32_t free_before = pmm_get_free_pages_count();
+    uint32_t tables_before = kernel_vmm.tables;
+
+    print_string("  - ");
+    print_string(name);
+    print_string(":\n");
+
+    /* Разреженно: сначала чтение (нулевая страница), затем запись */
+    uint32_t faults = kernel_vmm.faults;
+    uint32_t cycles = faultbench_touch(base, sparse, FAULTBENCH_SPARSE, 0);
+    faultbench_report("      sparse read:  ", cycles, kernel_vmm.faults - faults, sparse);
+
+    faults = kernel_vmm.faults;
+    cycles = faultbench_touch(base, sparse, FAULTBENCH_SPARSE, 1);
+    faultbench_report("      sparse write: ", cycles, kernel_vmm.faults - faults, sparse);
+
+    /* Плотно: последовательная запись в конец области */
+    uint32_t dense = base + FAULTBENCH_SPAN - FAULTBENCH_DENSE * PAGE_SIZE;
+    faults = kernel_vmm.faults;
+    cycles = faultbench_touch(dense, FAULTBENCH_DENSE, 1, 1);
+    faultbench_report("      dense write:  ", cycles, kernel_vmm.faults - faults, FAULTBENCH_DENSE);
+
+    uint32_t resident = area->resident;
+    print_string("      resident ");
+    print_dec(resident);
+    print_string(" of ");
+    print_dec(FAULTBENCH_SPAN / PAGE_SIZE);
+    print_string(" reserved pages (");
+    print_dec(resident * PAGE_SIZE / 1024);
+    print_string(" KB)\n");
+
+    vm_release((void*)base);
+
+    /* Таблицы страниц окна остаются для следующих областей */
+    uint32_t tables = kernel_vmm.tables - tables_before;
+    int32_t leaked = (int32_t)free_before - (int32_t)pmm_get_free_pages_count() - (int32_t)tables;
+    print_string("      after release: ");
+    print_dec(leaked > 0 ? (uint32_t)leaked : 0);
+    print_string(" pages leaked, ");
+    print_dec(tables);
+    print_string(" page tables kept\n");
+
+    serial_write_string("faultbench mode=");
+    serial_write_string(name);
+    serial_write_string(" resident=");
+    serial_write_dec(resident);
+    serial_write_string(" leaked=");
+    serial_write_dec(leaked > 0 ? (uint32_t)leaked : 0);
+    serial_write_string("\n");
+}
+
+/**
+ * @brief Стоимость ошибок страниц по требованию (команда faultbench)
+ *
+ * Разреженная область 64MB касается каждой FAULTBENCH_SPARSE-й страницы,
+ * затем плотно пишется её хвост - с fault-around и без него.
+ */
+void fault_benchmark(void) {
+    print_string("\nDemand paging benchmark:\n");
+    faultbench_run("demand", VM_DEMAND | VM_WRITE);
+    faultbench_run("fault-around", VM_DEMAND | VM_WRITE | VM_FAULT_AROUND);
+}
+
+/* Параметры vmalloc_benchmark */
+#define VMALLOCBENCH_LARGE (4 * 1024 * 1024) /* Буфер на фрагментированной памяти */
+#define VMALLOCBENCH_SIZE (64 * 1024)        /* Размер выделения в цикле vmalloc/vfree */
+#define VMALLOCBENCH_ROUNDS 1024
+
+/**
+ * @brief Цикл vmalloc/vfree
+ * @param purge Сбрасывать TLB после каждого vfree
+ */
+static void vmallocbench_cycle(const char *label, int purge) {
+    uint32_t invlpgs = kernel_vmm.invlpgs;
+    uint32_t full_flushes = kernel_vmm.full_flushes;
+    uint32_t failed = 0;
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < VMALLOCBENCH_ROUNDS; i++) {
+        uint8_t *buffer = vmalloc(VMALLOCBENCH_SIZE);
+        if (!buffer) {
+            failed++;
+            continue;
+        }
+        for (uint32_t offset = 0; offset < VMALLOCBENCH_SIZE; offset += PAGE_SIZE) {
+            buffer[offset] = (uint8_t)i;
+        }
+        vfree(buffer);
+        if (purge) {
+            vmalloc_purge();
+        }
+    }
+    vmalloc_purge();
+    uint32_t cycles = (uint32_t)((rdtsc() - start) / VMALLOCBENCH_ROUNDS);
+
+    print_string(label);
+    print_dec(cycles);
+    print_string(" cycles/pair, ");
+    print_dec(kernel_vmm.invlpgs - invlpgs);
+    print_string(" invlpg, ");
+    print_dec(kernel_vmm.full_flushes - full_flushes);
+    print_string(" full flushes");
+    if (failed) {
+        print_string(", failed ");
+        print_dec(failed);
+    }
+    print_string("\n");
+
+    serial_write_string("vmallocbench mode=");
+    serial_write_string(purge ? "eager" : "lazy");
+    serial_write_string(" cycles=");
+    serial_write_dec(cycles);
+    serial_write_string(" full_flushes=");
+    serial_write_dec(kernel_vmm.full_flushes - full_flushes);
+    serial_write_string("\n");
+}
+
+/**
+ * @brief Большой буфер на фрагментированной памяти
+ *
+ * Вся свободная память забирается по страницам и освобождается через
+ * одну: непрерывных блоков не остаётся, но vmalloc собирает буфер
+ * из разрозненных страниц.
+ */
+static void vmallocbench_fragmented(void) {
+    /* Занятые страницы связываются в список через первое слово */
+    uint32_t head = 0;
+    uint32_t held = 0;
+    uint32_t page;
+    while ((page = pmm_alloc_page()) != 0) {
+        *(uint32_t*)page = head;
+        head = page;
+        held++;
+    }
+
+    /* Освобождается каждая вторая - остаются одиночные страницы */
+    uint32_t *link = &head;
+    uint32_t index = 0;
+    while (*link) {
+        page = *link;
+        if (index++ & 1) {
+            *link = *(uint32_t*)page;
+            pmm_free_page(page);
+            held--;
+        } else {
+            link = (uint32_t*)page;
+        }
+    }
+
+    uint32_t count = VMALLOCBENCH_LARGE / PAGE_SIZE;
+    print_string("  - Fragmented: ");
+    print_dec(pmm_get_free_pages_count());
+    print_string(" free pages, ");
+    print_dec(held);
+    print_string(" held\n");
+
+    uint32_t contiguous = pmm_alloc_pages_exact(count);
+    print_string("      pmm_alloc_pages_exact(4MB): ");
+    print_string(contiguous ? "ok\n" : "failed\n");
+    if (contiguous) {
+        pmm_free_pages_exact(contiguous, count);
+    }
+
+    uint64_t start = rdtsc();
+    uint8_t *buffer = vmalloc(VMALLOCBENCH_LARGE);
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+
+    print_string("      vmalloc(4MB): ");
+    if (buffer) {
+        for (uint32_t i = 0; i < VMALLOCBENCH_LARGE; i += sizeof(uint32_t)) {
+            *(uint32_t*)(buffer + i) = i;
+        }
+        uint32_t errors = 0;
+        for (uint32_t i = 0; i < VMALLOCBENCH_LARGE; i += sizeof(uint32_t)) {
+            if (*(uint32_t*)(buffer + i) != i) {
+                errors++;
+            }
+        }
+        print_string("ok, ");
+        print_dec(cycles / count);
+        print_string(" cycles/page, ");
+        print_dec(errors);
+        print_string(" verify errors\n");
+        vfree(buffer);
+        vmalloc_purge();
+    } else {
+        print_string("failed\n");
+    }
+
+    while (head) {
+        page = head;
+        head = *(uint32_t*)page;
+        pmm_free_page(page);
+    }
+}
+
+/**
+ * @brief Память vmalloc и ленивый сброс TLB (команда vmallocbench)
+ */
+void vmalloc_benchmark(void) {
+    print_string("\nvmalloc benchmark:\n");
+
+    uint32_t free_before = pmm_get_free_pages_count();
+    vmallocbench_fragmented();
+
+    print_string("  - ");
+    print_dec(VMALLOCBENCH_ROUNDS);
+    print_string(" x vmalloc/vfree of ");
+    print_dec(VMALLOCBENCH_SIZE / 1024);
+    print_string(" KB:\n");
+    vmallocbench_cycle("      lazy purge:      ", 0);
+    vmallocbench_cycle("      purge per vfree: ", 1);
+
+    /* Таблицы страниц окна остаются для следующих областей */
+    print_string("  - Free pages: ");
+    print_dec(free_before);
+    print_string(" before, ");
+    print_dec(pmm_get_free_pages_count());
+    print_string(" after\n");
+}
+
+/* Параметры fork_benchmark */
+#define FORKBENCH_SIZES 3
+#define FORKBENCH_STRIDE 16                  /* Потомок пишет в каждую 16-ю страницу */
+
+static const uint32_t forkbench_sizes[FORKBENCH_SIZES] = {
+    1 * 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024
+};
+
+/**
+ * @brief Запись в каждую FORKBENCH_STRIDE-ю страницу образа
+ * @return Тактов на запись
+ */
+static uint32_t forkbench_write(uint32_t pages, uint32_t value) {
+    uint32_t writes = 0;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < pages; i += FORKBENCH_STRIDE) {
+        *(volatile uint32_t*)(MM_USER_BASE + i * PAGE_SIZE) = value ^ i;
+        writes++;
+    }
+    return (uint32_t)(rdtsc() - start) / writes;
+}
+
+/**
+ * @brief Проверка меток образа
+ * @param written Значение в записанных страницах (иначе - номер страницы)
+ * @return Число несовпадений
+ */
+static uint32_t forkbench_verify(uint32_t pages, uint32_t written) {
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t expected = (i % FORKBENCH_STRIDE == 0) ? written ^ i : i;
+        if (*(volatile uint32_t*)(MM_USER_BASE + i * PAGE_SIZE) != expected) {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/**
+ * @brief Прогон fork для образа одного размера
+ */
+static void forkbench_run(uint32_t size, uint32_t mhz) {
+    uint32_t pages = size / PAGE_SIZE;
+    print_string("  - ");
+    print_dec(size >> 20);
+    print_string(" MB image: ");
+
+    /* Образ, копии записанных страниц и таблицы */
+    if (pmm_get_free_pages_count() < pages + pages / FORKBENCH_STRIDE + 64) {
+        print_string("not enough memory\n");
+        return;
+    }
+
+    mm_t *parent = mm_create();
+    if (!parent || mm_map_anon(parent, MM_USER_BASE, size) != 0) {
+        print_string("image allocation failed\n");
+        mm_destroy(parent);
+        return;
+    }
+    mm_switch(parent);
+    for (uint32_t i = 0; i < pages; i++) {
+        *(uint32_t*)(MM_USER_BASE + i * PAGE_SIZE) = i;
+    }
+
+    uint64_t start = rdtsc();
+    mm_t *child = mm_fork(parent);
+    uint32_t fork_cycles = (uint32_t)(rdtsc() - start);
+    if (!child) {
+        print_string("fork failed\n");
+        mm_switch(NULL);
+        mm_destroy(parent);
+        return;
+    }
+
+    /* Потомок пишет: копии только записанных страниц */
+    uint32_t copies = kernel_vmm.cow_copies;
+    mm_switch(child);
+    uint32_t copy_cycles = forkbench_write(pages, 0xC0FFEE00);
+    uint32_t errors = forkbench_verify(pages, 0xC0FFEE00);
+    copies = kernel_vmm.cow_copies - copies;
+
+    /* Родитель видит прежние данные; после выхода потомка страницы снова его */
+    mm_switch(parent);
+    for (uint32_t i = 0; i < pages; i++) {
+        if (*(volatile uint32_t*)(MM_USER_BASE + i * PAGE_SIZE) != i) {
+            errors++;
+        }
+    }
+    mm_destroy(child);
+    uint32_t reuses = kernel_vmm.cow_reuses;
+    uint32_t reuse_cycles = forkbench_write(pages, 0xFEED0000);
+    reuses = kernel_vmm.cow_reuses - reuses;
+    errors += forkbench_verify(pages, 0xFEED0000);
+
+    mm_switch(NULL);
+    mm_destroy(parent);
+
+    print_dec(fork_cycles / 1000);
+    print_string("K cycles");
+    if (mhz) {
+        print_string(" (");
+        print_dec(fork_cycles / mhz);
+        print_string(" us)");
+    }
+    print_string(" fork, ");
+    print_dec(pages);
+    print_string(" pages shared\n      child writes: ");
+    print_dec(copies);
+    print_string(" copies, ");
+    print_dec(copy_cycles);
+    print_string(" cycles/write; parent after exit: ");
+    print_dec(reuses);
+    print_string(" reused, ");
+    print_dec(reuse_cycles);
+    print_string(" cycles/write; ");
+    print_dec(errors);
+    print_string(" errors\n");
+
+    serial_write_string("forkbench size_mb=");
+    serial_write_dec(size >> 20);
+    serial_write_string(" fork_cycles=");
+    serial_write_dec(fork_cycles);
+    serial_write_string(" copy_cycles=");
+    serial_write_dec(copy_cycles);
+    serial_write_string(" reuse_cycles=");
+    serial_write_dec(reuse_cycles);
+    serial_write_string(" errors=");
+    serial_write_dec(errors);
+    serial_write_string("\n");
+}
+
+/**
+ * @brief Латентность fork с копированием при записи (команда forkbench)
+ *
+ * Образы 1, 16 и 64MB: fork копирует только таблицы страниц, потомок
+ * записью в каждую FORKBENCH_STRIDE-ю страницу вызывает копирование,
+ * родитель после уничтожения потомка забирает страницы без копий.
+ */
+void fork_benchmark(void) {
+    print_string("\nfork (copy-on-write) benchmark:\n");
+    if (mm_current()) {
+        print_string("  - Must run in the kernel address space\n");
+        return;
+    }
+
+    /* Кэш дескрипторов создаётся заранее, чтобы не считаться утечкой */
+    mm_destroy(mm_create());
+    uint32_t free_before = pmm_get_free_pages_count();
+    uint32_t mhz = copybench_tsc_mhz();
+
+    for (uint32_t i = 0; i < FORKBENCH_SIZES; i++) {
+        forkbench_run(forkbench_sizes[i], mhz);
+    }
+
+    print_string("  - Free pages: ");
+    print_dec(free_before);
+    print_string(" before, ");
+    print_dec(pmm_get_free_pages_count());
+    print_string(" after\n");
+}
+
+/* Параметры zram_benchmark */
+#define ZRAMBENCH_RANDOM_EVERY 64            /* Каждая 64-я страница - случайные данные */
+#define ZRAMBENCH_WORDS 8
+
+static const char *zrambench_words[ZRAMBENCH_WORDS] = {
+    "page ", "memory ", "kernel ", "swap ", "compressed ", "anonymous ", "cold ", "frame "
+};
+
+/* Буфер эталонного содержимого страницы */
+static uint8_t zrambench_page[PAGE_SIZE];
+
+/**
+ * @brief Эталонное содержимое страницы рабочего набора
+ *
+ * Каждая 4-я страница нулевая, каждая ZRAMBENCH_RANDOM_EVERY-я -
+ * случайная (не сжимается), остальные - текст из словаря.
+ */
+static void zrambench_content(uint32_t index, uint8_t *page) {
+    uint32_t state = index * 2654435761u + 1;
+    if (index % 4 == 0) {
+        memory_set(page, 0, PAGE_SIZE);
+    } else if (index % ZRAMBENCH_RANDOM_EVERY == 1) {
+        for (uint32_t i = 0; i < PAGE_SIZE; i += sizeof(uint32_t)) {
+            *(uint32_t*)(page + i) = bench_random(&state);
+        }
     } else {
-        print_string_color("Failed to allocate memory!\n", COLOR_RED, COLOR_BLACK);
+        uint32_t pos = 0;
+        while (pos < PAGE_SIZE) {
+            const char *word = zrambench_words[bench_random(&state) % ZRAMBENCH_WORDS];
+            while (*word && pos < PAGE_SIZE) {
+                page[pos++] = (uint8_t)*word++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Сжатый своп под рабочим набором больше памяти (команда zrambench)
+ *
+ * Рабочий набор в полтора раза больше свободной памяти заполняется и
+ * затем проверяется целиком: холодные страницы вытесняются в zram и
+ * возвращаются по ошибке страницы. Выводятся степень сжатия, стоимость
+ * возврата страницы и число расхождений.
+ */
+void zram_benchmark(void) {
+    print_string("\nzram (compressed swap) benchmark:\n");
+    if (mm_current()) {
+        print_string("  - Must run in the kernel address space\n");
+        return;
+    }
+    if (!zram.slots) {
+        print_string("  - zram is not initialized\n");
+        return;
+    }
+
+    mm_destroy(mm_create());
+    uint32_t free_before = pmm_get_free_pages_count();
+    uint32_t pages = free_before + free_before / 2;
+    if (pages > (MM_USER_END - MM_USER_BASE) / PAGE_SIZE) {
+        pages = (MM_USER_END - MM_USER_BASE) / PAGE_SIZE;
+    }
+
+    mm_t *mm = mm_create();
+    if (!mm || mm_map_anon(mm, MM_USER_BASE, pages * PAGE_SIZE) != 0) {
+        print_string("  - Working set allocation failed\n");
+        mm_destroy(mm);
+        return;
+    }
+    mm_switch(mm);
+
+    uint32_t stores = zram.stores;
+    uint32_t loads = zram.loads;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < pages; i++) {
+        zrambench_content(i, zrambench_page);
+        memory_copy((void*)(MM_USER_BASE + i * PAGE_SIZE), zrambench_page, PAGE_SIZE);
+    }
+    uint32_t fill_cycles = (uint32_t)(rdtsc() - start) / pages;
+
+    /* Снимок после заполнения: сколько лежит в zram и в каком виде */
+    uint32_t stored = zram.stored;
+    uint32_t same_filled = zram.same_filled;
+    uint32_t compressed = zram.compressed_bytes;
+    uint32_t swapped = mm->swapped;
+
+    /* Возврат страницы замеряется по первому чтению из неё */
+    uint32_t swapin_cycles = 0;
+    uint32_t swapins = 0;
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < pages; i++) {
+        volatile uint32_t *addr = (volatile uint32_t*)(MM_USER_BASE + i * PAGE_SIZE);
+        uint32_t before = zram.loads;
+        uint64_t t0 = rdtsc();
+        (void)*addr;
+        uint64_t t1 = rdtsc();
+        if (zram.loads != before) {
+            swapin_cycles += (uint32_t)(t1 - t0);
+            swapins++;
+        }
+        zrambench_content(i, zrambench_page);
+        if (memory_compare((const void*)addr, zrambench_page, PAGE_SIZE) != 0) {
+            errors++;
+        }
     }
-    
-    /* Выводим финальную информацию */
-    print_string("Final heap status:\n");
-    heap_dump_info();
+    stores = zram.stores - stores;
+    loads = zram.loads - loads;
+
+    mm_switch(NULL);
+    mm_destroy(mm);
+
+    /* Степень сжатия - по страницам, хранящим данные */
+    uint32_t data_pages = stored - same_filled;
+    uint32_t ratio = compressed >= 1024 ? (data_pages * (PAGE_SIZE / 1024) * 10) / (compressed / 1024) : 0;
+    uint32_t per_swapin = swapins ? swapin_cycles / swapins : 0;
+
+    print_string("  - Working set ");
+    print_dec(pages);
+    print_string(" pages (");
+    print_dec(free_before);
+    print_string(" free), ");
+    print_dec(fill_cycles);
+    print_string(" cycles/page fill\n  - After fill: ");
+    print_dec(swapped);
+    print_string(" pages swapped, ");
+    print_dec(same_filled);
+    print_string(" same-filled, ");
+    print_dec(data_pages);
+    print_string(" compressed into ");
+    print_dec(compressed / 1024);
+    print_string(" KB (ratio ");
+    print_dec(ratio / 10);
+    print_string(".");
+    print_dec(ratio % 10);
+    print_string(")\n  - Swap-in: ");
+    print_dec(per_swapin);
+    print_string(" cycles/page; stores ");
+    print_dec(stores);
+    print_string(", loads ");
+    print_dec(loads);
+    print_string(", incompressible ");
+    print_dec(zram.incompressible);
+    print_string("\n  - ");
+    print_dec(errors);
+    print_string(" errors; after exit: ");
+    print_dec(zram.stored);
+    print_string(" slots stored, free pages ");
+    print_dec(free_before);
+    print_string(" before, ");
+    print_dec(pmm_get_free_pages_count());
+    print_string(" after\n");
+
+    serial_write_string("zrambench pages=");
+    serial_write_dec(pages);
+    serial_write_string(" swapped=");
+    serial_write_dec(swapped);
+    serial_write_string(" same_filled=");
+    serial_write_dec(same_filled);
+    serial_write_string(" compressed_bytes=");
+    serial_write_dec(compressed);
+    serial_write_string(" swapin_cycles=");
+    serial_write_dec(per_swapin);
+    serial_write_string(" errors=");
+    serial_write_dec(errors);
+    serial_write_string("\n");
 }
 
+/* Параметры numa_benchmark */
+#define NUMABENCH_PAGES 2048                 /* 8MB - больше кэшей процессора */
+#define NUMABENCH_STEPS (1u << 20)           /* Переходов по цепочке указателей */
+#define NUMABENCH_LINES (PAGE_SIZE / 64)
+
+/* Страницы буфера одного узла */
+static uint32_t numabench_pages[NUMABENCH_PAGES];
+
 /**
- * @brief Запуск всех тестов менеджера памяти
+ * @brief Латентность чтения: цепочка указателей по страницам в случайном порядке
+ *
+ * В каждой странице занята одна строка кэша, смещение меняется от
+ * страницы к странице, чтобы не нагружать один набор кэша.
+ * @return Тактов на чтение
  */
-void run_memory_tests(void) {
-    print_string("\nStarting Memory Manager Tests...\n");
-    
-    test_pmm();
-    test_heap();
-    
-    print_string("\nMemory Manager Tests Completed!\n");
-} 
\ No newline at end of file
+static uint32_t numabench_chase(uint32_t count, uint32_t seed) {
+    for (uint32_t i = count - 1; i > 0; i--) {
+        uint32_t j = bench_random(&seed) % (i + 1);
+        uint32_t page = numabench_pages[i];
+        numabench_pages[i] = numabench_pages[j];
+        numabench_pages[j] = page;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t next = (i + 1) % count;
+        uint32_t *slot = (uint32_t*)(numabench_pages[i] + (i % NUMABENCH_LINES) * 64);
+        *slot = numabench_pages[next] + (next % NUMABENCH_LINES) * 64;
+    }
+
+    uint32_t *cursor = (uint32_t*)numabench_pages[0];
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < NUMABENCH_STEPS; i++) {
+        cursor = (uint32_t*)*(volatile uint32_t*)cursor;
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+    __asm__ volatile("" : : "r"(cursor));
+    return cycles / NUMABENCH_STEPS;
+}
+
+/**
+ * @brief Выделение и латентность памяти каждого узла NUMA (команда numabench)
+ *
+ * Для каждого узла буфер выделяется через pmm_alloc_pages_node и
+ * обходится цепочкой указателей из процессора ядра: свой узел против
+ * удалённых. Показывает, сколько страниц действительно пришло с узла.
+ */
+void numa_benchmark(void) {
+    pmm_t *pmm = &physical_memory_manager;
+    print_string("\nNUMA local vs remote benchmark:\n");
+    print_string("  - ");
+    print_dec(pmm->node_count);
+    print_string(" node(s), CPU on node ");
+    print_dec(pmm->local_node);
+    print_string(pmm->node_count == 1 ? " (single node: nothing is remote)\n" : "\n");
+
+    for (uint32_t node = 0; node < pmm->node_count; node++) {
+        uint32_t free = 0;
+        for (uint32_t type = 0; type < PMM_ZONE_COUNT; type++) {
+            if (pmm->nodes[node].zones[type]) {
+                free += pmm->nodes[node].zones[type]->free_pages;
+            }
+        }
+        uint32_t count = free / 2 < NUMABENCH_PAGES ? free / 2 : NUMABENCH_PAGES;
+        if (count < 2) {
+            print_string("  - Node ");
+            print_dec(node);
+            print_string(": not enough free memory\n");
+            continue;
+        }
+
+        uint32_t on_node = 0;
+        uint32_t allocated = 0;
+        uint64_t start = rdtsc();
+        for (; allocated < count; allocated++) {
+            uint32_t page = pmm_alloc_pages_node(0, node);
+            if (!page) {
+                break;
+            }
+            numabench_pages[allocated] = page;
+        }
+        uint32_t alloc_cycles = allocated ? (uint32_t)(rdtsc() - start) / allocated : 0;
+        for (uint32_t i = 0; i < allocated; i++) {
+            if (pmm_page_node(numabench_pages[i]) == (int32_t)node) {
+                on_node++;
+            }
+        }
+
+        uint32_t load_cycles = allocated >= 2 ? numabench_chase(allocated, 0x9E3779B9 + node) : 0;
+        for (uint32_t i = 0; i < allocated; i++) {
+            pmm_free_page(numabench_pages[i]);
+        }
+
+        uint32_t distance = pmm->nodes[pmm->local_node].distance[node];
+        print_string("  - Node ");
+        print_dec(node);
+        print_string(node == pmm->local_node ? " (local, distance " : " (remote, distance ");
+        print_dec(distance);
+        print_string("): ");
+        print_dec(on_node);
+        print_string("/");
+        print_dec(allocated);
+        print_string(" pages on node, ");
+        print_dec(alloc_cycles);
+        print_string(" cycles/alloc, ");
+        print_dec(load_cycles);
+        print_string(" cycles/load\n");
+
+        serial_write_string("numabench node=");
+        serial_write_dec(node);
+        serial_write_string(" distance=");
+        serial_write_dec(distance);
+        serial_write_string(" pages=");
+        serial_write_dec(allocated);
+        serial_write_string(" on_node=");
+        serial_write_dec(on_node);
+        serial_write_string(" alloc_cycles=");
+        serial_write_dec(alloc_cycles);
+        serial_write_string(" load_cycles=");
+        serial_write_dec(load_cycles);
+        serial_write_string("\n");
+    }
+}
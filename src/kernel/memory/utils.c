@@ -3,10 +3,14 @@
  * @brief Вспомогательные функции для работы с памятью
  * 
  * Реализация базовых операций с памятью: копирование, заполнение,
- * выравнивание адресов и размеров
+ * выравнивание адресов и размеров. Копирование и заполнение идут
+ * строковыми инструкциями (rep movs/stos) в варианте, выбранном один
+ * раз при загрузке по CPUID (memory_primitives_init)
  */
 
 #include "memory.h"
+#include "../cpu/cpu.h"
+#include "../cpu/fpu.h"
 
 /**
  * @brief Выравнивание адреса вверх
@@ -28,21 +32,199 @@ uint32_t align_down(uint32_t addr, uint32_t align) {
     return addr & ~(align - 1);
 }
 
+/* Выбранный при загрузке вариант примитивов (маска MEMORY_FEATURE_*) */
+static uint32_t memory_features = 0;
+
+/**
+ * @brief Выбор варианта примитивов по возможностям процессора
+ *
+ * Вызывается один раз при загрузке до первого обращения к memory_*:
+ * дальше операции только проверяют готовую маску. SSE2-путь включается,
+ * лишь если XMM-регистры уже разрешены (CR4.OSFXSR, см. fpu_init), иначе
+ * первая SSE-инструкция вызовет #UD. Сами SSE2-варианты выполняются
+ * внутри kernel_fpu_begin/end.
+ */
+void memory_primitives_init(void) {
+    uint32_t max_leaf, eax, ebx, ecx, edx;
+
+    memory_features = 0;
+    cpuid(0, &max_leaf, &ebx, &ecx, &edx);
+
+    if (max_leaf >= 7) {
+        cpuid(7, &eax, &ebx, &ecx, &edx);
+        if (ebx & CPUID_EBX7_ERMS) {
+            memory_features |= MEMORY_FEATURE_ERMS;
+        }
+    }
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if ((edx & CPUID_EDX_SSE2) && (read_cr4() & CR4_OSFXSR)) {
+        memory_features |= MEMORY_FEATURE_SSE2;
+    }
+}
+
+/**
+ * @brief Получение выбранного варианта примитивов
+ * @return Маска MEMORY_FEATURE_*
+ */
+uint32_t memory_get_features(void) {
+    return memory_features;
+}
+
+/**
+ * @brief Заполнение большого блока невременными записями SSE2
+ *
+ * movntdq пишет мимо кэша и не вытесняет рабочие данные. Голова до
+ * границы 16 байт и хвост короче 64 байт заполняются rep stosb.
+ * @param d Начало области (count >= MEMORY_NT_THRESHOLD)
+ */
+__attribute__((target("sse2")))
+static void memory_set_sse2(uint8_t* d, uint8_t val, size_t count) {
+    uint32_t pattern = MEMORY_SPLAT(val);
+    size_t head = (0u - (uint32_t)d) & 15;
+    size_t blocks, tail;
+
+    count -= head;
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(head) : "a"(val) : "memory");
+
+    blocks = count >> 6;
+    tail = count & 63;
+    __asm__ volatile("movd %2, %%xmm0\n\t"
+                     "pshufd $0, %%xmm0, %%xmm0\n\t"
+                     "1:\n\t"
+                     "movntdq %%xmm0, 0(%0)\n\t"
+                     "movntdq %%xmm0, 16(%0)\n\t"
+                     "movntdq %%xmm0, 32(%0)\n\t"
+                     "movntdq %%xmm0, 48(%0)\n\t"
+                     "add $64, %0\n\t"
+                     "dec %1\n\t"
+                     "jnz 1b\n\t"
+                     "sfence"
+                     : "+r"(d), "+r"(blocks)
+                     : "r"(pattern)
+                     : "xmm0", "memory", "cc");
+
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(tail) : "a"(val) : "memory");
+}
+
+/**
+ * @brief Копирование большого блока невременными записями SSE2
+ *
+ * Назначение выравнивается до 16 байт, источник читается movdqu
+ * (выравнивание не требуется), запись идёт мимо кэша.
+ * @param d Назначение (count >= MEMORY_NT_THRESHOLD, без перекрытия)
+ */
+__attribute__((target("sse2")))
+static void memory_copy_sse2(uint8_t* d, const uint8_t* s, size_t count) {
+    size_t head = (0u - (uint32_t)d) & 15;
+    size_t blocks, tail;
+
+    count -= head;
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(head) : : "memory");
+
+    blocks = count >> 6;
+    tail = count & 63;
+    __asm__ volatile("1:\n\t"
+                     "movdqu 0(%1), %%xmm0\n\t"
+                     "movdqu 16(%1), %%xmm1\n\t"
+                     "movdqu 32(%1), %%xmm2\n\t"
+                     "movdqu 48(%1), %%xmm3\n\t"
+                     "movntdq %%xmm0, 0(%0)\n\t"
+                     "movntdq %%xmm1, 16(%0)\n\t"
+                     "movntdq %%xmm2, 32(%0)\n\t"
+                     "movntdq %%xmm3, 48(%0)\n\t"
+                     "add $64, %1\n\t"
+                     "add $64, %0\n\t"
+                     "dec %2\n\t"
+                     "jnz 1b\n\t"
+                     "sfence"
+                     : "+r"(d), "+r"(s), "+r"(blocks)
+                     :
+                     : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(tail) : : "memory");
+}
+
+/**
+ * @brief Порция для одной секции kernel_fpu_begin/end
+ *
+ * Остаток короче двух порций идёт целиком: последняя порция не бывает
+ * меньше MEMORY_FPU_CHUNK, а SSE2-вариантам нужен хотя бы один блок.
+ */
+static size_t memory_fpu_chunk(size_t count) {
+    return count >= 2 * MEMORY_FPU_CHUNK ? MEMORY_FPU_CHUNK : count;
+}
+
 /**
  * @brief Заполнение области памяти значением
+ *
+ * Области короче MEMORY_SMALL - побайтово, до MEMORY_REP_MIN - словами.
+ * Длинные - rep stosb при ERMS, иначе выравнивание до 4 байт и rep stosl;
+ * блоки от MEMORY_NT_THRESHOLD при доступном SSE2 - невременными записями,
+ * порциями по MEMORY_FPU_CHUNK: между ними разрешаются прерывания.
  * @param dest Указатель на начало области
  * @param val Значение для заполнения
  * @param count Количество байт для заполнения
  */
 void memory_set(void* dest, uint8_t val, size_t count) {
-    uint8_t* ptr = (uint8_t*)dest;
-    for (size_t i = 0; i < count; i++) {
-        ptr[i] = val;
+    uint8_t* d = (uint8_t*)dest;
+    size_t head, words;
+
+    if (count < MEMORY_SMALL) {
+        for (size_t i = 0; i < count; i++) {
+            d[i] = val;
+        }
+        return;
+    }
+
+    if (count < MEMORY_REP_MIN) {
+        uint32_t pattern = MEMORY_SPLAT(val);
+        while ((uint32_t)d & 3) {
+            *d++ = val;
+            count--;
+        }
+        for (; count >= 4; count -= 4, d += 4) {
+            *(memory_word_t*)d = pattern;
+        }
+        while (count--) {
+            *d++ = val;
+        }
+        return;
     }
+
+    if ((memory_features & MEMORY_FEATURE_SSE2) && count >= MEMORY_NT_THRESHOLD) {
+        while (count) {
+            size_t chunk = memory_fpu_chunk(count);
+            kernel_fpu_begin();
+            memory_set_sse2(d, val, chunk);
+            kernel_fpu_end();
+            d += chunk;
+            count -= chunk;
+        }
+        return;
+    }
+
+    if (memory_features & MEMORY_FEATURE_ERMS) {
+        __asm__ volatile("rep stosb" : "+D"(d), "+c"(count) : "a"(val) : "memory");
+        return;
+    }
+
+    head = (0u - (uint32_t)d) & 3;
+    count -= head;
+    words = count >> 2;
+    count &= 3;
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(head) : "a"(val) : "memory");
+    __asm__ volatile("rep stosl" : "+D"(d), "+c"(words) : "a"(MEMORY_SPLAT(val)) : "memory");
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(count) : "a"(val) : "memory");
 }
 
 /**
  * @brief Копирование области памяти
+ *
+ * Вперёд - тем же выбором вариантов, что и memory_set. При перекрытии
+ * с назначением выше источника копирование идёт назад: хвостовые байты
+ * по одному, затем слова через std; rep movsl. Флаг DF сбрасывается
+ * до разрешения прерываний, обработчики рассчитывают на DF = 0.
  * @param dest Указатель на назначение
  * @param src Указатель на источник
  * @param count Количество байт для копирования
@@ -50,23 +232,90 @@ void memory_set(void* dest, uint8_t val, size_t count) {
 void memory_copy(void* dest, const void* src, size_t count) {
     uint8_t* d = (uint8_t*)dest;
     const uint8_t* s = (const uint8_t*)src;
-    
+    size_t head, words;
+
     /* Проверяем перекрытие областей */
     if (d < s || d >= s + count) {
-        /* Копируем вперед */
-        for (size_t i = 0; i < count; i++) {
-            d[i] = s[i];
+        if (count < MEMORY_SMALL) {
+            for (size_t i = 0; i < count; i++) {
+                d[i] = s[i];
+            }
+            return;
         }
-    } else {
-        /* Копируем назад для избежания перекрытия */
+
+        if (count < MEMORY_REP_MIN) {
+            while ((uint32_t)d & 3) {
+                *d++ = *s++;
+                count--;
+            }
+            for (; count >= 4; count -= 4, d += 4, s += 4) {
+                *(memory_word_t*)d = *(const memory_word_t*)s;
+            }
+            while (count--) {
+                *d++ = *s++;
+            }
+            return;
+        }
+
+        if ((memory_features & MEMORY_FEATURE_SSE2) && count >= MEMORY_NT_THRESHOLD) {
+            while (count) {
+                size_t chunk = memory_fpu_chunk(count);
+                kernel_fpu_begin();
+                memory_copy_sse2(d, s, chunk);
+                kernel_fpu_end();
+                d += chunk;
+                s += chunk;
+                count -= chunk;
+            }
+            return;
+        }
+
+        if (memory_features & MEMORY_FEATURE_ERMS) {
+            __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(count) : : "memory");
+            return;
+        }
+
+        head = (0u - (uint32_t)d) & 3;
+        count -= head;
+        words = count >> 2;
+        count &= 3;
+        __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(head) : : "memory");
+        __asm__ volatile("rep movsl" : "+D"(d), "+S"(s), "+c"(words) : : "memory");
+        __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(count) : : "memory");
+        return;
+    }
+
+    /* Копируем назад для избежания перекрытия */
+    if (count < MEMORY_SMALL) {
         for (size_t i = count; i > 0; i--) {
             d[i-1] = s[i-1];
         }
+        return;
     }
+
+    while (count & 3) {
+        count--;
+        d[count] = s[count];
+    }
+    words = count >> 2;
+    d += count - 4;
+    s += count - 4;
+    __asm__ volatile("pushfl\n\t"
+                     "cli\n\t"
+                     "std\n\t"
+                     "rep movsl\n\t"
+                     "cld\n\t"
+                     "popfl"
+                     : "+D"(d), "+S"(s), "+c"(words)
+                     :
+                     : "memory", "cc");
 }
 
 /**
  * @brief Сравнение областей памяти
+ *
+ * Области сравниваются словами по 4 байта; первое различающееся слово
+ * доразбирается побайтно, чтобы знак результата был как у memcmp.
  * @param ptr1 Указатель на первую область
  * @param ptr2 Указатель на вторую область
  * @param count Количество байт для сравнения
@@ -76,18 +325,29 @@ void memory_copy(void* dest, const void* src, size_t count) {
 int memory_compare(const void* ptr1, const void* ptr2, size_t count) {
     const uint8_t* p1 = (const uint8_t*)ptr1;
     const uint8_t* p2 = (const uint8_t*)ptr2;
-    
+
+    while (count >= 4 && *(const memory_word_t*)p1 == *(const memory_word_t*)p2) {
+        p1 += 4;
+        p2 += 4;
+        count -= 4;
+    }
+
     for (size_t i = 0; i < count; i++) {
         if (p1[i] != p2[i]) {
             return (int)p1[i] - (int)p2[i];
         }
     }
-    
+
     return 0;
 }
 
 /**
  * @brief Поиск символа в области памяти
+ *
+ * После выравнивания до 4 байт проверяется сразу слово: XOR с
+ * размноженным значением обнуляет совпавшие байты, а MEMORY_HAS_ZERO
+ * находит нулевой байт без ветвления по каждому байту. Выровненное
+ * чтение не пересекает границу страницы.
  * @param ptr Указатель на область памяти
  * @param value Искомое значение
  * @param count Размер области в байтах
@@ -95,13 +355,31 @@ int memory_compare(const void* ptr1, const void* ptr2, size_t count) {
  */
 void* memory_find(const void* ptr, uint8_t value, size_t count) {
     const uint8_t* p = (const uint8_t*)ptr;
-    
+    uint32_t pattern = MEMORY_SPLAT(value);
+
+    while (count && ((uint32_t)p & 3)) {
+        if (*p == value) {
+            return (void*)p;
+        }
+        p++;
+        count--;
+    }
+
+    while (count >= 4) {
+        uint32_t word = *(const memory_word_t*)p ^ pattern;
+        if (MEMORY_HAS_ZERO(word)) {
+            break;
+        }
+        p += 4;
+        count -= 4;
+    }
+
     for (size_t i = 0; i < count; i++) {
         if (p[i] == value) {
             return (void*)(p + i);
         }
     }
-    
+
     return NULL;
 }
 
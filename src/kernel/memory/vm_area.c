@@ -0,0 +1,227 @@
+/**
+ * @file vm_area.c
+ * @brief Области виртуального окна ядра и выделение страниц по требованию
+ *
+ * vm_reserve выделяет диапазон окна VMM_VIRT_BASE..VMM_VIRT_END, не
+ * трогая физическую память. В области VM_DEMAND страница появляется
+ * при первом обращении: чтение отображает общую нулевую страницу только
+ * для чтения, запись - свежую обнулённую страницу PMM. С VM_FAULT_AROUND
+ * одна ошибка заполняет весь выровненный блок VM_FAULT_AROUND_PAGES.
+ * Большая разреженная структура стоит столько памяти, сколько в ней
+ * реально затронуто.
+ */
+
+#include "memory.h"
+#include "../video/video.h"
+#include "../idt/exceptions.h"
+
+/* Кэш дескрипторов областей */
+static kmem_cache_t *vm_area_cache = NULL;
+
+/**
+ * @brief Флаги страниц для отображений окна
+ */
+static uint32_t vm_page_flags(uint32_t writable) {
+    uint32_t flags = kernel_vmm.pge ? VMM_GLOBAL : 0;
+    return writable ? flags | VMM_WRITE : flags;
+}
+
+/**
+ * @brief Поиск области, содержащей адрес
+ * @return Область или NULL
+ */
+vm_area_t* vm_find_area(uint32_t addr) {
+    for (vm_area_t *area = kernel_vmm.areas; area && area->start <= addr; area = area->next) {
+        if (addr < area->end) {
+            return area;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Резервирование области окна ядра
+ *
+ * Первый подходящий промежуток между областями; за каждой областью
+ * остаётся неотображённая страница-разделитель, ловящая выход за край.
+ * Без VM_DEMAND страницы отображает сам владелец через map_page.
+ * @param size Размер в байтах (округляется до страницы)
+ * @param flags VM_WRITE, VM_DEMAND, VM_FAULT_AROUND
+ * @return Начало области или NULL
+ */
+void* vm_reserve(size_t size, uint32_t flags) {
+    if (size == 0 || size > VMM_VIRT_END - VMM_VIRT_BASE) {
+        return NULL;
+    }
+    size = align_up(size, PAGE_SIZE);
+
+    if (!vm_area_cache) {
+        vm_area_cache = kmem_cache_create("vm_area", sizeof(vm_area_t), SLAB_MIN_SIZE);
+        if (!vm_area_cache) {
+            return NULL;
+        }
+    }
+    if ((flags & VM_DEMAND) && !kernel_vmm.zero_page) {
+        kernel_vmm.zero_page = pmm_alloc_page_zeroed();
+        if (!kernel_vmm.zero_page) {
+            return NULL;
+        }
+    }
+
+    vm_area_t **link = &kernel_vmm.areas;
+    uint32_t start = VMM_VIRT_BASE;
+    while (*link && (*link)->start - start < size + PAGE_SIZE) {
+        start = (*link)->end + PAGE_SIZE;
+        link = &(*link)->next;
+    }
+    if (start >= VMM_VIRT_END || VMM_VIRT_END - start < size) {
+        return NULL;
+    }
+
+    vm_area_t *area = kmem_cache_alloc(vm_area_cache);
+    if (!area) {
+        return NULL;
+    }
+    area->start = start;
+    area->end = start + size;
+    area->flags = flags;
+    area->resident = 0;
+    area->next = *link;
+    *link = area;
+
+    return (void*)start;
+}
+
+/**
+ * @brief Освобождение области
+ *
+ * Отображения снимаются одним пакетом. Страницы, выделенные по
+ * требованию, возвращаются PMM; страницы областей без VM_DEMAND
+ * принадлежат владельцу и не освобождаются.
+ * @param addr Начало области, полученное от vm_reserve
+ */
+void vm_release(void *addr) {
+    vm_area_t **link = &kernel_vmm.areas;
+    while (*link && (*link)->start != (uint32_t)addr) {
+        link = &(*link)->next;
+    }
+    vm_area_t *area = *link;
+    if (!area) {
+        return;
+    }
+
+    vmm_batch_begin();
+    for (uint32_t page = area->start; page < area->end; page += PAGE_SIZE) {
+        uint32_t phys = virt_to_phys(page);
+        if (!phys) {
+            continue;
+        }
+        unmap_page(page);
+        if ((area->flags & VM_DEMAND) && phys != kernel_vmm.zero_page) {
+            pmm_free_page(phys & PAGE_MASK);
+        }
+    }
+    vmm_batch_end();
+
+    *link = area->next;
+    kmem_cache_free(vm_area_cache, area);
+}
+
+/**
+ * @brief Выделение и отображение обнулённой страницы области
+ * @return 0 при успехе, -1 при нехватке памяти
+ */
+static int vm_populate(vm_area_t *area, uint32_t page) {
+    uint32_t phys = pmm_alloc_page_zeroed();
+    if (!phys) {
+        return -1;
+    }
+    if (map_page(page, phys, vm_page_flags(1)) != 0) {
+        pmm_free_page(phys);
+        return -1;
+    }
+    area->resident++;
+    kernel_vmm.populated++;
+    return 0;
+}
+
+/**
+ * @brief Обработка ошибки страницы (#PF)
+ *
+ * Чтение отсутствующей страницы отображает нулевую страницу, запись -
+ * выделяет новую (в том числе вместо нулевой, при ошибке защиты).
+ * Соседние отсутствующие страницы блока fault-around получают то же.
+ * Ошибки в пользовательской части адресного пространства разбирает
+ * mm_handle_fault (копирование при записи, возврат из zram).
+ * @param addr Адрес ошибки (CR2)
+ * @param error Код ошибки процессора (PF_ERR_*)
+ * @return 0 если ошибка обработана, -1 если это настоящая ошибка
+ */
+int vmm_handle_fault(uint32_t addr, uint32_t error) {
+    if (addr >= MM_USER_BASE && addr < MM_USER_END) {
+        return mm_handle_fault(addr, error);
+    }
+
+    vm_area_t *area = vm_find_area(addr);
+    if (!area || !(area->flags & VM_DEMAND) || (error & PF_ERR_USER)) {
+        return -1;
+    }
+
+    int write = (error & PF_ERR_WRITE) != 0;
+    if (write && !(area->flags & VM_WRITE)) {
+        return -1;
+    }
+
+    uint32_t page = addr & PAGE_MASK;
+    if (error & PF_ERR_PRESENT) {
+        /* Защита нарушается только записью в нулевую страницу */
+        if (!write || virt_to_phys(page) != kernel_vmm.zero_page) {
+            return -1;
+        }
+    }
+
+    kernel_vmm.faults++;
+
+    uint32_t first = page;
+    uint32_t last = page + PAGE_SIZE;
+    if (area->flags & VM_FAULT_AROUND) {
+        first = align_down(page, VM_FAULT_AROUND_PAGES * PAGE_SIZE);
+        last = first + VM_FAULT_AROUND_PAGES * PAGE_SIZE;
+        if (first < area->start) {
+            first = area->start;
+        }
+        if (last > area->end) {
+            last = area->end;
+        }
+    }
+
+    vmm_batch_begin();
+
+    /* Сначала сама страница (запись - даже поверх нулевой) */
+    int result = write ? vm_populate(area, page)
+                       : map_page(page, kernel_vmm.zero_page, vm_page_flags(0));
+    if (result == 0 && !write) {
+        kernel_vmm.zero_maps++;
+    }
+
+    /* Затем отсутствующие соседи; без них можно обойтись */
+    for (uint32_t p = first; result == 0 && p < last; p += PAGE_SIZE) {
+        if (p == page || virt_to_phys(p)) {
+            continue;
+        }
+        if (write) {
+            if (vm_populate(area, p) != 0) {
+                break;
+            }
+            kernel_vmm.fault_around++;
+        } else {
+            if (map_page(p, kernel_vmm.zero_page, vm_page_flags(0)) != 0) {
+                break;
+            }
+            kernel_vmm.zero_maps++;
+        }
+    }
+
+    vmm_batch_end();
+    return result;
+}
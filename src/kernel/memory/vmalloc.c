@@ -0,0 +1,151 @@
+/**
+ * @file vmalloc.c
+ * @brief Виртуально непрерывные выделения из разрозненных страниц
+ *
+ * vmalloc резервирует область окна ядра и отображает в неё отдельные
+ * страницы PMM: буфер в несколько мегабайт не требует физически
+ * непрерывного блока и выделяется даже на фрагментированной памяти.
+ *
+ * vfree снимает отображения без сброса TLB и сразу возвращает
+ * страницы PMM, а сама область остаётся занятой (VM_LAZY_FREE), пока
+ * адрес может жить в TLB. vmalloc_purge одним полным сбросом TLB
+ * освобождает все такие области разом - вместо invlpg на каждую
+ * страницу каждого vfree.
+ */
+
+#include "memory.h"
+
+/**
+ * @brief Снятие отображений области и возврат её страниц PMM
+ * @param flush Сбрасывать TLB сразу (иначе - при vmalloc_purge)
+ * @return Освобождено страниц
+ */
+static uint32_t vmalloc_unmap(vm_area_t *area, int flush) {
+    uint32_t pages = 0;
+    for (uint32_t page = area->start; page < area->end; page += PAGE_SIZE) {
+        uint32_t phys = virt_to_phys(page);
+        if (!phys) {
+            continue;
+        }
+        if (flush) {
+            unmap_page(page);
+        } else {
+            unmap_page_noflush(page);
+        }
+        pmm_free_page(phys & PAGE_MASK);
+        pages++;
+    }
+    return pages;
+}
+
+/**
+ * @brief Выделение виртуально непрерывной памяти
+ *
+ * Если окно исчерпано, сначала освобождаются области, ждущие сброса TLB.
+ * Содержимое страниц не обнуляется.
+ * @param size Размер в байтах (округляется до страницы)
+ * @return Адрес в окне ядра или NULL
+ */
+void* vmalloc(size_t size) {
+    void *addr = vm_reserve(size, VM_WRITE | VM_VMALLOC);
+    if (!addr && kernel_vmm.lazy_pages) {
+        vmalloc_purge();
+        addr = vm_reserve(size, VM_WRITE | VM_VMALLOC);
+    }
+    if (!addr) {
+        return NULL;
+    }
+    vm_area_t *area = vm_find_area((uint32_t)addr);
+
+    uint32_t flags = VMM_WRITE | (kernel_vmm.pge ? VMM_GLOBAL : 0);
+    for (uint32_t page = area->start; page < area->end; page += PAGE_SIZE) {
+        uint32_t phys = pmm_alloc_page();
+        if (!phys) {
+            break;
+        }
+        pmm_set_page_flags(phys, 1, PG_VMALLOC);
+        if (map_page(page, phys, flags) != 0) {
+            pmm_free_page(phys);
+            break;
+        }
+        area->resident++;
+    }
+
+    uint32_t pages = (area->end - area->start) >> PAGE_SHIFT;
+    if (area->resident < pages) {
+        /* Отображения ещё не использовались - их можно снять сразу */
+        vmm_batch_begin();
+        vmalloc_unmap(area, 1);
+        vmm_batch_end();
+        vm_release(addr);
+        return NULL;
+    }
+
+    kernel_vmm.vmalloc_pages += pages;
+    return addr;
+}
+
+/**
+ * @brief Выделение обнулённой виртуально непрерывной памяти
+ * @param size Размер в байтах
+ * @return Адрес в окне ядра или NULL
+ */
+void* vzalloc(size_t size) {
+    void *addr = vmalloc(size);
+    if (addr) {
+        memory_set(addr, 0, align_up(size, PAGE_SIZE));
+    }
+    return addr;
+}
+
+/**
+ * @brief Освобождение памяти vmalloc
+ *
+ * Страницы возвращаются PMM сразу, адресное пространство - после
+ * сброса TLB, когда ожидающих страниц наберётся VMALLOC_LAZY_MAX.
+ * @param addr Адрес, полученный от vmalloc (NULL игнорируется)
+ */
+void vfree(void *addr) {
+    if (!addr) {
+        return;
+    }
+
+    vm_area_t *area = vm_find_area((uint32_t)addr);
+    if (!area || area->start != (uint32_t)addr ||
+        (area->flags & (VM_VMALLOC | VM_LAZY_FREE)) != VM_VMALLOC) {
+        return;
+    }
+
+    uint32_t pages = vmalloc_unmap(area, 0);
+    area->resident = 0;
+    area->flags |= VM_LAZY_FREE;
+    kernel_vmm.vmalloc_pages -= pages;
+    kernel_vmm.lazy_pages += pages;
+
+    if (kernel_vmm.lazy_pages >= VMALLOC_LAZY_MAX) {
+        vmalloc_purge();
+    }
+}
+
+/**
+ * @brief Сброс TLB и освобождение областей, ждущих его
+ */
+void vmalloc_purge(void) {
+    if (!kernel_vmm.lazy_pages) {
+        return;
+    }
+
+    vmm_flush_all();
+
+    vm_area_t *area = kernel_vmm.areas;
+    while (area) {
+        vm_area_t *next = area->next;
+        if (area->flags & VM_LAZY_FREE) {
+            vm_release((void*)area->start);
+        }
+        area = next;
+    }
+
+    kernel_vmm.lazy_pages = 0;
+    kernel_vmm.purges++;
+}
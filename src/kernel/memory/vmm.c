@@ -0,0 +1,413 @@
+/**
+ * @file vmm.c
+ * @brief Менеджер виртуальной памяти: каталог страниц ядра
+ *
+ * Физическая память отображается 1:1 страницами PSE по 4MB с флагом
+ * G (PGE): вся память ядра занимает несколько записей TLB, и они
+ * переживают смену CR3. Таблицы по 4KB создаются только там, где нужна
+ * мелкая гранулярность: первые 4MB (страница 0 не отображается, чтобы
+ * разыменование NULL давало #PF) и страницы 4MB, которые разбивает
+ * map_page/unmap_page. Сброс TLB копится в пакете и выполняется одной
+ * серией invlpg (или полным сбросом) в vmm_batch_end.
+ */
+
+#include "memory.h"
+#include "../video/video.h"
+#include "../cpu/cpu.h"
+
+/* Флаги записи каталога, ссылающейся на таблицу: права задаёт запись таблицы */
+#define VMM_TABLE_FLAGS (VMM_PRESENT | VMM_WRITE | VMM_USER)
+
+vmm_t kernel_vmm;
+
+/**
+ * @brief Выделение обнулённой страницы под таблицу или каталог
+ */
+static uint32_t* vmm_alloc_table(void) {
+    uint32_t page = pmm_alloc_page();
+    if (!page) {
+        return NULL;
+    }
+    pmm_set_page_flags(page, 1, PG_PAGETABLE);
+    memory_set((void*)page, 0, PAGE_SIZE);
+    kernel_vmm.tables++;
+    return (uint32_t*)page;
+}
+
+/**
+ * @brief Запись каталога ядра
+ *
+ * Каталоги адресных пространств копируют записи ядра при создании,
+ * поэтому новая запись разносится и по ним.
+ */
+static void vmm_set_pde(uint32_t index, uint32_t value) {
+    kernel_vmm.directory[index] = value;
+    if (index >= (MM_USER_BASE >> VMM_LARGE_PAGE_SHIFT) && index < (MM_USER_END >> VMM_LARGE_PAGE_SHIFT)) {
+        return;
+    }
+    for (mm_t *mm = kernel_vmm.mms; mm; mm = mm->next) {
+        mm->directory[index] = value;
+    }
+}
+
+/**
+ * @brief Выполнение отложенных invlpg
+ */
+static void vmm_flush_pending(void) {
+    if (kernel_vmm.pending_all) {
+        vmm_flush_all();
+    } else {
+        for (uint32_t i = 0; i < kernel_vmm.pending_count; i++) {
+            invlpg(kernel_vmm.pending[i]);
+        }
+        kernel_vmm.invlpgs += kernel_vmm.pending_count;
+    }
+    kernel_vmm.pending_count = 0;
+    kernel_vmm.pending_all = 0;
+}
+
+/**
+ * @brief Постановка страницы в очередь сброса TLB
+ *
+ * Вне пакета сброс выполняется сразу. Переполнение очереди заменяет
+ * её полным сбросом TLB в конце пакета.
+ */
+static void vmm_queue_flush(uint32_t virt) {
+    if (kernel_vmm.pending_count < VMM_FLUSH_BATCH) {
+        kernel_vmm.pending[kernel_vmm.pending_count++] = virt & PAGE_MASK;
+    } else {
+        kernel_vmm.pending_all = 1;
+    }
+
+    if (kernel_vmm.batch_depth == 0) {
+        vmm_flush_pending();
+    }
+}
+
+/**
+ * @brief Таблица страниц, покрывающая адрес
+ *
+ * Страница 4MB разбивается на таблицу с тем же отображением, чтобы
+ * одну её страницу можно было изменить.
+ * @param virt Виртуальный адрес
+ * @param create Создать таблицу, если запись каталога пуста
+ * @return Таблица или NULL (нет таблицы и create = 0, либо нет памяти)
+ */
+static uint32_t* vmm_table_for(uint32_t virt, int create) {
+    uint32_t index = virt >> VMM_LARGE_PAGE_SHIFT;
+    uint32_t *pde = &kernel_vmm.directory[index];
+
+    if (!(*pde & VMM_PRESENT)) {
+        if (!create) {
+            return NULL;
+        }
+        uint32_t *table = vmm_alloc_table();
+        if (!table) {
+            return NULL;
+        }
+        vmm_set_pde(index, (uint32_t)table | VMM_TABLE_FLAGS);
+        return table;
+    }
+
+    if (*pde & VMM_LARGE) {
+        uint32_t *table = vmm_alloc_table();
+        if (!table) {
+            return NULL;
+        }
+        uint32_t base = *pde & ~(VMM_LARGE_PAGE_SIZE - 1);
+        uint32_t flags = *pde & VMM_FLAGS_MASK & ~(VMM_LARGE | VMM_ACCESSED | VMM_DIRTY);
+        for (uint32_t i = 0; i < VMM_ENTRIES; i++) {
+            table[i] = (base + i * PAGE_SIZE) | flags;
+        }
+        vmm_set_pde(index, (uint32_t)table | VMM_TABLE_FLAGS);
+        kernel_vmm.large_pages--;
+        kernel_vmm.splits++;
+        /* invlpg по любому адресу страницы 4MB убирает её запись TLB */
+        vmm_queue_flush(virt);
+        return table;
+    }
+
+    return (uint32_t*)(*pde & PAGE_MASK);
+}
+
+/**
+ * @brief Построение каталога ядра и включение страничной адресации
+ *
+ * Вызывается после pmm_init: каталог и таблицы берутся у PMM.
+ */
+void vmm_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    print_string("VMM Initialization... ");
+
+    memory_set(&kernel_vmm, 0, sizeof(vmm_t));
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    kernel_vmm.pse = (edx & CPUID_EDX_PSE) != 0;
+    kernel_vmm.pge = (edx & CPUID_EDX_PGE) != 0;
+
+    kernel_vmm.directory = vmm_alloc_table();
+    if (!kernel_vmm.directory) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+
+    uint32_t top = physical_memory_manager.total_pages << PAGE_SHIFT;
+    kernel_vmm.identity_end = align_up(top, VMM_LARGE_PAGE_SIZE);
+    if (kernel_vmm.identity_end == 0 || kernel_vmm.identity_end > VMM_IDENTITY_LIMIT) {
+        kernel_vmm.identity_end = VMM_IDENTITY_LIMIT;
+    }
+
+    uint32_t global = kernel_vmm.pge ? VMM_GLOBAL : 0;
+    for (uint32_t addr = 0; addr < kernel_vmm.identity_end; addr += VMM_LARGE_PAGE_SIZE) {
+        /* Первые 4MB - таблицей: страница 0 остаётся неотображённой */
+        if (addr == 0 || !kernel_vmm.pse) {
+            uint32_t *table = vmm_alloc_table();
+            if (!table) {
+                print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+                return;
+            }
+            for (uint32_t i = (addr == 0) ? 1 : 0; i < VMM_ENTRIES; i++) {
+                table[i] = (addr + i * PAGE_SIZE) | VMM_PRESENT | VMM_WRITE | global;
+            }
+            kernel_vmm.directory[addr >> VMM_LARGE_PAGE_SHIFT] = (uint32_t)table | VMM_TABLE_FLAGS;
+            continue;
+        }
+
+        kernel_vmm.directory[addr >> VMM_LARGE_PAGE_SHIFT] =
+            addr | VMM_PRESENT | VMM_WRITE | VMM_LARGE | global;
+        kernel_vmm.large_pages++;
+    }
+
+    write_cr3((uint32_t)kernel_vmm.directory);
+    uint32_t cr4 = read_cr4();
+    if (kernel_vmm.pse) {
+        cr4 |= CR4_PSE;
+    }
+    if (kernel_vmm.pge) {
+        cr4 |= CR4_PGE;
+    }
+    write_cr4(cr4);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Identity map: ");
+    print_dec(kernel_vmm.identity_end >> 20);
+    print_string(" MB (");
+    print_dec(kernel_vmm.large_pages);
+    print_string(kernel_vmm.pse ? " x 4MB pages" : " large pages, no PSE");
+    print_string(kernel_vmm.pge ? ", global)\n" : ", no PGE)\n");
+}
+
+/**
+ * @brief Отображение страницы 4KB
+ * @param virt Виртуальный адрес (выравнивается вниз до страницы)
+ * @param phys Физический адрес
+ * @param flags VMM_WRITE, VMM_USER, VMM_GLOBAL, VMM_NOCACHE (VMM_PRESENT добавляется)
+ * @return 0 при успехе, -1 если не удалось выделить таблицу
+ */
+int map_page(uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t *table = vmm_table_for(virt, 1);
+    if (!table) {
+        return -1;
+    }
+
+    uint32_t *pte = &table[(virt >> PAGE_SHIFT) & (VMM_ENTRIES - 1)];
+    uint32_t old = *pte;
+    *pte = (phys & PAGE_MASK) | (flags & VMM_FLAGS_MASK & ~VMM_LARGE) | VMM_PRESENT;
+
+    /* Отсутствующие записи в TLB не попадают - сбрасывать нечего */
+    if (old & VMM_PRESENT) {
+        vmm_queue_flush(virt);
+    }
+    return 0;
+}
+
+/**
+ * @brief Очистка записи таблицы для адреса
+ * @return 1 если страница была отображена
+ */
+static int vmm_clear_page(uint32_t virt) {
+    if (!(kernel_vmm.directory[virt >> VMM_LARGE_PAGE_SHIFT] & VMM_PRESENT)) {
+        return 0;
+    }
+
+    uint32_t *table = vmm_table_for(virt, 1);
+    if (!table) {
+        return 0;
+    }
+
+    uint32_t *pte = &table[(virt >> PAGE_SHIFT) & (VMM_ENTRIES - 1)];
+    if (!(*pte & VMM_PRESENT)) {
+        return 0;
+    }
+    *pte = 0;
+    return 1;
+}
+
+/**
+ * @brief Снятие отображения страницы 4KB
+ *
+ * Страница 4MB, накрывающая адрес, разбивается на таблицу.
+ * Физическая страница не освобождается.
+ */
+void unmap_page(uint32_t virt) {
+    if (vmm_clear_page(virt)) {
+        vmm_queue_flush(virt);
+    }
+}
+
+/**
+ * @brief Снятие отображения без сброса TLB
+ *
+ * Запись в TLB может пережить вызов: адрес нельзя переиспользовать,
+ * пока вызывающий не сбросит TLB сам (vmalloc_purge).
+ * @param virt Виртуальный адрес
+ */
+void unmap_page_noflush(uint32_t virt) {
+    vmm_clear_page(virt);
+}
+
+/**
+ * @brief Перевод виртуального адреса в физический
+ * @return Физический адрес или 0, если адрес не отображён
+ */
+uint32_t virt_to_phys(uint32_t virt) {
+    uint32_t pde = kernel_vmm.directory[virt >> VMM_LARGE_PAGE_SHIFT];
+    if (!(pde & VMM_PRESENT)) {
+        return 0;
+    }
+    if (pde & VMM_LARGE) {
+        return (pde & ~(VMM_LARGE_PAGE_SIZE - 1)) | (virt & (VMM_LARGE_PAGE_SIZE - 1));
+    }
+
+    uint32_t pte = ((uint32_t*)(pde & PAGE_MASK))[(virt >> PAGE_SHIFT) & (VMM_ENTRIES - 1)];
+    if (!(pte & VMM_PRESENT)) {
+        return 0;
+    }
+    return (pte & PAGE_MASK) | (virt & (PAGE_SIZE - 1));
+}
+
+/**
+ * @brief Отображение 1:1 диапазона (MMIO, таблицы прошивки выше памяти)
+ * @param addr Начало диапазона
+ * @param size Размер в байтах
+ * @param flags Флаги страниц
+ * @return 0 при успехе, -1 при нехватке памяти под таблицы
+ */
+int vmm_identity_map(uint32_t addr, uint32_t size, uint32_t flags) {
+    uint32_t page = align_down(addr, PAGE_SIZE);
+    uint32_t count = (get_page_offset(addr) + size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    int result = 0;
+
+    /* Счёт страницами: диапазон может заканчиваться на границе 4GB */
+    vmm_batch_begin();
+    for (uint32_t i = 0; i < count; i++, page += PAGE_SIZE) {
+        if (map_page(page, page, flags) != 0) {
+            result = -1;
+            break;
+        }
+    }
+    vmm_batch_end();
+    return result;
+}
+
+/**
+ * @brief Начало пакета изменений отображений
+ *
+ * До парного vmm_batch_end сброс TLB только копится. Пакеты вкладываются.
+ */
+void vmm_batch_begin(void) {
+    kernel_vmm.batch_depth++;
+}
+
+/**
+ * @brief Конец пакета: накопленные invlpg выполняются разом
+ */
+void vmm_batch_end(void) {
+    if (kernel_vmm.batch_depth > 0 && --kernel_vmm.batch_depth == 0) {
+        vmm_flush_pending();
+    }
+}
+
+/**
+ * @brief Полный сброс TLB, включая глобальные страницы
+ *
+ * Перезагрузка CR3 глобальные записи не трогает, поэтому при PGE
+ * бит CR4.PGE кратковременно снимается.
+ */
+void vmm_flush_all(void) {
+    if (kernel_vmm.pge) {
+        uint32_t cr4 = read_cr4();
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    } else {
+        write_cr3(read_cr3());
+    }
+    kernel_vmm.full_flushes++;
+}
+
+/**
+ * @brief Вывод состояния виртуальной памяти
+ */
+void vmm_dump_info(void) {
+    print_string("VMM Info:\n");
+    print_string("  - Directory: ");
+    print_hex((uint32_t)kernel_vmm.directory);
+    print_string(", identity map ");
+    print_dec(kernel_vmm.identity_end >> 20);
+    print_string(" MB\n  - 4MB pages: ");
+    print_dec(kernel_vmm.large_pages);
+    print_string(", 4KB tables: ");
+    print_dec(kernel_vmm.tables - 1);
+    print_string(", splits: ");
+    print_dec(kernel_vmm.splits);
+    print_string("\n  - invlpg: ");
+    print_dec(kernel_vmm.invlpgs);
+    print_string(", full TLB flushes: ");
+    print_dec(kernel_vmm.full_flushes);
+    print_string("\n");
+
+    uint32_t areas = 0, reserved = 0, resident = 0;
+    for (vm_area_t *area = kernel_vmm.areas; area; area = area->next) {
+        areas++;
+        reserved += (area->end - area->start) >> PAGE_SHIFT;
+        resident += area->resident;
+    }
+    print_string("  - Areas: ");
+    print_dec(areas);
+    print_string(", reserved ");
+    print_dec(reserved);
+    print_string(" pages, resident ");
+    print_dec(resident);
+    print_string("\n  - Faults: ");
+    print_dec(kernel_vmm.faults);
+    print_string(", populated ");
+    print_dec(kernel_vmm.populated);
+    print_string(" (fault-around ");
+    print_dec(kernel_vmm.fault_around);
+    print_string("), zero page maps ");
+    print_dec(kernel_vmm.zero_maps);
+    print_string("\n  - vmalloc: ");
+    print_dec(kernel_vmm.vmalloc_pages);
+    print_string(" pages, awaiting TLB purge ");
+    print_dec(kernel_vmm.lazy_pages);
+    print_string(" pages, purges ");
+    print_dec(kernel_vmm.purges);
+    print_string("\n");
+
+    uint32_t spaces = 0;
+    for (mm_t *mm = kernel_vmm.mms; mm; mm = mm->next) {
+        spaces++;
+    }
+    print_string("  - Address spaces: ");
+    print_dec(spaces);
+    print_string(", COW faults ");
+    print_dec(kernel_vmm.cow_faults);
+    print_string(" (copied ");
+    print_dec(kernel_vmm.cow_copies);
+    print_string(", reused ");
+    print_dec(kernel_vmm.cow_reuses);
+    print_string(")\n");
+
+    zram_dump_info();
+}
@@ -0,0 +1,238 @@
+/**
+ * @file zram.c
+ * @brief Сжатый своп в памяти для вытесненных анонимных страниц
+ *
+ * Вытесняемая страница сжимается LZ4 и хранится в слабе своего класса
+ * размера (шаг ZRAM_CLASS_SIZE, не больше двух объектов на страницу
+ * слаба, так что каждая сохранённая страница освобождает память).
+ * Страница, заполненная одним словом (чаще всего нулями), хранится
+ * только этим словом. Запись таблицы вытесненной страницы хранит номер
+ * слота (VMM_SWAP); ошибка страницы распаковывает её обратно.
+ * Выбор жертв - часовой обход таблиц в mm_reclaim, который PMM вызывает
+ * как самый дорогой shrinker.
+ */
+
+#include "memory.h"
+#include "../video/video.h"
+#include "../lib/lz4.h"
+
+zram_t zram;
+
+/* Буфер сжатия: результат длиннее ZRAM_MAX_STORED не нужен */
+static uint8_t zram_buffer[ZRAM_MAX_STORED];
+
+static shrinker_t zram_shrinker = { .name = "zram", .cost = SHRINKER_COST_ZRAM, .scan = mm_reclaim };
+
+/**
+ * @brief Инициализация zram
+ *
+ * Под таблицу слотов резервируется область окна ядра; страницы
+ * отображает zram_table_grow по мере роста таблицы.
+ */
+void zram_init(void) {
+    memory_set(&zram, 0, sizeof(zram_t));
+
+    for (uint32_t i = 0; i < ZRAM_CLASSES; i++) {
+        zram.classes[i] = kmem_cache_create("zram", (i + 1) * ZRAM_CLASS_SIZE, SLAB_MIN_SIZE);
+        if (!zram.classes[i]) {
+            return;
+        }
+    }
+    zram.slots = vm_reserve(ZRAM_MAX_SLOTS * sizeof(zram_slot_t), VM_WRITE);
+    if (zram.slots) {
+        shrinker_register(&zram_shrinker);
+    }
+}
+
+/**
+ * @brief Слово, которым заполнена страница
+ * @return 1 если все слова страницы равны *value
+ */
+static int zram_same_filled(const uint32_t *words, uint32_t *value) {
+    for (uint32_t i = 1; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+        if (words[i] != words[0]) {
+            return 0;
+        }
+    }
+    *value = words[0];
+    return 1;
+}
+
+/**
+ * @brief Отображение страниц таблицы, на которых лежит слот
+ *
+ * Таблица не растёт ошибками страниц: слоты выдаются во время
+ * освобождения памяти, когда обработчик #PF не получил бы страницу
+ * (повторное освобождение запрещено), а отказ здесь - просто отказ
+ * вытеснения.
+ * @return 0 при успехе, -1 при нехватке памяти
+ */
+static int zram_table_grow(uint32_t slot) {
+    uint32_t first = (uint32_t)&zram.slots[slot];
+    uint32_t last = first + sizeof(zram_slot_t) - 1;
+    uint32_t flags = VMM_WRITE | (kernel_vmm.pge ? VMM_GLOBAL : 0);
+
+    for (uint32_t page = align_down(first, PAGE_SIZE); page <= last; page += PAGE_SIZE) {
+        if (virt_to_phys(page)) {
+            continue;
+        }
+        uint32_t phys = pmm_alloc_page();
+        if (!phys) {
+            return -1;
+        }
+        if (map_page(page, phys, flags) != 0) {
+            pmm_free_page(phys);
+            return -1;
+        }
+        zram.table_pages++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Выделение слота
+ * @return Номер слота или -1
+ */
+static int32_t zram_slot_alloc(void) {
+    uint32_t slot;
+    if (zram.free_slot) {
+        slot = zram.free_slot - 1;
+        zram.free_slot = zram.slots[slot].value;
+    } else if (zram.slot_top < ZRAM_MAX_SLOTS && zram_table_grow(zram.slot_top) == 0) {
+        slot = zram.slot_top++;
+    } else {
+        return -1;
+    }
+    zram.slots[slot].refs = 1;
+    zram.stored++;
+    return (int32_t)slot;
+}
+
+/**
+ * @brief Сохранение страницы в zram
+ * @param page Физический адрес страницы (содержимое не меняется)
+ * @return Номер слота или -1, если страница не сжимается или нет памяти
+ */
+int32_t zram_store(uint32_t page) {
+    if (!zram.slots) {
+        return -1;
+    }
+
+    uint32_t value;
+    if (zram_same_filled((const uint32_t*)page, &value)) {
+        int32_t slot = zram_slot_alloc();
+        if (slot < 0) {
+            return -1;
+        }
+        zram.slots[slot].data = NULL;
+        zram.slots[slot].value = value;
+        zram.slots[slot].size = 0;
+        zram.same_filled++;
+        zram.stores++;
+        return slot;
+    }
+
+    size_t size = lz4_compress((const uint8_t*)page, PAGE_SIZE, zram_buffer, ZRAM_MAX_STORED);
+    if (!size) {
+        zram.incompressible++;
+        return -1;
+    }
+
+    kmem_cache_t *cache = zram.classes[(size - 1) / ZRAM_CLASS_SIZE];
+    uint8_t *data = kmem_cache_alloc(cache);
+    if (!data) {
+        return -1;
+    }
+    int32_t slot = zram_slot_alloc();
+    if (slot < 0) {
+        kmem_cache_free(cache, data);
+        return -1;
+    }
+
+    memory_copy(data, zram_buffer, size);
+    zram.slots[slot].data = data;
+    zram.slots[slot].value = 0;
+    zram.slots[slot].size = (uint16_t)size;
+    zram.compressed_bytes += size;
+    zram.stores++;
+    return slot;
+}
+
+/**
+ * @brief Восстановление страницы из слота (слот остаётся занятым)
+ * @param slot Номер слота
+ * @param page Физический адрес страницы-приёмника
+ * @return 0 при успехе, -1 если слот пуст или данные повреждены
+ */
+int zram_load(uint32_t slot, uint32_t page) {
+    if (!zram.slots || slot >= zram.slot_top || !zram.slots[slot].refs) {
+        return -1;
+    }
+
+    const zram_slot_t *entry = &zram.slots[slot];
+    if (!entry->data) {
+        uint32_t *words = (uint32_t*)page;
+        for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+            words[i] = entry->value;
+        }
+    } else if (lz4_decompress(entry->data, entry->size, (uint8_t*)page, PAGE_SIZE) != PAGE_SIZE) {
+        return -1;
+    }
+    zram.loads++;
+    return 0;
+}
+
+/**
+ * @brief Ещё одна запись таблицы ссылается на слот (fork)
+ */
+void zram_slot_get(uint32_t slot) {
+    if (zram.slots && slot < zram.slot_top && zram.slots[slot].refs) {
+        zram.slots[slot].refs++;
+    }
+}
+
+/**
+ * @brief Снятие ссылки на слот; последняя освобождает его данные
+ */
+void zram_slot_put(uint32_t slot) {
+    if (!zram.slots || slot >= zram.slot_top || !zram.slots[slot].refs) {
+        return;
+    }
+
+    zram_slot_t *entry = &zram.slots[slot];
+    if (--entry->refs) {
+        return;
+    }
+
+    if (entry->data) {
+        kmem_cache_free(zram.classes[(entry->size - 1) / ZRAM_CLASS_SIZE], entry->data);
+        zram.compressed_bytes -= entry->size;
+        entry->data = NULL;
+    } else {
+        zram.same_filled--;
+    }
+    entry->value = zram.free_slot;
+    zram.free_slot = slot + 1;
+    zram.stored--;
+}
+
+/**
+ * @brief Вывод состояния zram
+ */
+void zram_dump_info(void) {
+    print_string("  - zram: ");
+    print_dec(zram.stored);
+    print_string(" pages stored (");
+    print_dec(zram.same_filled);
+    print_string(" same-filled), ");
+    print_dec(zram.compressed_bytes / 1024);
+    print_string(" KB compressed, table ");
+    print_dec(zram.table_pages);
+    print_string(" pages\n    stores ");
+    print_dec(zram.stores);
+    print_string(", loads ");
+    print_dec(zram.loads);
+    print_string(", incompressible ");
+    print_dec(zram.incompressible);
+    print_string("\n");
+}
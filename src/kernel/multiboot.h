@@ -0,0 +1,79 @@
+/**
+ * @file multiboot.h
+ * @brief Структуры спецификации Multiboot (версия 0.6.96)
+ *
+ * Описывает информационную структуру, которую загрузчик (GRUB, QEMU -kernel)
+ * передаёт ядру в регистре EBX, и формат записей карты памяти.
+ */
+
+#ifndef KERNEL_MULTIBOOT_H
+#define KERNEL_MULTIBOOT_H
+
+#include <stdint.h>
+
+/* Значение EAX при передаче управления Multiboot-загрузчиком */
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+/* Флаги заголовка (запрашиваются ядром в boot.asm) */
+#define MULTIBOOT_PAGE_ALIGN   0x00000001 /* Выравнивать модули по 4KB */
+#define MULTIBOOT_MEMORY_INFO  0x00000002 /* Передать mem_* и карту памяти */
+
+/* Флаги multiboot_info_t::flags (какие поля заполнены загрузчиком) */
+#define MULTIBOOT_INFO_MEMORY  0x00000001 /* mem_lower / mem_upper */
+#define MULTIBOOT_INFO_CMDLINE 0x00000004 /* cmdline */
+#define MULTIBOOT_INFO_MODS    0x00000008 /* mods_count / mods_addr */
+#define MULTIBOOT_INFO_MEM_MAP 0x00000040 /* mmap_length / mmap_addr */
+#define MULTIBOOT_INFO_BOOT_LOADER_NAME 0x00000200 /* boot_loader_name */
+
+/* Типы регионов карты памяти */
+#define MULTIBOOT_MEMORY_AVAILABLE        1
+#define MULTIBOOT_MEMORY_RESERVED         2
+#define MULTIBOOT_MEMORY_ACPI_RECLAIMABLE 3
+#define MULTIBOOT_MEMORY_NVS              4
+#define MULTIBOOT_MEMORY_BADRAM           5
+
+/**
+ * @brief Информационная структура, передаваемая загрузчиком
+ */
+typedef struct {
+    uint32_t flags;        /* Какие из полей ниже действительны */
+    uint32_t mem_lower;    /* Объём нижней памяти в KB (от 0) */
+    uint32_t mem_upper;    /* Объём верхней памяти в KB (от 1MB) */
+    uint32_t boot_device;
+    uint32_t cmdline;      /* Физический адрес командной строки ядра */
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];      /* a.out / ELF символы (не используются) */
+    uint32_t mmap_length;  /* Размер буфера карты памяти в байтах */
+    uint32_t mmap_addr;    /* Физический адрес карты памяти */
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+} __attribute__((packed)) multiboot_info_t;
+
+/**
+ * @brief Запись карты памяти
+ *
+ * Поле size не входит в собственный размер: следующая запись
+ * начинается через size + sizeof(size) байт.
+ */
+typedef struct {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+/**
+ * @brief Описание загруженного модуля
+ */
+typedef struct {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t cmdline;
+    uint32_t reserved;
+} __attribute__((packed)) multiboot_module_t;
+
+#endif /* KERNEL_MULTIBOOT_H */
@@ -8,26 +8,17 @@
 #include "video/video.h"
 #include "memory/memory.h"
 #include "drivers/pit.h"
+#include "drivers/clock.h"
+#include "cpu/fpu.h"
+#include "lib/string.h"
 
 /* kernel_panic определён в kernel.c */
 void kernel_panic(const char* msg);
 
-/* Локальные утилиты работы со строками (без стандартной библиотеки) */
-static int str_len(const char *s) {
-    int n = 0;
-    if (!s) return 0;
-    while (s[n] != '\0') n++;
-    return n;
-}
-
+/* Локальные утилиты разбора команды (поверх lib/string) */
 static int str_eq(const char *a, const char *b) {
-    int i = 0;
     if (!a || !b) return 0;
-    while (a[i] != '\0' && b[i] != '\0') {
-        if (a[i] != b[i]) return 0;
-        i++;
-    }
-    return a[i] == '\0' && b[i] == '\0';
+    return strcmp(a, b) == 0;
 }
 
 static const char* str_skip_spaces(const char *s) {
@@ -44,15 +35,30 @@ static void shell_print_help(void) {
     console_println("  help      - show this help");
     console_println("  clear     - clear screen");
     console_println("  meminfo   - show physical memory info");
+    console_println("  vminfo    - show page tables and TLB flush counters");
     console_println("  heapinfo  - show kernel heap info");
-    console_println("  timerinfo - show PIT timer info");
+    console_println("  heapstat  - show kmalloc profile by call site");
+    console_println("  pmmbench  - benchmark page allocator");
+    console_println("  heapbench - compare TLSF heap with first-fit list");
+    console_println("  membench  - memory stress/benchmark suite (results to COM1)");
+    console_println("  copybench - memory_set/copy/compare/find throughput vs byte loops");
+    console_println("  strbench  - strlen/strcmp/strchr/memchr vs byte loops");
+    console_println("  tlbbench  - TLB miss cost with 4KB vs 4MB pages");
+    console_println("  faultbench - demand paging fault cost, with and without fault-around");
+    console_println("  vmallocbench - vmalloc on fragmented memory, lazy vs eager TLB purge");
+    console_println("  forkbench - copy-on-write fork latency for 1/16/64 MB images");
+    console_println("  zrambench - compressed swap under a working set larger than RAM");
+    console_println("  numabench - NUMA local vs remote allocation and memory latency");
+    console_println("  clockbench - clock_ns cost and resolution, udelay/pit_sleep_us accuracy");
+    console_println("  timerinfo - show PIT timer and clocksource info");
+    console_println("  fpuinfo   - show FPU/SSE state and lazy switch counters");
+    console_println("  fputest   - check x87/XMM registers survive lazy context switches");
     console_println("  panic     - trigger kernel panic");
 }
 
 void shell_execute(const char *cmd) {
     cmd = str_skip_spaces(cmd);
-    int len = str_len(cmd);
-    if (len == 0) {
+    if (!cmd || strlen(cmd) == 0) {
         /* пустой ввод — ничего не делаем */
         return;
     }
@@ -63,10 +69,43 @@ void shell_execute(const char *cmd) {
         clear_screen();
     } else if (str_eq(cmd, "meminfo")) {
         pmm_dump_info();
+    } else if (str_eq(cmd, "vminfo")) {
+        vmm_dump_info();
     } else if (str_eq(cmd, "heapinfo")) {
         heap_dump_info();
+    } else if (str_eq(cmd, "heapstat")) {
+        heap_prof_dump(HEAP_PROF_TOP);
+    } else if (str_eq(cmd, "pmmbench")) {
+        pmm_benchmark();
+    } else if (str_eq(cmd, "heapbench")) {
+        heap_benchmark();
+    } else if (str_eq(cmd, "membench")) {
+        memory_benchmark();
+    } else if (str_eq(cmd, "copybench")) {
+        memory_primitives_benchmark();
+    } else if (str_eq(cmd, "strbench")) {
+        string_benchmark();
+    } else if (str_eq(cmd, "tlbbench")) {
+        tlb_benchmark();
+    } else if (str_eq(cmd, "faultbench")) {
+        fault_benchmark();
+    } else if (str_eq(cmd, "vmallocbench")) {
+        vmalloc_benchmark();
+    } else if (str_eq(cmd, "forkbench")) {
+        fork_benchmark();
+    } else if (str_eq(cmd, "zrambench")) {
+        zram_benchmark();
+    } else if (str_eq(cmd, "numabench")) {
+        numa_benchmark();
+    } else if (str_eq(cmd, "clockbench")) {
+        clock_benchmark();
     } else if (str_eq(cmd, "timerinfo")) {
         pit_dump_info();
+        clock_dump_info();
+    } else if (str_eq(cmd, "fpuinfo")) {
+        fpu_dump_info();
+    } else if (str_eq(cmd, "fputest")) {
+        fpu_selftest();
     } else if (str_eq(cmd, "panic")) {
         kernel_panic("Manual panic triggered from shell.\n");
     } else {
@@ -6,6 +6,7 @@
 #include "syscall.h"
 #include "../video/video.h"
 #include "../memory/memory.h"
+#include "../lib/string.h"
 
 /* Таблица обработчиков системных вызовов */
 static syscall_handler_t syscall_table[MAX_SYSCALLS];
@@ -19,7 +20,9 @@ static uint32_t sys_exit(registers_t *regs) {
     print_string("\nProcess exited with code: ");
     print_dec(exit_code);
     print_string("\n");
-    /* В будущем здесь будет реальное завершение процесса */
+    /* Адресное пространство и не запущенные потомки fork освобождаются;
+     * в будущем здесь будет реальное завершение процесса */
+    mm_exit(mm_current());
     return 0;
 }
 
@@ -33,10 +36,8 @@ static uint32_t sys_write(registers_t *regs) {
     uint32_t count = regs->edx;   /* Количество байт */
     
     if (fd == 1 || fd == 2) { /* stdout или stderr */
-        for (uint32_t i = 0; i < count && buf[i] != '\0'; i++) {
-            char str[2] = {buf[i], '\0'};
-            print_string(str);
-        }
+        /* Вывод обрывается на первом нуле, как и раньше, но одним вызовом */
+        print_chars(buf, strnlen(buf, count));
         return count;
     }
     return 0;
@@ -51,6 +52,21 @@ static uint32_t sys_read(registers_t *regs) {
     return 0;
 }
 
+/**
+ * @brief Системный вызов fork - копия адресного пространства
+ *
+ * Пользовательские страницы становятся общими с копированием при записи.
+ * Планировщика пока нет, поэтому потомок не запускается: вызов создаёт
+ * его адресное пространство и возвращает номер. Потомок уничтожается
+ * при завершении родителя (SYS_EXIT).
+ * @return Номер потомка или -1, если текущего процесса нет или не хватило памяти
+ */
+static uint32_t sys_fork(registers_t *regs) {
+    (void)regs;
+    mm_t *child = mm_fork(mm_current());
+    return child ? child->id : (uint32_t)-1;
+}
+
 /**
  * @brief Инициализация подсистемы системных вызовов
  */
@@ -62,6 +78,7 @@ void syscall_init(void) {
     syscall_register(SYS_EXIT, sys_exit);
     syscall_register(SYS_WRITE, sys_write);
     syscall_register(SYS_READ, sys_read);
+    syscall_register(SYS_FORK, sys_fork);
     
     print_string("Syscall subsystem initialized\n");
 }
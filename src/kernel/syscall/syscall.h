@@ -15,6 +15,7 @@
 #define SYS_READ    3
 #define SYS_OPEN    4
 #define SYS_CLOSE   5
+#define SYS_FORK    6
 
 /* Максимальное количество системных вызовов */
 #define MAX_SYSCALLS 32
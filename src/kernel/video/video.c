@@ -10,6 +10,7 @@
 #include "video.h"
 #include "../idt/idt.h"
 #include "../memory/memory.h"
+#include "../lib/string.h"
 #include <stdint.h>
 
 /**
@@ -158,35 +159,63 @@ void clear_screen(void)
  * @note При достижении конца экрана выполняется сброс позиции в начало
  */
 void print_string(const char* str) {
-    while (*str) {
-        if (*str == '\n') {
+    print_chars(str, strlen(str));
+}
+
+/**
+ * @brief Выводит len символов с заданным атрибутом в текущей позиции
+ * 
+ * Длина известна заранее, поэтому нулевой байт не ищется посимвольно,
+ * а аппаратный курсор обновляется один раз в конце вывода.
+ * 
+ * @param str Указатель на символы для вывода
+ * @param len Количество символов
+ * @param attribute Атрибут символов: (фон << 4) | текст
+ * @param backspace Ненулевое - '\b' стирает предыдущий символ,
+ *                  иначе выводится как обычный символ
+ */
+static void print_chars_attr(const char* str, size_t len, unsigned char attribute,
+                             int backspace) {
+    for (size_t i = 0; i < len; i++) {
+        char c = str[i];
+
+        if (c == '\n') {
             cursor_pos = ((cursor_pos / 160) + 1) * 160;
             if (cursor_pos >= SCREEN_SIZE) {
                 scroll_screen();
             }
-            str++;
             continue;
         }
-        else if (*str == '\b') {
+        else if (c == '\b' && backspace) {
             if (cursor_pos >= 2) {
                 cursor_pos -= 2;
                 VIDEO_MEMORY[cursor_pos] = ' ';
                 VIDEO_MEMORY[cursor_pos + 1] = 0x07;
             }
-            str++;
             continue;
         }
         
-        VIDEO_MEMORY[cursor_pos] = *str++;
-        VIDEO_MEMORY[cursor_pos + 1] = 0x07;
+        VIDEO_MEMORY[cursor_pos] = c;
+        VIDEO_MEMORY[cursor_pos + 1] = attribute;
         cursor_pos += 2;
         
         if (cursor_pos >= SCREEN_SIZE) {
             scroll_screen();
         }
-
-        safe_update_cursor_pos(cursor_pos);
     }
+    safe_update_cursor_pos(cursor_pos);
+}
+
+/**
+ * @brief Выводит len символов в текущей позиции
+ * 
+ * Используется стандартный атрибут 0x07 (светло-серый на черном фоне).
+ * 
+ * @param str Указатель на символы для вывода
+ * @param len Количество символов
+ */
+void print_chars(const char* str, size_t len) {
+    print_chars_attr(str, len, 0x07, 1);
 }
 
 /**
@@ -204,26 +233,7 @@ void print_string(const char* str) {
 void print_string_color(const char* str, unsigned char fg_color, unsigned char bg_color) 
 {
     unsigned char attribute = (bg_color << 4) | (fg_color & 0x0F);
-    
-    while (*str) {
-        if (*str == '\n') {
-            cursor_pos = ((cursor_pos / 160) + 1) * 160;
-            if (cursor_pos >= SCREEN_SIZE) {
-                scroll_screen();
-            }
-            str++;
-            continue;
-        }
-        
-        VIDEO_MEMORY[cursor_pos] = *str++;
-        VIDEO_MEMORY[cursor_pos + 1] = attribute;
-        cursor_pos += 2;
-        
-        if (cursor_pos >= SCREEN_SIZE) {
-            scroll_screen();
-        }
-    }
-    safe_update_cursor_pos(cursor_pos);
+    print_chars_attr(str, strlen(str), attribute, 0);
 }
 
 // Статические переменные для хранения текущего цвета
@@ -10,6 +10,7 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifndef KERNEL_VIDEO_H
 #define KERNEL_VIDEO_H
@@ -59,6 +60,14 @@ void clear_screen(void);
  */
 void print_string(const char* str);
 
+/**
+ * @brief Выводит len символов строки (нулевой байт не требуется)
+ * 
+ * @param str Указатель на символы для вывода
+ * @param len Количество символов
+ */
+void print_chars(const char* str, size_t len);
+
 
 /**
  * @brief Выводит цветную строку на экран